@@ -0,0 +1,124 @@
+// Measures query_ticket and query_order against the page sizes of the station lookup and order history stores.
+// Build once per configuration, e.g.
+//   g++ -std=c++20 -O2 -DTICKET_LOOKUP_PAGE_SIZE=65536 -DTICKET_ORDER_PAGE_SIZE=65536 ...
+// or configure CMake with -DTICKET_BUILD_BENCHMARKS=ON, and run each binary in an empty directory.
+
+#include "ticket_system.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <string>
+
+using ticket::TicketSystem;
+using Date = norb::Datetime::Date;
+
+constexpr int station_count = 400;
+constexpr int train_count = 2000;
+constexpr int stations_per_train = 30;
+constexpr int user_count = 500;
+constexpr int order_count = 100000;
+constexpr int query_count = 5000;
+
+namespace {
+    std::string station_name(const int &i) {
+        return "S" + std::to_string(i);
+    }
+
+    std::string train_name(const int &i) {
+        return "T" + std::to_string(i);
+    }
+
+    std::string user_name(const int &i) {
+        return "u" + std::to_string(i);
+    }
+
+    Date random_date(std::mt19937 &rng) {
+        return Date(6 + static_cast<int>(rng() % 3), 1 + static_cast<int>(rng() % 28));
+    }
+
+    template <typename Fn> double time_ms(Fn &&fn) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+} // namespace
+
+int main() {
+    norb::chore::remove_associated();
+    std::remove("station_id.data");
+    std::mt19937 rng(2025);
+    // silence the command outputs, keeping the report on a separate stream
+    std::ostream report(std::cout.rdbuf());
+    std::ofstream null_stream("/dev/null");
+    std::cout.rdbuf(null_stream.rdbuf());
+
+    norb::vector<norb::vector<int>> routes;
+    const double build_ms = time_ms([&] {
+        TicketSystem::add_user("", user_name(0), "pw", "Admin", "a@x.com", 10);
+        TicketSystem::login(user_name(0), "pw");
+        for (int i = 1; i < user_count; i++) {
+            TicketSystem::add_user(user_name(0), user_name(i), "pw", "User", "u@x.com", 1);
+            TicketSystem::login(user_name(i), "pw");
+        }
+        for (int i = 0; i < train_count; i++) {
+            // a random route without repeated stations
+            norb::vector<int> route;
+            std::string stations, prices, travel_times, stopover_times;
+            while (route.size() < stations_per_train) {
+                const int station = static_cast<int>(rng() % station_count);
+                bool repeated = false;
+                for (const auto &visited : route)
+                    repeated |= visited == station;
+                if (repeated)
+                    continue;
+                route.push_back(station);
+                stations += (stations.empty() ? "" : "|") + station_name(station);
+            }
+            for (int j = 0; j + 1 < stations_per_train; j++) {
+                prices += (j ? "|" : "") + std::to_string(10 + rng() % 90);
+                travel_times += (j ? "|" : "") + std::to_string(30 + rng() % 90);
+                if (j + 2 < stations_per_train)
+                    stopover_times += (j ? "|" : "") + std::to_string(1 + rng() % 10);
+            }
+            TicketSystem::add_train(train_name(i), stations_per_train, 1000, stations, prices,
+                                    norb::Datetime::Time(static_cast<int>(rng() % 24), 0), travel_times,
+                                    stopover_times, std::string("06-01|08-31"), 'G');
+            TicketSystem::release_train(train_name(i));
+            routes.push_back(route);
+        }
+        for (int i = 0; i < order_count; i++) {
+            const int train = static_cast<int>(rng() % train_count);
+            const int from = static_cast<int>(rng() % (stations_per_train - 1));
+            const int to = from + 1 + static_cast<int>(rng() % (stations_per_train - 1 - from));
+            ticket::global_interface::set_timestamp(i + 1);
+            TicketSystem::buy_ticket(user_name(static_cast<int>(rng() % user_count)), train_name(train),
+                                     random_date(rng), 1, station_name(routes[train][from]),
+                                     station_name(routes[train][to]), true);
+        }
+    });
+
+    const double query_ticket_ms = time_ms([&] {
+        for (int i = 0; i < query_count; i++) {
+            const int train = static_cast<int>(rng() % train_count);
+            const int from = static_cast<int>(rng() % (stations_per_train - 1));
+            const int to = from + 1 + static_cast<int>(rng() % (stations_per_train - 1 - from));
+            TicketSystem::query_ticket_and_print(station_name(routes[train][from]), station_name(routes[train][to]),
+                                                 random_date(rng), i % 2 ? "time" : "cost");
+        }
+    });
+
+    const double query_order_ms = time_ms([&] {
+        for (int i = 0; i < query_count; i++)
+            TicketSystem::query_order_and_print(user_name(static_cast<int>(rng() % user_count)));
+    });
+
+    report << "lookup page size: " << ticket::lookup_store_page_size
+           << ", order page size: " << ticket::order_store_page_size << '\n';
+    report << "build: " << build_ms << " ms" << '\n';
+    report << "query_ticket x" << query_count << ": " << query_ticket_ms << " ms" << '\n';
+    report << "query_order x" << query_count << ": " << query_order_ms << " ms" << '\n';
+    report << "pages on disk: " << norb::PersistentMemory::get_page_count() << '\n';
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Measures query_route on a national network: regions of stations served by local trains, joined by intercity trains
+// between the hubs of the regions, queried across regions for each number of transfers.
+// The network has more trains than TrainManager caches by default, see train_cache_capacity in settings.hpp. Build with
+//   g++ -std=c++20 -O2 [-DTICKET_TRAIN_CACHE_CAPACITY=4096] ...
+// or configure CMake with -DTICKET_BUILD_BENCHMARKS=ON, and run the binary in an empty directory.
+
+#include "ticket_system.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <string>
+
+using ticket::TicketSystem;
+using Date = norb::Datetime::Date;
+
+constexpr int region_count = 40;
+constexpr int stations_per_region = 50;
+constexpr int hubs_per_region = 3; // the first stations of a region
+constexpr int local_trains_per_region = 40;
+constexpr int stations_per_local_train = 15;
+constexpr int intercity_train_count = 600;
+constexpr int stations_per_intercity_train = 12;
+constexpr int max_transfers = 4;
+constexpr int query_count = 200;
+
+namespace {
+    std::string station_name(const int &i) {
+        return "S" + std::to_string(i);
+    }
+
+    std::string train_name(const int &i) {
+        return "T" + std::to_string(i);
+    }
+
+    Date random_date(std::mt19937 &rng) {
+        return Date(6 + static_cast<int>(rng() % 3), 1 + static_cast<int>(rng() % 28));
+    }
+
+    template <typename Fn> double time_ms(Fn &&fn) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // Adds a train over count distinct stations drawn by pick, with legs of min_travel to min_travel + spread minutes
+    template <typename Pick>
+    void add_train(std::mt19937 &rng, const int &id, const int &count, Pick &&pick, const int &min_travel,
+                   const int &spread) {
+        norb::vector<int> route;
+        std::string stations, prices, travel_times, stopover_times;
+        while (route.size() < count) {
+            const int station = pick();
+            bool repeated = false;
+            for (const auto &visited : route)
+                repeated |= visited == station;
+            if (repeated)
+                continue;
+            route.push_back(station);
+            stations += (stations.empty() ? "" : "|") + station_name(station);
+        }
+        for (int j = 0; j + 1 < count; j++) {
+            prices += (j ? "|" : "") + std::to_string(10 + rng() % 90);
+            travel_times += (j ? "|" : "") + std::to_string(min_travel + rng() % spread);
+            if (j + 2 < count)
+                stopover_times += (j ? "|" : "") + std::to_string(1 + rng() % 10);
+        }
+        TicketSystem::add_train(train_name(id), count, 1000, stations, prices,
+                                norb::Datetime::Time(static_cast<int>(rng() % 24), static_cast<int>(rng() % 60)),
+                                travel_times, stopover_times, std::string("06-01|08-31"), 'G');
+    }
+} // namespace
+
+int main() {
+    norb::chore::remove_associated();
+    std::mt19937 rng(2025);
+    // silence the command outputs, keeping the report on a separate stream
+    std::ostream report(std::cout.rdbuf());
+    std::ofstream null_stream("/dev/null");
+    const auto cout_buffer = std::cout.rdbuf(null_stream.rdbuf());
+
+    int train_count = 0;
+    for (int region = 0; region < region_count; region++) {
+        for (int i = 0; i < local_trains_per_region; i++) {
+            add_train(
+                rng, train_count++, stations_per_local_train,
+                [&] { return region * stations_per_region + static_cast<int>(rng() % stations_per_region); }, 10,
+                50);
+        }
+    }
+    for (int i = 0; i < intercity_train_count; i++) {
+        add_train(
+            rng, train_count++, stations_per_intercity_train,
+            [&] {
+                return static_cast<int>(rng() % region_count) * stations_per_region +
+                       static_cast<int>(rng() % hubs_per_region);
+            },
+            60, 240);
+    }
+
+    const double release_ms = time_ms([&] {
+        for (int i = 0; i < train_count; i++)
+            TicketSystem::release_train(train_name(i));
+    });
+
+    report << "stations: " << region_count * stations_per_region << ", trains: " << train_count << '\n';
+    report << "release x" << train_count << ": " << release_ms << " ms" << '\n';
+    // the same stations, in different regions, and dates for every number of transfers
+    for (int k = 0; k <= max_transfers; k++) {
+        std::mt19937 query_rng(7);
+        const double query_route_ms = time_ms([&] {
+            for (int i = 0; i < query_count; i++) {
+                const int from_region = static_cast<int>(query_rng() % region_count);
+                const int to_region =
+                    (from_region + 1 + static_cast<int>(query_rng() % (region_count - 1))) % region_count;
+                const int from = from_region * stations_per_region + static_cast<int>(query_rng() % stations_per_region);
+                const int to = to_region * stations_per_region + static_cast<int>(query_rng() % stations_per_region);
+                TicketSystem::query_route_and_print(station_name(from), station_name(to), random_date(query_rng), k);
+            }
+        });
+        report << "query_route -k " << k << " x" << query_count << ": " << query_route_ms << " ms" << '\n';
+    }
+    report << TicketSystem::debug_stats() << '\n';
+    std::cout.rdbuf(cout_buffer);
+    return 0;
+}
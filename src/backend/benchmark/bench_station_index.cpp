@@ -0,0 +1,138 @@
+// Measures release_train and query_ticket against the station index, see station_index_kind in settings.hpp.
+// Build once per index, e.g.
+//   g++ -std=c++20 -O2 -DTICKET_STATION_INDEX=0 ...
+// or configure CMake with -DTICKET_BUILD_BENCHMARKS=ON, and run each binary in an empty directory.
+
+#include "ticket_system.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <string>
+
+using ticket::TicketSystem;
+using Date = norb::Datetime::Date;
+
+constexpr int station_count = 400;
+constexpr int train_count = 1000;
+constexpr int stations_per_train = 50;
+constexpr int query_count = 5000;
+
+namespace {
+    std::string station_name(const int &i) {
+        return "S" + std::to_string(i);
+    }
+
+    std::string train_name(const int &i) {
+        return "T" + std::to_string(i);
+    }
+
+    Date random_date(std::mt19937 &rng) {
+        return Date(6 + static_cast<int>(rng() % 3), 1 + static_cast<int>(rng() % 28));
+    }
+
+    template <typename Fn> double time_ms(Fn &&fn) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+} // namespace
+
+int main() {
+    norb::chore::remove_associated();
+    std::mt19937 rng(2025);
+    // silence the command outputs, keeping the report on a separate stream
+    std::ostream report(std::cout.rdbuf());
+    std::ofstream null_stream("/dev/null");
+    const auto cout_buffer = std::cout.rdbuf(null_stream.rdbuf());
+
+    norb::vector<norb::vector<int>> routes;
+    for (int i = 0; i < train_count; i++) {
+        // a random route without repeated stations
+        norb::vector<int> route;
+        std::string stations, prices, travel_times, stopover_times;
+        while (route.size() < stations_per_train) {
+            const int station = static_cast<int>(rng() % station_count);
+            bool repeated = false;
+            for (const auto &visited : route)
+                repeated |= visited == station;
+            if (repeated)
+                continue;
+            route.push_back(station);
+            stations += (stations.empty() ? "" : "|") + station_name(station);
+        }
+        for (int j = 0; j + 1 < stations_per_train; j++) {
+            prices += (j ? "|" : "") + std::to_string(10 + rng() % 90);
+            travel_times += (j ? "|" : "") + std::to_string(30 + rng() % 90);
+            if (j + 2 < stations_per_train)
+                stopover_times += (j ? "|" : "") + std::to_string(1 + rng() % 10);
+        }
+        TicketSystem::add_train(train_name(i), stations_per_train, 1000, stations, prices,
+                                norb::Datetime::Time(static_cast<int>(rng() % 24), 0), travel_times, stopover_times,
+                                std::string("06-01|08-31"), 'G');
+        routes.push_back(route);
+    }
+
+    const double release_ms = time_ms([&] {
+        for (int i = 0; i < train_count; i++)
+            TicketSystem::release_train(train_name(i));
+    });
+
+    const double query_ticket_ms = time_ms([&] {
+        for (int i = 0; i < query_count; i++) {
+            const int train = static_cast<int>(rng() % train_count);
+            const int from = static_cast<int>(rng() % (stations_per_train - 1));
+            const int to = from + 1 + static_cast<int>(rng() % (stations_per_train - 1 - from));
+            TicketSystem::query_ticket_and_print(station_name(routes[train][from]), station_name(routes[train][to]),
+                                                 random_date(rng), i % 2 ? "time" : "cost");
+        }
+    });
+
+    // query_transfer runs query_ticket from the start to every station and from there to the end
+    const double query_transfer_ms = time_ms([&] {
+        for (int i = 0; i < query_count / 50; i++)
+            TicketSystem::query_transfer_and_print(station_name(static_cast<int>(rng() % station_count)),
+                                                   station_name(static_cast<int>(rng() % station_count)),
+                                                   random_date(rng), i % 2 ? "time" : "cost");
+    });
+
+    // a choice of transfers by time against cost, from both orders or from the frontier of one search
+    norb::vector<int> choice_stations;
+    norb::vector<Date> choice_dates;
+    for (int i = 0; i < query_count / 50; i++) {
+        choice_stations.push_back(static_cast<int>(rng() % station_count));
+        choice_stations.push_back(static_cast<int>(rng() % station_count));
+        choice_dates.push_back(random_date(rng));
+    }
+    const double both_orders_ms = time_ms([&] {
+        for (int i = 0; i < query_count / 50; i++) {
+            for (const auto &sort_by : {"time", "cost"})
+                TicketSystem::query_transfer_and_print(station_name(choice_stations[2 * i]),
+                                                       station_name(choice_stations[2 * i + 1]), choice_dates[i],
+                                                       sort_by);
+        }
+    });
+    const double pareto_ms = time_ms([&] {
+        for (int i = 0; i < query_count / 50; i++)
+            TicketSystem::query_transfer_and_print(station_name(choice_stations[2 * i]),
+                                                   station_name(choice_stations[2 * i + 1]), choice_dates[i],
+                                                   "pareto");
+    });
+
+    // the pages of the index as grown by the releases, read off a rebuild
+    const auto index_tree = ticket::station_index == ticket::STATION_PAIR_TABLE ? "station_lookup" : "station_train";
+    const auto index_pages = std::get<std::string>(TicketSystem::compact_tree(index_tree, 100));
+
+    report << "station index: "
+           << (ticket::station_index == ticket::STATION_PAIR_TABLE ? "pair table" : "station train lists") << '\n';
+    report << "release x" << train_count << ": " << release_ms << " ms" << '\n';
+    report << "index " << index_tree << ": " << index_pages << '\n';
+    report << "query_ticket x" << query_count << ": " << query_ticket_ms << " ms" << '\n';
+    report << "query_transfer x" << query_count / 50 << ": " << query_transfer_ms << " ms" << '\n';
+    report << "query_transfer -p time and -p cost x" << query_count / 50 << ": " << both_orders_ms << " ms" << '\n';
+    report << "query_transfer -p pareto x" << query_count / 50 << ": " << pareto_ms << " ms" << '\n';
+    report << TicketSystem::debug_stats() << '\n';
+    std::cout.rdbuf(cout_buffer);
+    return 0;
+}
@@ -59,7 +59,7 @@ namespace ticket {
 
       private:
         using LogLevel = norb::LogLevel;
-        norb::BPlusTree<Account::id_t, Account, norb::MANUAL> account_store;
+        norb::BPlusTree<Account::id_t, Account, norb::MANUAL> account_store{"account_store"};
         norb::set<Account::id_t> login_store;
 
       public:
@@ -136,6 +136,19 @@ namespace ticket {
             account_store.insert(account_id, account);
         }
 
+        // Rebuilds the named store at the given fill factor. Returns std::nullopt if no store has that name.
+        std::optional<norb::TreeRebuildReport> rebuild_tree(const std::string &tree_name, const float &fill_factor) {
+            if (tree_name == "account")
+                return account_store.rebuild(fill_factor);
+            return std::nullopt;
+        }
+
+        // Reloads what is kept in memory, after the pages changed under the manager: the login sessions do not
+        // survive it.
+        void reload() {
+            login_store.clear();
+        }
+
         void clear() {
             account_store.clear();
             login_store.clear();
@@ -0,0 +1,745 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "settings.hpp"
+#include "sorted_view.hpp"
+#include "stlite/map.hpp"
+#include "thread_pool.hpp"
+#include "stlite/lru_cache.hpp"
+#include "stlite/vector.hpp"
+#include "ticket_manager.hpp" // train_id_t
+#include "train_manager.hpp"
+
+namespace ticket {
+    /**
+     * @class RoutePlanner
+     * @brief Finds the journeys of more than one train over the station train lists of a TrainManager.
+     * @details The lists are kept by TrainManager as trains are released, one entry per train and station, so that
+     * the departures from and arrivals at any station are a single range scan. The planner reads the timetables
+     * through the train cache, and keeps only the stations one train takes to and from a station, which
+     * add_released_train keeps up to date. With transfer_threads above 1, the candidate transfers of a query are
+     * tried on a thread pool once they are read from the stores, so that no store is read by more than one thread.
+     */
+    class RoutePlanner {
+      public:
+        using train_group_id_t = TrainManager::train_group_id_t;
+        using station_ordinal_t = TrainManager::station_ordinal_t;
+        using train_name_t = TrainGroup::train_group_name_t;
+
+        // A train taken between two of its stations
+        struct Leg {
+            train_id_t train_id;
+            int from_station_serial = 0;
+            int to_station_serial = 0;
+            Datetime from_time;
+            Datetime to_time;
+            int price = 0;
+        };
+
+        // The trains of a journey, in the order they are taken
+        using Route = norb::vector<Leg>;
+
+        struct Transfer {
+            Leg first;
+            Leg second;
+            station_ordinal_t mid_station = 0;
+            train_name_t first_train_name;
+            train_name_t second_train_name;
+        };
+
+        // A set of stations, a bit per station ordinal
+        using StationSet = norb::vector<uint64_t>;
+
+        // The order query_transfer ranks transfers by: the total time or cost, the other one, then the names of the
+        // trains. Transfers equal in all of them, taking the same trains, rank by their middle station, as they are
+        // met in station order
+        static bool better(const Transfer &a, const Transfer &b, const bool &by_time) {
+            const auto a_time = a.second.to_time - a.first.from_time, b_time = b.second.to_time - b.first.from_time;
+            const auto a_price = a.first.price + a.second.price, b_price = b.first.price + b.second.price;
+            if (by_time && a_time != b_time)
+                return a_time < b_time;
+            if (a_price != b_price)
+                return a_price < b_price;
+            if (a_time != b_time)
+                return a_time < b_time;
+            if (a.first.train_id != b.first.train_id)
+                return a.first_train_name < b.first_train_name;
+            if (a.second_train_name != b.second_train_name)
+                return a.second_train_name < b.second_train_name;
+            return a.mid_station < b.mid_station;
+        }
+
+        static int total_time(const Transfer &transfer) {
+            return (transfer.second.to_time - transfer.first.from_time).to_minutes();
+        }
+
+        static int total_price(const Transfer &transfer) {
+            return transfer.first.price + transfer.second.price;
+        }
+
+        // Whether a transfer of frontier is as fast and as cheap as time and price, and faster or cheaper
+        static bool dominated(const norb::vector<Transfer> &frontier, const long long &time, const long long &price) {
+            for (const auto &transfer : frontier) {
+                if (total_time(transfer) > time)
+                    break;
+                if (total_price(transfer) <= price && (total_time(transfer) < time || total_price(transfer) < price))
+                    return true;
+            }
+            return false;
+        }
+
+        // Adds a transfer to frontier, the transfers by total time, each cheaper than those before it. Of two as fast
+        // and as cheap, the one query_transfer -p time ranks first is kept
+        static void add_to_frontier(norb::vector<Transfer> &frontier, const Transfer &candidate) {
+            const int time = total_time(candidate), price = total_price(candidate);
+            size_t position = 0;
+            while (position < frontier.size() && total_time(frontier[position]) < time)
+                ++position;
+            // the last of the faster ones is the cheapest of them
+            if (position > 0 && total_price(frontier[position - 1]) <= price)
+                return;
+            if (position < frontier.size() && total_time(frontier[position]) == time &&
+                (total_price(frontier[position]) < price ||
+                 (total_price(frontier[position]) == price && not better(candidate, frontier[position], true))))
+                return;
+            // the slower ones left are those cheaper than candidate
+            norb::vector<Transfer> kept;
+            for (size_t i = 0; i < position; ++i)
+                kept.push_back(frontier[i]);
+            kept.push_back(candidate);
+            for (size_t i = position; i < frontier.size(); ++i)
+                if (total_price(frontier[i]) < price)
+                    kept.push_back(frontier[i]);
+            frontier = kept;
+        }
+
+      private:
+        const TrainManager &train_manager_;
+        // the stations one released train takes from a station, and those it takes to a station from, as of
+        // cached_version_ of the released trains, cleared if they change otherwise than by add_released_train
+        mutable norb::LruCache<station_ordinal_t, StationSet> reachable_from_cache_{reachable_cache_capacity};
+        mutable norb::LruCache<station_ordinal_t, StationSet> reaching_cache_{reachable_cache_capacity};
+        mutable size_t cached_version_ = 0;
+        // the first trains at a middle station whose second trains were tried, and those left out by the bounds
+        mutable size_t tried_transfers_ = 0;
+        mutable size_t pruned_transfers_ = 0;
+        std::unique_ptr<norb::ThreadPool> thread_pool_ =
+            transfer_threads > 1 ? std::make_unique<norb::ThreadPool>(transfer_threads) : nullptr;
+
+        // A train that reaches the destination, taken from one of its earlier stations
+        struct SecondLeg {
+            int train = 0; // into the trains reaching the destination
+            int from_station_serial = 0;
+            int to_station_serial = 0;
+            DeltaDatetime departure_time;
+            DeltaDatetime arrival_time;
+            int price = 0;
+        };
+
+        // The earliest arrival at a station found in a round of the route search, and the train that made it
+        struct RouteLabel {
+            Leg leg;
+            station_ordinal_t from_station = 0;
+            int round = -1; // that found it, 0 at the origin, -1 if the station is not reached yet
+        };
+
+        struct ArrivingTrain {
+            train_group_id_t train_group_id = 0;
+            train_name_t train_group_name;
+            norb::Range<Date> sale_date_range;
+        };
+
+        // A station a first train may be changed at, with the arrival and fare there
+        struct FirstStop {
+            int station_serial = 0;
+            station_ordinal_t station = 0;
+            Datetime arrival;
+            int price = 0;
+        };
+
+        // A train leaving the origin on the date of a transfer, with the least total time and cost of a transfer
+        // taking it, from the least a second train adds at each of its stops
+        struct FirstTrain {
+            train_name_t train_group_name;
+            train_id_t train_id;
+            int station_serial = 0;
+            Datetime from_time;
+            long long time_bound = std::numeric_limits<long long>::max();
+            long long price_bound = std::numeric_limits<long long>::max();
+            int stops_begin = 0, stops_end = 0; // into first_stops
+        };
+
+        // The trains a transfer may take: the second trains by the station they are boarded at, and the first trains
+        // with the stations they may be changed at
+        struct TransferCandidates {
+            norb::vector<ArrivingTrain> arriving;
+            norb::vector<SecondLeg> legs_by_station;
+            norb::vector<int> legs_begin; // into legs_by_station, by station, and the end of the last
+            // the least a second train from each station costs, and the least time it rides
+            norb::vector<int> least_price, least_ride;
+            norb::vector<FirstTrain> first_trains;
+            norb::vector<FirstStop> first_stops;
+
+            // the least total time and cost of a transfer at stop of first_train
+            [[nodiscard]] long long time_bound(const FirstTrain &first_train, const FirstStop &stop) const {
+                return static_cast<long long>((stop.arrival - first_train.from_time).to_minutes()) +
+                       least_ride[stop.station];
+            }
+
+            [[nodiscard]] long long price_bound(const FirstStop &stop) const {
+                return static_cast<long long>(stop.price) + least_price[stop.station];
+            }
+        };
+
+        // The order the second train from a middle station is chosen by, once the first train is: that of better
+        // for the transfers they make, the earliest arrival or the cheapest, the other one, then the name of the train
+        static bool better_second(const Leg &a, const train_name_t &a_name, const Leg &b, const train_name_t &b_name,
+                                  const bool &by_time) {
+            const int a_arrival = a.to_time.to_minutes(), b_arrival = b.to_time.to_minutes();
+            if (by_time && a_arrival != b_arrival)
+                return a_arrival < b_arrival;
+            if (a.price != b.price)
+                return a.price < b.price;
+            if (a_arrival != b_arrival)
+                return a_arrival < b_arrival;
+            return a_name < b_name;
+        }
+
+        // The earliest run of train to leave the station of leg at or after arrival, if it is on sale
+        static std::optional<Leg> catch_second(const ArrivingTrain &train, const SecondLeg &leg,
+                                               const Datetime &arrival) {
+            if (not TrainManager::get_departure_datetime_range(train.sale_date_range, leg.departure_time)
+                        .contains_from_right(arrival))
+                return std::nullopt;
+            auto departure_date = (arrival - leg.departure_time.to_minutes()).getDateCeil();
+            if (departure_date < train.sale_date_range.get_from())
+                departure_date = train.sale_date_range.get_from();
+            return Leg{train_id_t(train.train_group_id, departure_date), leg.from_station_serial, leg.to_station_serial,
+                       Datetime(departure_date) + leg.departure_time, Datetime(departure_date) + leg.arrival_time,
+                       leg.price};
+        }
+
+        static bool contains(const StationSet &set, const station_ordinal_t &station) {
+            return station / 64 < set.size() && (set[station / 64] >> station % 64 & 1);
+        }
+
+        static void insert(StationSet &set, const station_ordinal_t &station) {
+            while (set.size() <= station / 64)
+                set.push_back(0);
+            set[station / 64] |= uint64_t{1} << station % 64;
+        }
+
+        void clear_if_stale() const {
+            if (cached_version_ == train_manager_.released_version())
+                return;
+            reachable_from_cache_.clear();
+            reaching_cache_.clear();
+            cached_version_ = train_manager_.released_version();
+        }
+
+        // The stations some released train takes from station if forward, else those it takes to station from
+        StationSet one_train_stations(const station_ordinal_t &station, const bool &forward) const {
+            StationSet set;
+            for (size_t i = 0; i < (train_manager_.station_id_vector.size() + 63) / 64; ++i)
+                set.push_back(0);
+            for (const auto &[train_group_id, stop] : train_manager_.stops_at(station)) {
+                const auto &timetable = *train_manager_.get_timetable(train_group_id);
+                const int begin = forward ? stop.station_serial + 1 : 0;
+                const int end = forward ? timetable.station_count : stop.station_serial;
+                for (int k = begin; k < end; ++k)
+                    insert(set, timetable.station_ordinals[k]);
+            }
+            return set;
+        }
+
+        const StationSet &reachable(const station_ordinal_t &station, const bool &forward) const {
+            clear_if_stale();
+            auto &cache = forward ? reachable_from_cache_ : reaching_cache_;
+            if (const auto *set = cache.find(station))
+                return *set;
+            return cache.emplace(station) = one_train_stations(station, forward);
+        }
+
+        // Lays out the trains a transfer from one station to another, leaving on date, may take. Only the stations
+        // some train takes from the origin and some train takes to the destination can be changed at. Returns false
+        // if there is no such station
+        bool lay_out_transfers(const station_ordinal_t &from, const station_ordinal_t &to, const Date &date,
+                               TransferCandidates &candidates) const {
+            auto &[arriving, legs_by_station, legs_begin, least_price, least_ride, first_trains, first_stops] =
+                candidates;
+            const auto station_count = train_manager_.station_id_vector.size();
+            StationSet mids;
+            bool any_mid = false;
+            {
+                const auto &reachable_from = reachable(from, true);
+                const auto &reaching_to = reachable(to, false);
+                for (size_t i = 0; i < reachable_from.size() && i < reaching_to.size(); ++i) {
+                    mids.push_back(reachable_from[i] & reaching_to[i]);
+                    any_mid |= mids[i] != 0;
+                }
+            }
+            if (not any_mid)
+                return false;
+
+            // the trains reaching to, and the legs they offer from each station before it, grouped by that station
+            norb::vector<SecondLeg> legs;
+            norb::vector<station_ordinal_t> leg_station;
+            for (const auto &[train_group_id, stop] : train_manager_.stops_at(to)) {
+                const auto &timetable = *train_manager_.get_timetable(train_group_id);
+                const int train = arriving.size();
+                arriving.push_back({train_group_id, timetable.train_group.train_group_name, stop.sale_date_range});
+                int price = 0;
+                for (int k = stop.station_serial - 1; k >= 0; --k) {
+                    price += timetable.prices[k];
+                    if (not contains(mids, timetable.station_ordinals[k]))
+                        continue;
+                    legs.push_back({train, k, stop.station_serial, timetable.departure_times[k], stop.arrival_time,
+                                    price});
+                    leg_station.push_back(timetable.station_ordinals[k]);
+                }
+            }
+            if (legs.empty())
+                return false;
+            // counting sort by station, keeping train group order within each station
+            for (size_t i = 0; i <= station_count; ++i)
+                legs_begin.push_back(0);
+            for (const auto &station : leg_station)
+                ++legs_begin[station + 1];
+            for (size_t i = 0; i < station_count; ++i)
+                legs_begin[i + 1] += legs_begin[i];
+            for (size_t i = 0; i < legs.size(); ++i)
+                legs_by_station.push_back({});
+            {
+                norb::vector<int> cursor = legs_begin;
+                for (size_t i = 0; i < legs.size(); ++i)
+                    legs_by_station[cursor[leg_station[i]]++] = legs[i];
+            }
+
+            // so that a first train arriving somewhere is known not to beat a transfer without trying the second
+            // trains there
+            for (size_t i = 0; i < station_count; ++i) {
+                least_price.push_back(std::numeric_limits<int>::max());
+                least_ride.push_back(std::numeric_limits<int>::max());
+            }
+            for (size_t i = 0; i < legs.size(); ++i) {
+                const auto &station = leg_station[i];
+                least_price[station] = std::min(least_price[station], legs[i].price);
+                least_ride[station] =
+                    std::min(least_ride[station], (legs[i].arrival_time - legs[i].departure_time).to_minutes());
+            }
+
+            // the trains leaving from on date, with the stations after it they may be changed at
+            for (const auto &[train_group_id, stop] : train_manager_.stops_at(from)) {
+                if (not TrainManager::get_departure_date_range(stop.sale_date_range, stop.departure_time)
+                            .contains(date))
+                    continue;
+                const auto &timetable = *train_manager_.get_timetable(train_group_id);
+                const Date first_departure_date = date - stop.departure_time.to_days();
+                FirstTrain first_train{timetable.train_group.train_group_name,
+                                       train_id_t(train_group_id, first_departure_date), stop.station_serial,
+                                       Datetime(first_departure_date) + stop.departure_time};
+                first_train.stops_begin = first_stops.size();
+                int price = 0;
+                for (int k = stop.station_serial + 1; k < timetable.station_count; ++k) {
+                    price += timetable.prices[k - 1];
+                    const auto mid = timetable.station_ordinals[k];
+                    if (legs_begin[mid] == legs_begin[mid + 1])
+                        continue;
+                    const FirstStop first_stop{k, mid, Datetime(first_departure_date) + timetable.arrival_times[k],
+                                               price};
+                    first_train.time_bound =
+                        std::min(first_train.time_bound, candidates.time_bound(first_train, first_stop));
+                    first_train.price_bound = std::min(first_train.price_bound, candidates.price_bound(first_stop));
+                    first_stops.push_back(first_stop);
+                }
+                first_train.stops_end = first_stops.size();
+                if (first_train.stops_begin != first_train.stops_end)
+                    first_trains.push_back(first_train);
+            }
+            return true;
+        }
+
+      public:
+        explicit RoutePlanner(const TrainManager &train_manager) : train_manager_(train_manager) {}
+
+        // Adds the stations of a train just released to the cached stations reachable by one train
+        void add_released_train(const TrainManager::TrainTimetable &timetable) {
+            if (cached_version_ + 1 != train_manager_.released_version()) {
+                clear_if_stale();
+                return;
+            }
+            cached_version_ = train_manager_.released_version();
+            for (int i = 0; i < timetable.station_count; ++i) {
+                if (auto *set = reachable_from_cache_.peek(timetable.station_ordinals[i]))
+                    for (int k = i + 1; k < timetable.station_count; ++k)
+                        insert(*set, timetable.station_ordinals[k]);
+                if (auto *set = reaching_cache_.peek(timetable.station_ordinals[i]))
+                    for (int k = 0; k < i; ++k)
+                        insert(*set, timetable.station_ordinals[k]);
+            }
+        }
+
+        // the lookups of reachable stations answered by the cache, and those that had to scan the station
+        [[nodiscard]] size_t reachable_cache_hits() const {
+            return reachable_from_cache_.hits() + reaching_cache_.hits();
+        }
+
+        [[nodiscard]] size_t reachable_cache_misses() const {
+            return reachable_from_cache_.misses() + reaching_cache_.misses();
+        }
+
+        [[nodiscard]] size_t tried_transfers() const {
+            return tried_transfers_;
+        }
+
+        [[nodiscard]] size_t pruned_transfers() const {
+            return pruned_transfers_;
+        }
+
+        /**
+         * @brief The best journey from one station to another changing trains once, leaving on date.
+         * @details Every train through the destination is laid out by the stations it can be boarded at, then every
+         * train leaving the origin on date is followed along its later stations, trying the trains laid out there.
+         * As with query_ticket, the second train is the first run to leave after the arrival, the cheapest or the
+         * earliest to arrive per sort_by of the trains leaving the middle station; on a tie the earliest to arrive or
+         * the cheapest, and then the first by name, per better_second.
+         * The first trains are tried from the one whose best arrival bounds the total lowest, and a first train is
+         * left at a station once its fare or time there, with the least a second train from there adds, exceeds the
+         * best transfer so far. As transfers rank in a total order, this finds the same transfer as trying them all.
+         */
+        std::optional<Transfer> best_transfer(const station_ordinal_t &from, const station_ordinal_t &to,
+                                              const Date &date, const std::string &sort_by) const {
+            const bool by_time = sort_by == "time";
+            TransferCandidates candidates;
+            if (not lay_out_transfers(from, to, date, candidates))
+                return std::nullopt;
+            const auto &[arriving, legs_by_station, legs_begin, least_price, least_ride, first_trains, first_stops] =
+                candidates;
+            // the least total time or cost of a transfer at stop of first_train
+            const auto bound = [&](const FirstTrain &first_train, const FirstStop &stop) -> long long {
+                return by_time ? candidates.time_bound(first_train, stop) : candidates.price_bound(stop);
+            };
+            const auto total = [by_time](const Transfer &transfer) -> long long {
+                return by_time ? total_time(transfer) : total_price(transfer);
+            };
+            // tried from the first train that could do best, so that the best transfer is found early and bounds the
+            // others
+            const auto order = norb::make_sorted(first_trains.size(), [&first_trains, by_time](const int &a,
+                                                                                              const int &b) {
+                return by_time ? first_trains[a].time_bound < first_trains[b].time_bound
+                               : first_trains[a].price_bound < first_trains[b].price_bound;
+            });
+
+            // the least total of the transfers found by any worker, bounding the search of all of them
+            std::atomic<long long> best_total = std::numeric_limits<long long>::max();
+            // tries every workers-th first train from worker on, keeping the best transfer found in best
+            const auto search = [&](const size_t &worker, const size_t &workers, std::optional<Transfer> &best,
+                                    size_t &pruned, size_t &tried) {
+                for (size_t n = worker; n < order.size(); n += workers) {
+                    const auto &first_train = first_trains[order[n]];
+                    // only ties with the best transfer may still take its place
+                    if ((by_time ? first_train.time_bound : first_train.price_bound) >
+                        best_total.load(std::memory_order_relaxed)) {
+                        for (; n < order.size(); n += workers)
+                            pruned += first_trains[order[n]].stops_end - first_trains[order[n]].stops_begin;
+                        break;
+                    }
+                    const auto train_group_id = first_train.train_id.first;
+                    Transfer candidate;
+                    candidate.first_train_name = first_train.train_group_name;
+                    candidate.first.train_id = first_train.train_id;
+                    candidate.first.from_station_serial = first_train.station_serial;
+                    candidate.first.from_time = first_train.from_time;
+                    for (int j = first_train.stops_begin; j < first_train.stops_end; ++j) {
+                        const auto &stop = first_stops[j];
+                        if (bound(first_train, stop) > best_total.load(std::memory_order_relaxed)) {
+                            ++pruned;
+                            continue;
+                        }
+                        ++tried;
+                        // the second train from the stop, per better_second
+                        std::optional<Leg> second;
+                        int second_train = 0;
+                        for (int i = legs_begin[stop.station]; i < legs_begin[stop.station + 1]; ++i) {
+                            const auto &leg = legs_by_station[i];
+                            if (arriving[leg.train].train_group_id == train_group_id)
+                                continue;
+                            const auto caught = catch_second(arriving[leg.train], leg, stop.arrival);
+                            if (not caught.has_value() ||
+                                (second.has_value() &&
+                                 not better_second(caught.value(), arriving[leg.train].train_group_name,
+                                                   second.value(), arriving[second_train].train_group_name, by_time)))
+                                continue;
+                            second = caught;
+                            second_train = leg.train;
+                        }
+                        if (not second.has_value())
+                            continue;
+                        candidate.first.to_station_serial = stop.station_serial;
+                        candidate.first.to_time = stop.arrival;
+                        candidate.first.price = stop.price;
+                        candidate.second = second.value();
+                        candidate.second_train_name = arriving[second_train].train_group_name;
+                        candidate.mid_station = stop.station;
+                        if (best.has_value() && not better(candidate, best.value(), by_time))
+                            continue;
+                        best = candidate;
+                        auto least = best_total.load(std::memory_order_relaxed);
+                        while (total(candidate) < least &&
+                               not best_total.compare_exchange_weak(least, total(candidate),
+                                                                    std::memory_order_relaxed)) {
+                        }
+                    }
+                }
+            };
+
+            std::optional<Transfer> best;
+            if (thread_pool_ == nullptr || first_stops.size() < transfer_parallel_min_candidates) {
+                size_t pruned = 0, tried = 0;
+                search(0, 1, best, pruned, tried);
+                pruned_transfers_ += pruned;
+                tried_transfers_ += tried;
+                return best;
+            }
+            // each worker keeps its own best, and the best of them is taken, which the ranking being a total order
+            // makes the same transfer as the main thread alone finds
+            const auto workers = thread_pool_->size();
+            norb::vector<std::optional<Transfer>> worker_best;
+            norb::vector<size_t> worker_pruned, worker_tried;
+            for (size_t worker = 0; worker < workers; ++worker) {
+                worker_best.push_back(std::nullopt);
+                worker_pruned.push_back(0);
+                worker_tried.push_back(0);
+            }
+            thread_pool_->run([&](const size_t worker) {
+                search(worker, workers, worker_best[worker], worker_pruned[worker], worker_tried[worker]);
+            });
+            for (size_t worker = 0; worker < workers; ++worker) {
+                if (worker_best[worker].has_value() &&
+                    (not best.has_value() || better(worker_best[worker].value(), best.value(), by_time)))
+                    best = worker_best[worker];
+                pruned_transfers_ += worker_pruned[worker];
+                tried_transfers_ += worker_tried[worker];
+            }
+            return best;
+        }
+
+        /**
+         * @brief The journeys from one station to another changing trains once, leaving on date, that no other is
+         * both as fast and as cheap as, by total time.
+         * @details The trains are laid out as for best_transfer, but every second train caught at a middle station is
+         * tried rather than the cheapest or the earliest to arrive, keeping the transfers found as a frontier of
+         * total time against cost. Of transfers as fast and as cheap as each other, the one query_transfer -p time
+         * ranks first is kept, so that the transfer of -p time is on the frontier, and the fastest of the cheapest is
+         * at least as fast as that of -p cost.
+         * A first train is left at a station once a transfer of the frontier is as fast and as cheap as the least
+         * time and cost a second train from there adds, and faster or cheaper. With transfer_threads above 1 each
+         * worker keeps a frontier of its own, merged into one at the end.
+         */
+        norb::vector<Transfer> pareto_transfers(const station_ordinal_t &from, const station_ordinal_t &to,
+                                                const Date &date) const {
+            TransferCandidates candidates;
+            if (not lay_out_transfers(from, to, date, candidates))
+                return {};
+            const auto &[arriving, legs_by_station, legs_begin, least_price, least_ride, first_trains, first_stops] =
+                candidates;
+            // the fastest first, as a fast transfer found early leaves out more of the others
+            const auto order = norb::make_sorted(first_trains.size(), [&first_trains](const int &a, const int &b) {
+                return first_trains[a].time_bound < first_trains[b].time_bound;
+            });
+
+            const auto search = [&](const size_t &worker, const size_t &workers, norb::vector<Transfer> &frontier,
+                                    size_t &pruned, size_t &tried) {
+                for (size_t n = worker; n < order.size(); n += workers) {
+                    const auto &first_train = first_trains[order[n]];
+                    if (dominated(frontier, first_train.time_bound, first_train.price_bound)) {
+                        pruned += first_train.stops_end - first_train.stops_begin;
+                        continue;
+                    }
+                    const auto train_group_id = first_train.train_id.first;
+                    Transfer candidate;
+                    candidate.first_train_name = first_train.train_group_name;
+                    candidate.first.train_id = first_train.train_id;
+                    candidate.first.from_station_serial = first_train.station_serial;
+                    candidate.first.from_time = first_train.from_time;
+                    for (int j = first_train.stops_begin; j < first_train.stops_end; ++j) {
+                        const auto &stop = first_stops[j];
+                        if (dominated(frontier, candidates.time_bound(first_train, stop),
+                                      candidates.price_bound(stop))) {
+                            ++pruned;
+                            continue;
+                        }
+                        ++tried;
+                        candidate.first.to_station_serial = stop.station_serial;
+                        candidate.first.to_time = stop.arrival;
+                        candidate.first.price = stop.price;
+                        candidate.mid_station = stop.station;
+                        for (int i = legs_begin[stop.station]; i < legs_begin[stop.station + 1]; ++i) {
+                            const auto &leg = legs_by_station[i];
+                            if (arriving[leg.train].train_group_id == train_group_id)
+                                continue;
+                            const auto caught = catch_second(arriving[leg.train], leg, stop.arrival);
+                            if (not caught.has_value())
+                                continue;
+                            candidate.second = caught.value();
+                            candidate.second_train_name = arriving[leg.train].train_group_name;
+                            add_to_frontier(frontier, candidate);
+                        }
+                    }
+                }
+            };
+
+            norb::vector<Transfer> frontier;
+            if (thread_pool_ == nullptr || first_stops.size() < transfer_parallel_min_candidates) {
+                size_t pruned = 0, tried = 0;
+                search(0, 1, frontier, pruned, tried);
+                pruned_transfers_ += pruned;
+                tried_transfers_ += tried;
+                return frontier;
+            }
+            // a transfer is left out of a frontier only for one at least as good, so the merged frontier does not
+            // depend on how the first trains were split
+            const auto workers = thread_pool_->size();
+            norb::vector<norb::vector<Transfer>> worker_frontier;
+            norb::vector<size_t> worker_pruned, worker_tried;
+            for (size_t worker = 0; worker < workers; ++worker) {
+                worker_frontier.push_back({});
+                worker_pruned.push_back(0);
+                worker_tried.push_back(0);
+            }
+            thread_pool_->run([&](const size_t worker) {
+                search(worker, workers, worker_frontier[worker], worker_pruned[worker], worker_tried[worker]);
+            });
+            for (size_t worker = 0; worker < workers; ++worker) {
+                for (const auto &transfer : worker_frontier[worker])
+                    add_to_frontier(frontier, transfer);
+                pruned_transfers_ += worker_pruned[worker];
+                tried_transfers_ += worker_tried[worker];
+            }
+            return frontier;
+        }
+
+        /**
+         * @brief The journeys from one station to another taking at most max_transfers + 1 trains, the first of them
+         * leaving on date, each arriving earlier than any with fewer trains, fewest trains first.
+         * @details A round-based search over the released timetable (RAPTOR): round r finds the earliest arrival at
+         * every station with at most r trains. It scans, once each, the trains through the stations reached earlier
+         * in round r - 1, boarding every train group at the first of its stations where a run can be caught. As in
+         * query_transfer, a run is caught if it leaves the station at or after the arrival there, and the first
+         * train is the run leaving the origin on date. An arrival is kept only if it is earlier than any at the same
+         * station or at the destination so far; between equally early arrivals the first found is kept.
+         * There are none if from is to or max_transfers is negative, which query_route reports as -1.
+         */
+        norb::vector<Route> pareto_routes(const station_ordinal_t &from, const station_ordinal_t &to, const Date &date,
+                                          const int &max_transfers) const {
+            norb::vector<Route> routes;
+            if (from == to || max_transfers < 0)
+                return routes;
+            constexpr int minutes_per_day = 24 * 60;
+            const auto station_count = train_manager_.station_id_vector.size();
+            const int rounds = max_transfers + 1;
+            // labels[r][s] is the earliest arrival at s with at most r trains
+            norb::vector<norb::vector<RouteLabel>> labels;
+            labels.push_back({});
+            for (size_t i = 0; i < station_count; ++i)
+                labels[0].push_back(RouteLabel());
+            labels[0][from].leg.to_time = Datetime(date);
+            labels[0][from].round = 0;
+            // the earliest arrival at each station in any round so far
+            norb::vector<int> earliest;
+            for (size_t i = 0; i < station_count; ++i)
+                earliest.push_back(std::numeric_limits<int>::max());
+            const int origin = Datetime(date).to_minutes();
+            earliest[from] = origin;
+            norb::vector<station_ordinal_t> marked = {from};
+
+            for (int round = 1; round <= rounds && not marked.empty(); ++round) {
+                const auto carried = labels[round - 1];
+                labels.push_back(carried);
+                const auto &previous = labels[round - 1];
+                auto &current = labels[round];
+                // every train group through a station reached in the last round, with the first such station on it
+                norb::map<train_group_id_t, int> boardings;
+                for (const auto &station : marked) {
+                    for (const auto &[train_group_id, stop] : train_manager_.stops_at(station)) {
+                        const auto found = boardings.find(train_group_id);
+                        if (found == boardings.end())
+                            boardings.insert({train_group_id, stop.station_serial});
+                        else
+                            found->second = std::min(found->second, stop.station_serial);
+                    }
+                }
+                norb::vector<station_ordinal_t> improved;
+                for (const auto &[train_group_id, first_serial] : boardings) {
+                    const auto &timetable = *train_manager_.get_timetable(train_group_id);
+                    // in minutes, as the scan meets every stop of the trains
+                    const int first_run = Datetime(timetable.train_group.sale_date_range.get_from()).to_minutes();
+                    const int last_run = Datetime(timetable.train_group.sale_date_range.get_to()).to_minutes();
+                    int run = -1; // the midnight starting the run on board
+                    int board_serial = 0, price = 0, board_price = 0;
+                    for (int i = first_serial; i < timetable.station_count; ++i) {
+                        const auto station = timetable.station_ordinals[i];
+                        if (i > 0)
+                            price += timetable.prices[i - 1];
+                        if (run >= 0) {
+                            const int arrival = run + timetable.arrival_times[i].to_minutes();
+                            if (arrival < std::min(earliest[station], earliest[to])) {
+                                if (current[station].round != round)
+                                    improved.push_back(station);
+                                earliest[station] = arrival;
+                                const auto run_date = Datetime::from_minutes(run).getDate();
+                                current[station] = {
+                                    Leg{train_id_t(train_group_id, run_date), board_serial, i,
+                                        Datetime(run_date) + timetable.departure_times[board_serial],
+                                        Datetime::from_minutes(arrival), price - board_price},
+                                    timetable.station_ordinals[board_serial], round};
+                            }
+                        }
+                        // the journeys start with the run leaving from on date, so from is boarded in round 1 only
+                        if (i + 1 == timetable.station_count || previous[station].round == -1 ||
+                            (station == from && round > 1))
+                            continue;
+                        // the earliest run to catch here, if earlier than the one on board
+                        const int departure = timetable.departure_times[i].to_minutes();
+                        int catchable;
+                        if (round == 1) {
+                            catchable = origin - departure / minutes_per_day * minutes_per_day;
+                        } else {
+                            const int reached = previous[station].leg.to_time.to_minutes();
+                            catchable = std::max(first_run, (reached - departure + minutes_per_day - 1) /
+                                                                minutes_per_day * minutes_per_day);
+                        }
+                        if (catchable < first_run || catchable > last_run || (run >= 0 && catchable >= run))
+                            continue;
+                        run = catchable;
+                        board_serial = i;
+                        board_price = price;
+                    }
+                }
+                marked = improved;
+            }
+
+            // a journey is new in the round that improved the arrival at to, and is followed back by its labels
+            for (int round = 1; round < static_cast<int>(labels.size()); ++round) {
+                if (labels[round][to].round != round)
+                    continue;
+                Route reversed;
+                for (auto label = labels[round][to]; label.round > 0;
+                     label = labels[label.round - 1][label.from_station])
+                    reversed.push_back(label.leg);
+                Route route;
+                for (size_t i = reversed.size(); i-- > 0;)
+                    route.push_back(reversed[i]);
+                routes.push_back(route);
+            }
+            return routes;
+        }
+    };
+} // namespace ticket
@@ -1,7 +1,37 @@
 #pragma once
 #include "interface.hpp"
+#include <persistent_memory.hpp>
 #include <utils.hpp>
 
+// Page sizes of the B+ trees. Overridable at compile time, see benchmark/bench_page_size.cpp
+#ifndef TICKET_LOOKUP_PAGE_SIZE
+#define TICKET_LOOKUP_PAGE_SIZE 4096
+#endif
+#ifndef TICKET_ORDER_PAGE_SIZE
+#define TICKET_ORDER_PAGE_SIZE 4096
+#endif
+// Whether the order history keeps its leaves compressed while not in use. Overridable at compile time
+#ifndef TICKET_COMPRESS_ORDERS
+#define TICKET_COMPRESS_ORDERS 1
+#endif
+// How query_ticket finds the trains between two stations, one of station_index_kind. Overridable at compile time,
+// see benchmark/bench_station_index.cpp
+#ifndef TICKET_STATION_INDEX
+#define TICKET_STATION_INDEX 1
+#endif
+// How many decoded trains TrainManager keeps in memory. Overridable at compile time
+#ifndef TICKET_TRAIN_CACHE_CAPACITY
+#define TICKET_TRAIN_CACHE_CAPACITY 512
+#endif
+// How many stations the transfer search keeps the reachable stations of, each way. Overridable at compile time
+#ifndef TICKET_REACHABLE_CACHE_CAPACITY
+#define TICKET_REACHABLE_CACHE_CAPACITY 256
+#endif
+// How many threads the transfer search runs on, 1 for none besides the main one. Overridable at compile time
+#ifndef TICKET_TRANSFER_THREADS
+#define TICKET_TRANSFER_THREADS 1
+#endif
+
 namespace ticket {
     inline constexpr int max_bytes_per_chinese_char = 4;
     inline constexpr int max_username_length = 20;
@@ -14,8 +44,31 @@ namespace ticket {
     inline constexpr int max_station_num = 100;
     inline constexpr int max_station_name_characters = 10;
 
-    inline constexpr const char train_group_segments_name[] = "train_group.segments";
-    inline constexpr const char train_fare_segments_name[] = "train_fare.segments";
+    // the station pair lookup and the order history are the stores scanned by range, hence the ones worth
+    // tuning; every other store answers point lookups and keeps the default page size
+    inline constexpr norb::page_size_t lookup_store_page_size = TICKET_LOOKUP_PAGE_SIZE;
+    inline constexpr norb::page_size_t order_store_page_size = TICKET_ORDER_PAGE_SIZE;
+    // orders are written once or twice and then only read back, and repeat their account and train in every
+    // record, which suits compression
+    inline constexpr norb::page_compression order_store_compression =
+        TICKET_COMPRESS_ORDERS ? norb::COMPRESSED_LEAVES : norb::UNCOMPRESSED;
+
+    // The pair table keeps an entry for every ordered pair of stations of a released train, answering a query with
+    // one lookup but taking O(n^2) entries per train. The station lists keep one entry per station of a train, and
+    // a query intersects the lists of both stations on the train. The station lists are kept in either case, as
+    // query_transfer is answered from them, see route_planner.hpp.
+    enum station_index_kind { STATION_PAIR_TABLE = 0, STATION_TRAIN_LISTS = 1 };
+    inline constexpr station_index_kind station_index = static_cast<station_index_kind>(TICKET_STATION_INDEX);
+
+    // a decoded train takes about 2 KiB, so the cache takes about 1 MiB at the default capacity
+    inline constexpr size_t train_cache_capacity = TICKET_TRAIN_CACHE_CAPACITY;
+    // a set takes a bit per station
+    inline constexpr size_t reachable_cache_capacity = TICKET_REACHABLE_CACHE_CAPACITY;
+
+    // the threads share the candidate transfers of a query once they are read from the stores, so a query with
+    // fewer candidates than transfer_parallel_min_candidates is left to the main thread, the handover costing more
+    inline constexpr size_t transfer_threads = TICKET_TRANSFER_THREADS;
+    inline constexpr size_t transfer_parallel_min_candidates = 4096;
 
     using global_hash_method = norb::hash::Fnv1a64Hash;
     using global_interface = TicketSystemStandardInterface;
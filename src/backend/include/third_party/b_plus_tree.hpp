@@ -1,10 +1,12 @@
 #pragma once
 
-#include "naive_persistent_memory.hpp"
+#include "key_codec.hpp"
 #include "persistent_memory.hpp"
 #include "stlite/pair.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <optional>
@@ -56,21 +58,44 @@ namespace norb {
         }
     } // namespace impl
 
+    /**
+     * @struct TreeRebuildReport
+     * @brief The number of pages and the height of a BPlusTree before and after BPlusTree::rebuild.
+     */
+    struct TreeRebuildReport {
+        size_t pages_before = 0;
+        size_t pages_after = 0;
+        size_t height_before = 0;
+        size_t height_after = 0;
+    };
+
     enum idx_type {
         AUTOMATIC = 0,
         MANUAL = 1,
     };
 
-    template <typename idx_t, typename val_t, const idx_type index_node_type = AUTOMATIC> class BPlusTree {
+    /**
+     * @class BPlusTree
+     * @tparam page_size The size of every node of the tree: a power-of-two multiple of PAGE_SIZE, up to
+     * MAX_PAGE_SIZE. Large pages suit scan-heavy trees, small ones suit point lookups.
+     * @note Composite keys with a KeyCodec are stored packed (see packed_key_t), so that node searches compare
+     * integers; the interface still takes and returns idx_t.
+     */
+    template <typename idx_t, typename val_t, const idx_type index_node_type = AUTOMATIC,
+              const page_size_t page_size = PAGE_SIZE>
+    class BPlusTree {
+        static_assert(is_valid_page_size(page_size), "Unsupported B+ tree page size");
+
       private:
+        // the stored form of idx_t
+        using stored_idx_t = packed_key_t<idx_t>;
         // automatic storage types
         using index_node_val_type_ = typename impl::index_value_type_helper<val_t>::type;
-        using automatic_index_storage_t = Pair<idx_t, index_node_val_type_>;
+        using automatic_index_storage_t = Pair<stored_idx_t, index_node_val_type_>;
         // automatic vs. manual
-        using index_storage_t = std::conditional_t<index_node_type == MANUAL, idx_t, automatic_index_storage_t>;
-        using leaf_storage_t = Pair<idx_t, val_t>;
+        using index_storage_t = std::conditional_t<index_node_type == MANUAL, stored_idx_t, automatic_index_storage_t>;
+        using leaf_storage_t = Pair<stored_idx_t, val_t>;
         using MutableHandle = PersistentMemory::MutableHandle;
-        template <typename val_t_> using TrackedConfig = NaivePersistentMemory::tracker_t_<val_t_>;
         using stack_frame_t_ = std::pair<MutableHandle, size_t>;
         enum node_type { index, leaf };
 
@@ -78,21 +103,21 @@ namespace norb {
         struct IndexNode;
         struct LeafNode;
 
-        TrackedConfig<size_t> tree_height = NaivePersistentMemory::track<size_t>(0);
-        TrackedConfig<size_t> tree_size = NaivePersistentMemory::track<size_t>(0);
-        TrackedConfig<MutableHandle> root_handle = NaivePersistentMemory::track<MutableHandle>();
+        // the root, height and size of the tree, kept in the superblock catalog under the name of the tree
+        PersistentMemory::CatalogEntry &catalog;
+        page_compression compression = UNCOMPRESSED;
 
         struct IndexNode {
             static constexpr size_t aux_var_size = sizeof(size_t) * 2; // layer, size
 #ifndef USE_SMALL_BATCH
             static constexpr size_t node_capacity =
-                (PAGE_SIZE - aux_var_size) / (sizeof(index_storage_t) + sizeof(MutableHandle)) - 1;
+                (page_size - aux_var_size) / (sizeof(index_storage_t) + sizeof(MutableHandle)) - 1;
 #else
             static constexpr size_t node_capacity = 8;
 #endif
             static constexpr size_t merge_threshold = node_capacity * .25f;
             static constexpr size_t split_threshold = node_capacity * .75f;
-            static_assert(PAGE_SIZE - aux_var_size > (sizeof(index_storage_t) + sizeof(MutableHandle)));
+            static_assert(page_size - aux_var_size > (sizeof(index_storage_t) + sizeof(MutableHandle)));
             static_assert(node_capacity >= 4);
 
             size_t layer = 0;
@@ -109,13 +134,13 @@ namespace norb {
         struct LeafNode {
             static constexpr size_t aux_var_size = sizeof(size_t) + sizeof(MutableHandle); // size, sibling
 #ifndef USE_SMALL_BATCH
-            static constexpr size_t node_capacity = (PAGE_SIZE - aux_var_size) / sizeof(leaf_storage_t);
+            static constexpr size_t node_capacity = (page_size - aux_var_size) / sizeof(leaf_storage_t);
 #else
             static constexpr size_t node_capacity = 8;
 #endif
             static constexpr size_t merge_threshold = node_capacity * .25f;
             static constexpr size_t split_threshold = node_capacity * .75f;
-            static_assert(PAGE_SIZE - aux_var_size > sizeof(leaf_storage_t));
+            static_assert(page_size - aux_var_size > sizeof(leaf_storage_t));
             static_assert(node_capacity >= 4);
 
             size_t size = 0;
@@ -125,12 +150,16 @@ namespace norb {
             // MutableHandle parent;
         };
 
-        static size_t lower_bound(const IndexNode &node, const idx_t &key) {
+        // The number of base pages every node spans; both node types must be stored in pages of the same size.
+        static constexpr page_size_t node_span = page_span_v<LeafNode>;
+        static_assert(page_span_v<IndexNode> == node_span);
+
+        static size_t lower_bound(const IndexNode &node, const stored_idx_t &key) {
             size_t left = 0, right = node.size;
             while (left < right) {
                 const size_t mid = (left + right) / 2;
                 if constexpr (index_node_type == MANUAL) {
-                    if (node.data[mid] >= key) // node.data[mid] is idx_t
+                    if (node.data[mid] >= key) // node.data[mid] is stored_idx_t
                         right = mid;
                     else
                         left = mid + 1;
@@ -152,7 +181,7 @@ namespace norb {
             while (l < r) {
                 const size_t mid = (l + r + 1) / 2;
                 if constexpr (index_node_type == MANUAL) {
-                    if (node.data[mid] > index.first) // node.data[mid] is idx_t, compare with index.first
+                    if (node.data[mid] > index.first) // node.data[mid] is stored_idx_t, compare with index.first
                         r = mid - 1;
                     else
                         l = mid;
@@ -166,7 +195,7 @@ namespace norb {
             return l;
         }
 
-        static size_t lower_bound(const LeafNode &node, const idx_t &key) {
+        static size_t lower_bound(const LeafNode &node, const stored_idx_t &key) {
             size_t left = 0, right = node.size;
             while (left < right) {
                 const size_t mid = (left + right) / 2;
@@ -190,37 +219,80 @@ namespace norb {
             return left;
         }
 
-        std::pair<MutableHandle, vector<stack_frame_t_>> stack_descend_to_leaf(const automatic_index_storage_t &index) {
-            MutableHandle handle = root_handle.val;
-            vector<stack_frame_t_> history;
-            for (int i = 0; i < tree_height.val - 1; i++) {
+        /**
+         * An upper bound on the height any tree of this type can reach: every non-root index node keeps at least
+         * max(2, merge_threshold) children, so a tree holding at most 2^64 entries cannot grow taller than this.
+         */
+        static constexpr size_t max_tree_height = [] {
+            constexpr size_t min_fanout = IndexNode::merge_threshold < 2 ? 2 : IndexNode::merge_threshold;
+            size_t height = 2; // root + leaf layer
+            for (unsigned __int128 reach = 1; reach < (static_cast<unsigned __int128>(1) << 64); reach *= min_fanout)
+                ++height;
+            return height;
+        }();
+
+        /**
+         * @brief The fixed-capacity descent path recorded by insert and remove.
+         * @details Lives on the stack of the caller, so that modifying the tree performs no heap allocation.
+         */
+        struct DescentPath {
+            stack_frame_t_ frames[max_tree_height];
+            size_t depth = 0;
+
+            void push_back(const stack_frame_t_ &frame) {
+                assert(depth < max_tree_height && "B+ tree height exceeds max_tree_height");
+                frames[depth++] = frame;
+            }
+            void pop_back() {
+                assert(depth > 0);
+                --depth;
+            }
+            [[nodiscard]] const stack_frame_t_ &back() const {
+                return frames[depth - 1];
+            }
+            [[nodiscard]] bool empty() const {
+                return depth == 0;
+            }
+        };
+
+        // Descends to the leaf that should hold index, recording every index node on the way in history.
+        MutableHandle stack_descend_to_leaf(const automatic_index_storage_t &index, DescentPath &history) {
+            MutableHandle handle = catalog.root;
+            for (int i = 0; i < catalog.height - 1; i++) {
                 const auto &index_node_ref = *handle.const_ref<IndexNode>();
                 const auto next_node_idx = lower_bound(index_node_ref, index);
                 history.push_back({handle, next_node_idx});
                 handle = index_node_ref.children[next_node_idx];
                 assert(!handle.is_nullptr());
             }
-            return std::make_pair(handle, history);
+            return handle;
         }
 
-        std::pair<MutableHandle, size_t> get_insertion_pos(const MutableHandle &starting_block,
-                                                           const leaf_storage_t &target) const {
-            const MutableHandle leaf = starting_block;
-            auto leaf_ptr = leaf.const_ref<LeafNode>().as_raw_ptr();
-            const auto insertion_pos = lower_bound(*leaf_ptr, target);
-            return std::make_pair(leaf, insertion_pos);
+        size_t get_insertion_pos(const MutableHandle &leaf, const leaf_storage_t &target) const {
+            return lower_bound(*leaf.const_ref<LeafNode>(), target);
+        }
+
+        MutableHandle create_leaf() const {
+            const MutableHandle handle = PersistentMemory::create_mutable_and_init<LeafNode>();
+            if (compression == COMPRESSED_LEAVES)
+                PersistentMemory::set_compressible(handle);
+            return handle;
         }
 
         bool handle_leaf_overflow(const stack_frame_t_ &frame) {
             auto parent_node_href = frame.first.ref<IndexNode>();
             const size_t insert_at_pos = frame.second; // This is the index of the child that overflowed
             auto old_node_href = parent_node_href->children[insert_at_pos].template ref<LeafNode>();
-            const MutableHandle new_node_handle = PersistentMemory::create_mutable_and_init<LeafNode>();
+            const MutableHandle new_node_handle = create_leaf();
             auto new_node_href = new_node_handle.ref<LeafNode>();
 
             const auto new_leaf_size = (new_node_href->size = old_node_href->size / 2);
             const auto remaining_size = (old_node_href->size -= new_leaf_size);
             array::migrate(new_node_href->data, old_node_href->data + remaining_size, new_leaf_size);
+            // the moved entries left behind would be compressed along with the live ones
+            if (compression == COMPRESSED_LEAVES)
+                std::memset(static_cast<void *>(old_node_href->data + remaining_size), 0,
+                            sizeof(leaf_storage_t) * new_leaf_size);
 
             new_node_href->sibling = old_node_href->sibling;
             old_node_href->sibling = new_node_handle;
@@ -263,26 +335,26 @@ namespace norb {
         void handle_root_overflow(const node_type &root_node_is) {
             const auto new_root_handle = PersistentMemory::create_mutable_and_init<IndexNode>();
             auto new_root_href = new_root_handle.template ref<IndexNode>();
-            new_root_href->layer = tree_height.val; // Current height, will be incremented effectively by new root
-            tree_height.val++;                      // Increment tree height
+            new_root_href->layer = catalog.height; // Current height, will be incremented effectively by new root
+            catalog.height++;                      // Increment tree height
 
             // New root initially points to the old root.
             // The old root (child 0 of new root) will then be split.
-            new_root_href->children[0] = root_handle.val;
+            new_root_href->children[0] = catalog.root;
 
             if (root_node_is == node_type::leaf) {
-                const auto &leaf_data_zero = root_handle.val.const_ref<LeafNode>()->data[0];
+                const auto &leaf_data_zero = catalog.root.const_ref<LeafNode>()->data[0];
                 if constexpr (index_node_type == MANUAL) {
                     new_root_href->data[0] = leaf_data_zero.first;
                 } else { // AUTOMATIC
                     new_root_href->data[0] = impl::get_hashed_pair(leaf_data_zero);
                 }
             } else { // root_node_is == node_type::index
-                new_root_href->data[0] = root_handle.val.const_ref<IndexNode>()->data[0];
+                new_root_href->data[0] = catalog.root.const_ref<IndexNode>()->data[0];
             }
             new_root_href->size = 1; // New root has one key and one child initially
 
-            root_handle.val = new_root_handle; // Update tree's root handle
+            catalog.root = new_root_handle; // Update tree's root handle
 
             // Now, split the child of the new root (which is the old root)
             if (root_node_is == node_type::index)
@@ -441,39 +513,49 @@ namespace norb {
         }
 
         void handle_root_underflow(const node_type &root_node_is) {
-            const auto old_root_handle = root_handle.val;
+            const auto old_root_handle = catalog.root;
             if (root_node_is == node_type::index) {
                 // An index root underflows if it has 0 keys (implying 1 child)
                 // This single child becomes the new root.
                 assert(old_root_handle.const_ref<IndexNode>()->size == 1 && // done part of fix
                        "Index root underflow implies 0 keys, 1 child");
-                root_handle.val = old_root_handle.const_ref<IndexNode>()->children[0];
+                catalog.root = old_root_handle.const_ref<IndexNode>()->children[0];
                 PersistentMemory::remove<IndexNode>(old_root_handle);
             } else { // Leaf root
                 // A leaf root underflows if it becomes empty.
                 assert(old_root_handle.const_ref<LeafNode>()->size == 0 && "Leaf root underflow implies 0 elements");
-                root_handle.val.set_nullptr(); // Tree is now empty
+                catalog.root.set_nullptr(); // Tree is now empty
                 PersistentMemory::remove<LeafNode>(old_root_handle);
             }
-            tree_height.val -= 1; // Height decreases in both cases
-            if (tree_height.val == 0) {
-                assert(root_handle.val.is_nullptr() && tree_size.val == 0);
+            catalog.height -= 1; // Height decreases in both cases
+            if (catalog.height == 0) {
+                assert(catalog.root.is_nullptr() && catalog.size == 0);
             }
         }
 
       public:
-        BPlusTree() = default;
+        // A tree keyed in the catalog by its order of construction.
+        BPlusTree() : BPlusTree(PersistentMemory::anonymous_name()) {
+        }
+        // A tree kept under a name in the catalog, independent of the order of construction.
+        explicit BPlusTree(const std::string &name) : catalog(PersistentMemory::catalog_entry(name)) {
+        }
+        // A named tree whose new leaves are compressed as chosen; leaves written before keep their setting.
+        BPlusTree(const std::string &name, const page_compression &compression) : BPlusTree(name) {
+            this->compression = compression;
+        }
         ~BPlusTree() = default;
 
         [[nodiscard]] size_t size() const {
-            return tree_size.val;
+            return catalog.size;
         }
 
-        void find_all_do(const idx_t &key, const std::function<void(const val_t &)> &function) const {
-            if (tree_height.val == 0)
+        void find_all_do(const idx_t &index, const std::function<void(const val_t &)> &function) const {
+            if (catalog.height == 0)
                 return;
-            MutableHandle handle = root_handle.val;
-            for (int i = 0; i < tree_height.val - 1; i++) {
+            const stored_idx_t key = pack_key(index);
+            MutableHandle handle = catalog.root;
+            for (int i = 0; i < catalog.height - 1; i++) {
                 const auto &index_node_ref = *handle.const_ref<IndexNode>();
                 const auto next_node_idx = lower_bound(index_node_ref, key);
                 handle = index_node_ref.children[next_node_idx];
@@ -502,11 +584,13 @@ namespace norb {
             return ret;
         }
 
-        void find_all_in_range_do(Range<idx_t> range, const std::function<void(const val_t &)> &function) const {
-            if (tree_height.val == 0 || range.is_empty())
+        void find_all_in_range_do(const Range<idx_t> &index_range,
+                                  const std::function<void(const val_t &)> &function) const {
+            if (catalog.height == 0 || index_range.is_empty())
                 return;
-            MutableHandle handle = root_handle.val;
-            for (int i = 0; i < tree_height.val - 1; i++) {
+            const Range<stored_idx_t> range = pack_range(index_range);
+            MutableHandle handle = catalog.root;
+            for (int i = 0; i < catalog.height - 1; i++) {
                 const auto &index_node_ref = *handle.const_ref<IndexNode>();
                 const auto next_node_idx = lower_bound(index_node_ref, range.get_from());
                 handle = index_node_ref.children[next_node_idx];
@@ -530,12 +614,13 @@ namespace norb {
             }
         }
 
-        void find_all_in_range_do(Range<idx_t> range,
+        void find_all_in_range_do(const Range<idx_t> &index_range,
                                   const std::function<void(const idx_t &, const val_t &)> &function) const {
-            if (tree_height.val == 0 || range.is_empty())
+            if (catalog.height == 0 || index_range.is_empty())
                 return;
-            MutableHandle handle = root_handle.val;
-            for (int i = 0; i < tree_height.val - 1; i++) {
+            const Range<stored_idx_t> range = pack_range(index_range);
+            MutableHandle handle = catalog.root;
+            for (int i = 0; i < catalog.height - 1; i++) {
                 const auto &index_node_ref = *handle.const_ref<IndexNode>();
                 const auto next_node_idx = lower_bound(index_node_ref, range.get_from());
                 handle = index_node_ref.children[next_node_idx];
@@ -549,7 +634,7 @@ namespace norb {
                     if (not range.contains_from_right(key_data))
                         return;
                     if (range.contains_from_left(key_data))
-                        function(key_data, leaf_node_ref->data[cur].second);
+                        function(unpack_key<idx_t>(key_data), leaf_node_ref->data[cur].second);
                 }
                 cur = 0;
                 handle = leaf_node_ref->sibling;
@@ -566,29 +651,31 @@ namespace norb {
             return ret;
         }
 
-        void insert(const idx_t &key, const val_t &val) {
-            if (tree_height.val == 0) { // Empty tree
-                root_handle.val = PersistentMemory::create_mutable_and_init<LeafNode>();
-                LeafNode &node = *root_handle.val.ref<LeafNode>();
+        void insert(const idx_t &index, const val_t &val) {
+            const stored_idx_t key = pack_key(index);
+            if (catalog.height == 0) { // Empty tree
+                catalog.root = create_leaf();
+                LeafNode &node = *catalog.root.ref<LeafNode>();
                 node.data[node.size++] = norb::make_pair(key, val);
-                tree_height.val = 1;
-                tree_size.val = 1;
+                catalog.height = 1;
+                catalog.size = 1;
                 return;
             }
 
-            tree_size.val++;
-            auto index_for_descent = norb::make_pair(key, impl::get_hashed_value(val));
-            auto [handle, history] = stack_descend_to_leaf(index_for_descent);
-            auto [leaf_node_handle, within_leaf_node_pos] = get_insertion_pos(handle, norb::make_pair(key, val));
+            catalog.size++;
+            const auto index_for_descent = norb::make_pair(key, impl::get_hashed_value(val));
+            const auto leaf_entry = norb::make_pair(key, val);
+            DescentPath history;
+            const MutableHandle leaf_node_handle = stack_descend_to_leaf(index_for_descent, history);
+            const size_t within_leaf_node_pos = get_insertion_pos(leaf_node_handle, leaf_entry);
             auto leaf_node_href = leaf_node_handle.template ref<LeafNode>();
 
-            array::insert_at(leaf_node_href->data, leaf_node_href->size, within_leaf_node_pos,
-                             norb::make_pair(key, val));
+            array::insert_at(leaf_node_href->data, leaf_node_href->size, within_leaf_node_pos, leaf_entry);
             ++leaf_node_href->size;
 
             bool needs_parent_split = false;
             if (leaf_node_href->size >= LeafNode::split_threshold) {
-                if (tree_height.val == 1) { // Root is the leaf that overflowed
+                if (catalog.height == 1) { // Root is the leaf that overflowed
                     handle_root_overflow(node_type::leaf);
                 } else { // Leaf is not root, propagate overflow upwards if needed
                     assert(!history.empty());
@@ -603,7 +690,7 @@ namespace norb {
             }
 
             if (needs_parent_split) { // Root (an index node) itself needs to split
-                assert(history.empty() && tree_height.val > 1);
+                assert(history.empty() && catalog.height > 1);
                 handle_root_overflow(node_type::index);
             }
         }
@@ -620,13 +707,15 @@ namespace norb {
             return counter;
         }
 
-        bool remove(const idx_t &key, const val_t &val) {
-            if (tree_height.val == 0)
+        bool remove(const idx_t &index, const val_t &val) {
+            if (catalog.height == 0)
                 return false;
+            const stored_idx_t key = pack_key(index);
 
-            auto index_for_descent = norb::make_pair(key, impl::get_hashed_value(val));
-            auto [handle, history] = stack_descend_to_leaf(index_for_descent);
-            auto [leaf_node_handle, within_leaf_node_pos] = get_insertion_pos(handle, norb::make_pair(key, val));
+            const auto index_for_descent = norb::make_pair(key, impl::get_hashed_value(val));
+            DescentPath history;
+            const MutableHandle leaf_node_handle = stack_descend_to_leaf(index_for_descent, history);
+            const size_t within_leaf_node_pos = get_insertion_pos(leaf_node_handle, norb::make_pair(key, val));
 
             const auto leaf_node_const_href = leaf_node_handle.template const_ref<LeafNode>();
             if constexpr (HasNeq<val_t>) {
@@ -640,13 +729,13 @@ namespace norb {
                     return false; // Element not found
             }
 
-            tree_size.val--;
+            catalog.size--;
             auto leaf_node_href = leaf_node_handle.template ref<LeafNode>();
             array::remove_at(leaf_node_href->data, leaf_node_href->size, within_leaf_node_pos);
             --leaf_node_href->size;
 
             bool needs_parent_merge = false;
-            if (tree_height.val == 1) {                     // Root is a leaf
+            if (catalog.height == 1) {                     // Root is a leaf
                 if (leaf_node_href->size == 0) {            // Root leaf became empty
                     handle_root_underflow(node_type::leaf); // Tree becomes empty
                 }
@@ -664,10 +753,10 @@ namespace norb {
             }
 
             if (needs_parent_merge) { // Root (an index node) itself underflowed
-                assert(history.empty() && tree_height.val > 1);
+                assert(history.empty() && catalog.height > 1);
                 // If index root has 0 keys (size refers to keys), it means it has 1 child.
                 // This child becomes the new root.
-                if (root_handle.val.const_ref<IndexNode>()->size <= 1) { // done does this fix work? seems to have
+                if (catalog.root.const_ref<IndexNode>()->size <= 1) { // done does this fix work? seems to have
                     handle_root_underflow(node_type::index);
                 }
             }
@@ -697,11 +786,12 @@ namespace norb {
             return keys_to_remove.size();
         }
 
-        void find_first_do(const idx_t &key, const std::function<void(const val_t &)> &function) const {
-            if (tree_height.val == 0)
+        void find_first_do(const idx_t &index, const std::function<void(const val_t &)> &function) const {
+            if (catalog.height == 0)
                 return;
-            MutableHandle handle = root_handle.val;
-            for (int i = 0; i < tree_height.val - 1; i++) {
+            const stored_idx_t key = pack_key(index);
+            MutableHandle handle = catalog.root;
+            for (int i = 0; i < catalog.height - 1; i++) {
                 const auto &index_node_ref = *handle.const_ref<IndexNode>();
                 const auto next_node_idx = lower_bound(index_node_ref, key);
                 handle = index_node_ref.children[next_node_idx];
@@ -736,11 +826,109 @@ namespace norb {
             return ret;
         }
 
-        void find_first_in_range_do(Range<idx_t> range, const std::function<void(const val_t &)> &function) const {
-            if (tree_height.val == 0 || range.is_empty())
+        /**
+         * @brief Look up the first value of every key in a batch.
+         * @details The keys descend the tree together, one level at a time, so that every index node and leaf on
+         * their paths is visited once for the whole batch. The pages of each level are prefetched in one sweep
+         * before they are read.
+         * @param sorted_keys The keys to look up, in ascending order; duplicates are allowed.
+         * @return For each key, the value find_first would return for it.
+         */
+        [[nodiscard]] vector<std::optional<val_t>> find_many(const vector<idx_t> &sorted_keys) const {
+            vector<std::optional<val_t>> ret;
+            for (size_t i = 0; i < sorted_keys.size(); ++i)
+                ret.push_back(std::nullopt);
+            if (catalog.height == 0 || sorted_keys.size() == 0)
+                return ret;
+
+            // the nodes of the current level, each with the run of keys [first, last) that descends through it
+            struct FrontierNode {
+                MutableHandle handle;
+                size_t first;
+                size_t last;
+            };
+            // packing preserves the order, so the packed keys are sorted as well
+            vector<stored_idx_t> keys;
+            for (size_t i = 0; i < sorted_keys.size(); ++i)
+                keys.push_back(pack_key(sorted_keys[i]));
+            vector<FrontierNode> frontier;
+            frontier.push_back(FrontierNode{catalog.root, 0, keys.size()});
+            for (int level = 0; level < catalog.height - 1; level++) {
+                vector<FrontierNode> next_frontier;
+                vector<page_id_t> next_pages;
+                for (size_t j = 0; j < frontier.size(); ++j) {
+                    const MutableHandle handle = frontier[j].handle;
+                    const auto index_node_ref = handle.const_ref<IndexNode>();
+                    for (size_t i = frontier[j].first; i < frontier[j].last; ++i) {
+                        const auto child = index_node_ref->children[lower_bound(*index_node_ref, keys[i])];
+                        assert(!child.is_nullptr());
+                        const size_t back = next_frontier.size() - 1;
+                        if (next_frontier.size() != 0 && next_frontier[back].handle.page_id == child.page_id &&
+                            next_frontier[back].last == i) {
+                            ++next_frontier[back].last;
+                        } else {
+                            next_frontier.push_back(FrontierNode{child, i, i + 1});
+                            next_pages.push_back(child.page_id);
+                        }
+                    }
+                }
+                PersistentMemory::prefetch(next_pages, node_span);
+                frontier = next_frontier;
+            }
+
+            for (size_t j = 0; j < frontier.size(); ++j) {
+                const MutableHandle handle = frontier[j].handle;
+                const auto leaf_node_ref = handle.const_ref<LeafNode>();
+                for (size_t i = frontier[j].first; i < frontier[j].last; ++i) {
+                    const size_t cur = lower_bound(*leaf_node_ref, keys[i]);
+                    if (cur < leaf_node_ref->size) {
+                        if (leaf_node_ref->data[cur].first == keys[i])
+                            ret[i] = leaf_node_ref->data[cur].second;
+                    } else {
+                        // the first match, if any, starts in a later leaf
+                        ret[i] = find_first(sorted_keys[i]);
+                    }
+                }
+            }
+            return ret;
+        }
+
+        /**
+         * @brief Apply function to every value, in key order, modifying it in place.
+         * @details The entries stay where they are, so function must not change how a value compares to others, nor
+         * its id under an AUTOMATIC index.
+         */
+        void modify_all_do(const std::function<void(val_t &)> &function) {
+            if (catalog.height == 0)
                 return;
-            MutableHandle handle = root_handle.val;
-            for (int i = 0; i < tree_height.val - 1; i++) {
+            MutableHandle handle = catalog.root;
+            for (int i = 0; i < catalog.height - 1; i++)
+                handle = handle.const_ref<IndexNode>()->children[0];
+            while (!handle.is_nullptr()) {
+                const auto leaf_node_href = handle.ref<LeafNode>();
+                for (size_t cur = 0; cur < leaf_node_href->size; ++cur) {
+                    auto &value = leaf_node_href->data[cur].second;
+#ifndef NDEBUG
+                    const val_t before = value;
+#endif
+                    function(value);
+                    if constexpr (impl::has_id_interface_v<val_t>) {
+                        assert(value.id() == before.id() && "modify_all_do changed the id of a value");
+                    } else if constexpr (IsComparable<val_t>) {
+                        assert(!(value < before) && !(before < value) && "modify_all_do changed the order of a value");
+                    }
+                }
+                handle = leaf_node_href->sibling;
+            }
+        }
+
+        void find_first_in_range_do(const Range<idx_t> &index_range,
+                                    const std::function<void(const val_t &)> &function) const {
+            if (catalog.height == 0 || index_range.is_empty())
+                return;
+            const Range<stored_idx_t> range = pack_range(index_range);
+            MutableHandle handle = catalog.root;
+            for (int i = 0; i < catalog.height - 1; i++) {
                 const auto &index_node_ref = *handle.const_ref<IndexNode>();
                 const auto next_node_idx = lower_bound(index_node_ref, range.get_from());
                 handle = index_node_ref.children[next_node_idx];
@@ -782,18 +970,18 @@ namespace norb {
                      (index_node_type == MANUAL || Ostreamable<index_node_val_type_>))
         {
             std::cout << "--- Traversing B+ Tree (" << this << ") ---" << std::endl;
-            std::cout << "[Info] Size: " << tree_size.val << ", Height: " << tree_height.val << std::endl;
+            std::cout << "[Info] Size: " << catalog.size << ", Height: " << catalog.height << std::endl;
 
-            if (root_handle.val.is_nullptr()) {
+            if (catalog.root.is_nullptr()) {
                 std::cout << "[Tree] Empty" << std::endl;
                 std::cout << "--- End Traversal ---" << std::endl << std::endl;
                 return;
             }
 
-            std::cout << "[Info] Root Page ID: " << root_handle.val.page_id << std::endl;
+            std::cout << "[Info] Root Page ID: " << catalog.root.page_id << std::endl;
 
             std::queue<std::pair<MutableHandle, size_t>> q;
-            q.emplace(root_handle.val, 0);
+            q.emplace(catalog.root, 0);
 
             size_t current_level = 0;
             std::cout << "Level " << current_level << ":" << std::endl;
@@ -807,7 +995,7 @@ namespace norb {
                     std::cout << "\nLevel " << current_level << ":" << std::endl; // Added newline for better formatting
                 }
 
-                bool is_leaf = (node_level == tree_height.val - 1);
+                bool is_leaf = (node_level == catalog.height - 1);
                 std::cout << "  Node (Page ID: " << current_handle.page_id << ") ";
 
                 if (is_leaf) {
@@ -825,15 +1013,15 @@ namespace norb {
                         for (size_t i = 0; i + 1 < node_ref->size; ++i) {
                             assert(node_ref->data[i] <= node_ref->data[i + 1] && "Leaf key order violation");
                         }
-                        if (tree_height.val > 1 && node_level < tree_height.val - 1) { // Not root or not the only node
+                        if (catalog.height > 1 && node_level < catalog.height - 1) { // Not root or not the only node
                             assert(node_ref->size >= LeafNode::merge_threshold && "Leaf underflow violation");
-                        } else if (tree_height.val == 1 && tree_size.val > 0 && node_ref->size == 0) {
+                        } else if (catalog.height == 1 && catalog.size > 0 && node_ref->size == 0) {
                             // This case can happen if the last element is removed from a root leaf.
                             // It should be handled by handle_root_underflow making the tree empty.
-                        } else if (tree_height.val > 1 && (node_ref->size) < LeafNode::merge_threshold &&
+                        } else if (catalog.height > 1 && (node_ref->size) < LeafNode::merge_threshold &&
                                    (node_ref->size) > 0) {
                             // This is an underflow if not root. Root leaf can have < merge_threshold elements.
-                            // The original check was `if (tree_height.val > 1)`
+                            // The original check was `if (catalog.height > 1)`
                             assert(node_ref->size >= LeafNode::merge_threshold &&
                                    "Leaf underflow violation (non-root)");
                         }
@@ -905,31 +1093,139 @@ namespace norb {
         }
 
       private:
-        void recursively_remove(MutableHandle &handle, const int h_from_root = 0) {
+        // Frees the subtree at handle, whose layers count height levels in total. Returns the number of pages freed.
+        size_t recursively_remove(MutableHandle &handle, const size_t &height, const size_t h_from_root = 0) {
             if (handle.is_nullptr())
-                return;
+                return 0;
 
-            if (h_from_root < tree_height.val - 1) { 
+            size_t freed = 1;
+            if (h_from_root + 1 < height) {
                 auto index_node_href = handle.ref<IndexNode>();
                 for (size_t i = 0; i < index_node_href->size; ++i) {
-                    recursively_remove(index_node_href->children[i], h_from_root + 1);
+                    freed += recursively_remove(index_node_href->children[i], height, h_from_root + 1);
                 }
                 PersistentMemory::remove<IndexNode>(handle);
             } else { // Leaf node
-                auto leaf_node_href = handle.ref<LeafNode>();
                 PersistentMemory::remove<LeafNode>(handle);
             }
             handle.set_nullptr();
+            return freed;
+        }
+
+        // The number of entries a rebuilt node should hold: the fill factor, bounded so that the node neither
+        // underflows on the next removal nor splits on the next insertion.
+        static size_t rebuild_fill(const float &fill_factor, const size_t &capacity, const size_t &merge_threshold,
+                                   const size_t &split_threshold) {
+            const size_t upper = split_threshold - 1;
+            const size_t lower = std::min(std::max<size_t>(2 * merge_threshold, 2), upper);
+            const auto target = static_cast<size_t>(static_cast<float>(capacity) * fill_factor);
+            return std::clamp(target, lower, upper);
         }
 
       public:
         void clear() {
-            if (tree_height.val == 0)
+            if (catalog.height == 0)
                 return;
-            recursively_remove(root_handle.val);
-            root_handle.val.set_nullptr();
-            tree_height.val = 0;
-            tree_size.val = 0;
+            recursively_remove(catalog.root, catalog.height);
+            catalog.root.set_nullptr();
+            catalog.height = 0;
+            catalog.size = 0;
+        }
+
+        /**
+         * @brief Rebuild the tree in key order into freshly reserved, contiguous pages.
+         * @details Each level is packed to fill_factor of the node capacity and spread evenly across its nodes. The
+         * new tree is built completely aside the old one, then the root and height are swapped in a single step and
+         * the old pages are handed to the garbage collector.
+         * @param fill_factor The target fraction of each node to fill, in (0, 1].
+         * @return The number of pages and the height before and after the rebuild.
+         */
+        TreeRebuildReport rebuild(const float &fill_factor) {
+            TreeRebuildReport report;
+            report.height_before = report.height_after = catalog.height;
+            if (catalog.height == 0)
+                return report;
+
+            // locate the leftmost leaf of the current tree
+            MutableHandle source = catalog.root;
+            for (int i = 0; i < catalog.height - 1; i++)
+                source = source.const_ref<IndexNode>()->children[0];
+            size_t source_cur = 0;
+
+            // stream every entry into the new leaf layer
+            const size_t total = catalog.size;
+            const size_t leaf_fill = rebuild_fill(fill_factor, LeafNode::node_capacity, LeafNode::merge_threshold,
+                                                  LeafNode::split_threshold);
+            const size_t leaf_count = (total + leaf_fill - 1) / leaf_fill;
+            const page_id_t first_leaf = PersistentMemory::allocate_contiguous(leaf_count, node_span);
+            vector<index_storage_t> level_keys;
+            vector<MutableHandle> level_nodes;
+            for (size_t k = 0; k < leaf_count; ++k) {
+                const MutableHandle handle = PersistentMemory::fetch_mutable_handle(first_leaf + k * node_span);
+                if (compression == COMPRESSED_LEAVES)
+                    PersistentMemory::set_compressible(handle);
+                auto leaf_href = handle.ref<LeafNode>();
+                new (leaf_href.as_raw_ptr()) LeafNode{};
+                const size_t count = total / leaf_count + (k < total % leaf_count);
+                while (leaf_href->size < count) {
+                    const auto source_href = source.const_ref<LeafNode>();
+                    if (source_cur == source_href->size) {
+                        source = source_href->sibling;
+                        source_cur = 0;
+                        continue;
+                    }
+                    while (leaf_href->size < count && source_cur < source_href->size)
+                        leaf_href->data[leaf_href->size++] = source_href->data[source_cur++];
+                }
+                if (k + 1 < leaf_count)
+                    leaf_href->sibling = PersistentMemory::fetch_mutable_handle(first_leaf + (k + 1) * node_span);
+                if constexpr (index_node_type == MANUAL) {
+                    level_keys.push_back(leaf_href->data[0].first);
+                } else { // AUTOMATIC
+                    level_keys.push_back(impl::get_hashed_pair(leaf_href->data[0]));
+                }
+                level_nodes.push_back(handle);
+            }
+            report.pages_after += leaf_count;
+
+            // build the index layers bottom-up until a single root remains
+            size_t height = 1;
+            const size_t index_fill = rebuild_fill(fill_factor, IndexNode::node_capacity, IndexNode::merge_threshold,
+                                                   IndexNode::split_threshold);
+            while (level_nodes.size() > 1) {
+                const size_t children_total = level_nodes.size();
+                const size_t node_count = (children_total + index_fill - 1) / index_fill;
+                const page_id_t first_node = PersistentMemory::allocate_contiguous(node_count, node_span);
+                vector<index_storage_t> upper_keys;
+                vector<MutableHandle> upper_nodes;
+                size_t cursor = 0;
+                for (size_t k = 0; k < node_count; ++k) {
+                    const MutableHandle handle = PersistentMemory::fetch_mutable_handle(first_node + k * node_span);
+                    auto node_href = handle.ref<IndexNode>();
+                    new (node_href.as_raw_ptr()) IndexNode{};
+                    node_href->layer = height;
+                    node_href->size = children_total / node_count + (k < children_total % node_count);
+                    for (size_t j = 0; j < node_href->size; ++j, ++cursor) {
+                        node_href->data[j] = level_keys[cursor];
+                        node_href->children[j] = level_nodes[cursor];
+                    }
+                    upper_keys.push_back(node_href->data[0]);
+                    upper_nodes.push_back(handle);
+                }
+                report.pages_after += node_count;
+                level_keys = upper_keys;
+                level_nodes = upper_nodes;
+                ++height;
+            }
+
+            // swap in the new root, then release the pages of the old tree
+            MutableHandle old_root = catalog.root;
+            const size_t old_height = catalog.height;
+            catalog.root = level_nodes[0];
+            catalog.height = height;
+            report.height_after = height;
+            report.pages_before = recursively_remove(old_root, old_height);
+            return report;
         }
     };
-} // namespace norb
\ No newline at end of file
+} // namespace norb
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "key_codec.hpp"
 #include "semantic_cast.hpp"
 #include <cassert>
 #include <iomanip>
@@ -432,6 +433,20 @@ namespace norb {
         return os;
     }
 
+    // Dates order by month, then by day; each is kept in a byte.
+    template <> struct KeyCodec<Datetime::Date> {
+        static constexpr bool packable = true;
+        static constexpr int bits = 16;
+
+        static constexpr key_word_t pack(const Datetime::Date &date) {
+            assert(date.month >= 0 && date.month < 256 && date.day >= 0 && date.day < 256);
+            return static_cast<key_word_t>(date.month) << 8 | static_cast<key_word_t>(date.day);
+        }
+        static constexpr Datetime::Date unpack(const key_word_t &word) {
+            return Datetime::Date(static_cast<int>(word >> 8 & 0xff), static_cast<int>(word & 0xff));
+        }
+    };
+
     inline Datetime::Date::operator Datetime() const {
         return Datetime::from_date(month, day);
     }
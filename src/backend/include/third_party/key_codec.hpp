@@ -0,0 +1,138 @@
+#pragma once
+
+#include "ntraits.hpp"
+#include "stlite/pair.hpp"
+#include "stlite/range.hpp"
+
+#include <concepts>
+#include <cstdint>
+#include <ostream>
+#include <type_traits>
+
+namespace norb {
+    using key_word_t = unsigned __int128;
+
+    /**
+     * @struct KeyCodec
+     * @brief Encodes keys of type T into unsigned integers of a fixed bit width, such that the integer order agrees
+     * with the order of T.
+     * @details A specialization provides packable = true, bits, and the pair pack / unpack. Types without one are
+     * not packable, and are compared through their own operators.
+     */
+    template <typename T> struct KeyCodec {
+        static constexpr bool packable = false;
+    };
+
+    // Integers are stored with the sign bit flipped, so that negative values order below the positive ones.
+    template <std::integral T> struct KeyCodec<T> {
+        using unsigned_t = std::make_unsigned_t<T>;
+        static constexpr bool packable = true;
+        static constexpr int bits = sizeof(T) * 8;
+        static constexpr unsigned_t sign_flip = std::is_signed_v<T> ? static_cast<unsigned_t>(1) << (bits - 1) : 0;
+
+        static constexpr key_word_t pack(const T &key) {
+            return static_cast<unsigned_t>(static_cast<unsigned_t>(key) ^ sign_flip);
+        }
+        static constexpr T unpack(const key_word_t &word) {
+            return static_cast<T>(static_cast<unsigned_t>(static_cast<unsigned_t>(word) ^ sign_flip));
+        }
+    };
+
+    // A pair is its first member in the high bits followed by its second member, the lexicographic order of Pair.
+    template <typename A, typename B>
+        requires(KeyCodec<A>::packable && KeyCodec<B>::packable && IsComparable<B> &&
+                 KeyCodec<A>::bits + KeyCodec<B>::bits <= 128)
+    struct KeyCodec<Pair<A, B>> {
+        static constexpr bool packable = true;
+        static constexpr int bits = KeyCodec<A>::bits + KeyCodec<B>::bits;
+        static constexpr key_word_t low_mask = (static_cast<key_word_t>(1) << KeyCodec<B>::bits) - 1;
+
+        static constexpr key_word_t pack(const Pair<A, B> &key) {
+            return KeyCodec<A>::pack(key.first) << KeyCodec<B>::bits | KeyCodec<B>::pack(key.second);
+        }
+        static constexpr Pair<A, B> unpack(const key_word_t &word) {
+            return Pair<A, B>{KeyCodec<A>::unpack(word >> KeyCodec<B>::bits), KeyCodec<B>::unpack(word & low_mask)};
+        }
+    };
+
+    namespace impl {
+        // The storage of a packed key: one or two 64-bit words, high word first, so that the defaulted comparison
+        // is the integer comparison. Kept at 8-byte alignment to not pad the nodes of the tree.
+        template <bool wide> struct packed_word {
+            uint64_t low = 0;
+
+            packed_word() = default;
+            explicit packed_word(const key_word_t &word) : low(static_cast<uint64_t>(word)) {
+            }
+            [[nodiscard]] key_word_t get() const {
+                return low;
+            }
+            auto operator<=>(const packed_word &other) const = default;
+            bool operator==(const packed_word &other) const = default;
+        };
+
+        template <> struct packed_word<true> {
+            uint64_t high = 0;
+            uint64_t low = 0;
+
+            packed_word() = default;
+            explicit packed_word(const key_word_t &word)
+                : high(static_cast<uint64_t>(word >> 64)), low(static_cast<uint64_t>(word)) {
+            }
+            [[nodiscard]] key_word_t get() const {
+                return static_cast<key_word_t>(high) << 64 | low;
+            }
+            auto operator<=>(const packed_word &other) const = default;
+            bool operator==(const packed_word &other) const = default;
+        };
+    } // namespace impl
+
+    /**
+     * @struct PackedKey
+     * @brief A key stored in its KeyCodec encoding, so that comparing two keys compares one or two integers.
+     */
+    template <typename T> struct PackedKey {
+        using codec_t = KeyCodec<T>;
+
+        impl::packed_word<(codec_t::bits > 64)> word;
+
+        PackedKey() = default;
+        PackedKey(const T &key) : word(codec_t::pack(key)) {
+        }
+
+        [[nodiscard]] T unpack() const {
+            return codec_t::unpack(word.get());
+        }
+
+        auto operator<=>(const PackedKey &other) const = default;
+        bool operator==(const PackedKey &other) const = default;
+    };
+
+    template <typename T> requires Ostreamable<T>
+    inline std::ostream &operator<<(std::ostream &os, const PackedKey<T> &key) {
+        return os << key.unpack();
+    }
+
+    // Scalars already compare in one instruction; only composite keys are worth packing.
+    template <typename T>
+    using packed_key_t = std::conditional_t<KeyCodec<T>::packable && !std::is_scalar_v<T>, PackedKey<T>, T>;
+
+    template <typename T> packed_key_t<T> pack_key(const T &key) {
+        return packed_key_t<T>(key);
+    }
+
+    template <typename T> T unpack_key(const packed_key_t<T> &key) {
+        if constexpr (std::is_same_v<packed_key_t<T>, T>) {
+            return key;
+        } else {
+            return key.unpack();
+        }
+    }
+
+    // The same interval over the packed keys; the encoding preserves order, so membership is unchanged.
+    template <typename T> Range<packed_key_t<T>> pack_range(const Range<T> &range) {
+        using Inclusiveness = typename Range<packed_key_t<T>>::Inclusiveness;
+        const auto type = static_cast<Inclusiveness>(range.get_inclusiveness_type());
+        return Range<packed_key_t<T>>(pack_key(range.get_from()), pack_key(range.get_to()), type);
+    }
+} // namespace norb
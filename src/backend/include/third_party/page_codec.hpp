@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace norb {
+    /**
+     * @class PageCodec
+     * @brief A small LZ77 codec for pages, in the block format of LZ4.
+     * @details A compressed page is a run of sequences, each a token byte (literal count in the high nibble, match
+     * length minus min_match in the low one, 15 meaning more length bytes follow), the literals, and a 2-byte offset
+     * back to the match. The last sequence has literals only. Pages are at most 64 KiB, so every offset fits in
+     * 2 bytes. Records in a B+ tree leaf repeat their keys and neighbouring fields, which this picks up as matches.
+     */
+    class PageCodec {
+        static constexpr size_t min_match = 4;
+        static constexpr size_t hash_bits = 12;
+        // the last bytes of a page are always literals, so a match never reads past its end
+        static constexpr size_t tail_literals = 5;
+
+        static uint32_t read32(const unsigned char *p) {
+            uint32_t word;
+            std::memcpy(&word, p, sizeof(word));
+            return word;
+        }
+
+        static size_t hash_of(const unsigned char *p) {
+            return read32(p) * 2654435761U >> (32 - hash_bits);
+        }
+
+        // Writes the extra bytes of a length beyond 15, returning false if out of room.
+        static bool write_length(unsigned char *&op, const unsigned char *end, size_t length) {
+            for (; length >= 255; length -= 255) {
+                if (op == end)
+                    return false;
+                *op++ = 255;
+            }
+            if (op == end)
+                return false;
+            *op++ = static_cast<unsigned char>(length);
+            return true;
+        }
+
+        static bool read_length(const unsigned char *&ip, const unsigned char *end, size_t &length) {
+            unsigned char byte;
+            do {
+                if (ip == end)
+                    return false;
+                byte = *ip++;
+                length += byte;
+            } while (byte == 255);
+            return true;
+        }
+
+      public:
+        static constexpr size_t max_input = 1 << 16;
+
+        /**
+         * @brief Compresses length bytes of src into dst.
+         * @return The compressed size, or 0 if it does not fit in capacity bytes.
+         */
+        static size_t compress(const char *src, const size_t length, char *dst, const size_t capacity) {
+            assert(length <= max_input);
+            const auto *const in = reinterpret_cast<const unsigned char *>(src);
+            auto *op = reinterpret_cast<unsigned char *>(dst);
+            const auto *const out_end = op + capacity;
+            uint16_t table[1 << hash_bits] = {};
+            size_t anchor = 0;
+            size_t pos = 1; // position 0 would be read as "no candidate" in the table
+            const size_t match_limit = length > tail_literals + min_match ? length - tail_literals : 0;
+            while (pos + min_match <= match_limit) {
+                const size_t hash = hash_of(in + pos);
+                const size_t candidate = table[hash];
+                table[hash] = static_cast<uint16_t>(pos);
+                if (candidate == 0 || read32(in + candidate) != read32(in + pos)) {
+                    ++pos;
+                    continue;
+                }
+                size_t match = min_match;
+                while (pos + match < match_limit && in[candidate + match] == in[pos + match])
+                    ++match;
+                const size_t literals = pos - anchor;
+                if (op == out_end)
+                    return 0;
+                unsigned char *token = op++;
+                *token = static_cast<unsigned char>((literals < 15 ? literals : 15) << 4);
+                if (literals >= 15 && not write_length(op, out_end, literals - 15))
+                    return 0;
+                if (static_cast<size_t>(out_end - op) < literals + 2)
+                    return 0;
+                std::memcpy(op, in + anchor, literals);
+                op += literals;
+                const size_t offset = pos - candidate;
+                *op++ = static_cast<unsigned char>(offset);
+                *op++ = static_cast<unsigned char>(offset >> 8);
+                const size_t extra = match - min_match;
+                *token |= static_cast<unsigned char>(extra < 15 ? extra : 15);
+                if (extra >= 15 && not write_length(op, out_end, extra - 15))
+                    return 0;
+                pos += match;
+                anchor = pos;
+            }
+            const size_t literals = length - anchor;
+            if (op == out_end)
+                return 0;
+            *op++ = static_cast<unsigned char>((literals < 15 ? literals : 15) << 4);
+            if (literals >= 15 && not write_length(op, out_end, literals - 15))
+                return 0;
+            if (static_cast<size_t>(out_end - op) < literals)
+                return 0;
+            std::memcpy(op, in + anchor, literals);
+            op += literals;
+            return op - reinterpret_cast<unsigned char *>(dst);
+        }
+
+        /**
+         * @brief Decompresses length bytes of src into exactly capacity bytes of dst.
+         * @return Whether src was a well-formed page of that size.
+         */
+        static bool decompress(const char *src, const size_t length, char *dst, const size_t capacity) {
+            const auto *ip = reinterpret_cast<const unsigned char *>(src);
+            const auto *const in_end = ip + length;
+            auto *const out = reinterpret_cast<unsigned char *>(dst);
+            size_t op = 0;
+            while (ip < in_end) {
+                const unsigned char token = *ip++;
+                size_t literals = token >> 4;
+                if (literals == 15 && not read_length(ip, in_end, literals))
+                    return false;
+                if (static_cast<size_t>(in_end - ip) < literals || capacity - op < literals)
+                    return false;
+                std::memcpy(out + op, ip, literals);
+                ip += literals;
+                op += literals;
+                if (ip == in_end)
+                    break; // the last sequence
+                if (in_end - ip < 2)
+                    return false;
+                const size_t offset = ip[0] | static_cast<size_t>(ip[1]) << 8;
+                ip += 2;
+                size_t match = token & 15;
+                if (match == 15 && not read_length(ip, in_end, match))
+                    return false;
+                match += min_match;
+                if (offset == 0 || offset > op || capacity - op < match)
+                    return false;
+                // byte by byte, as a match may overlap the bytes it produces
+                for (size_t i = 0; i < match; ++i, ++op)
+                    out[op] = out[op - offset];
+            }
+            return op == capacity;
+        }
+    };
+} // namespace norb
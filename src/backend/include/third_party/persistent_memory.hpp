@@ -4,11 +4,21 @@
 #include "stlite/vector.hpp"
 #include "utils.hpp"
 #include "settings.hpp"
+#include "write_ahead_log.hpp"
+#include "page_codec.hpp"
+#include "stlite/map.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
 #include <cmath>
+#include <cstddef>
 #include <filesystem>
+#include <cstring>
 #include <limits>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 
 namespace norb {
   using page_id_t = unsigned long;
@@ -18,7 +28,46 @@ namespace norb {
 
   constexpr page_size_t MEMORY_SIZE = 4096 * 1248;
   constexpr page_size_t PAGE_SIZE = 4096;
+  constexpr page_size_t MAX_PAGE_SIZE = PAGE_SIZE * 16;
   constexpr page_id_t LRU_K_INDEX = 20;
+  // whether the leaves of a tree are kept compressed while not in use, see
+  // PersistentMemory::set_compressible
+  enum page_compression {
+    UNCOMPRESSED = 0,
+    COMPRESSED_LEAVES = 1,
+  };
+  // group commit: the write-ahead log is synced every this many commands, or
+  // this often, whichever comes first
+  constexpr size_t WAL_GROUP_COMMIT_COMMANDS = 256;
+  constexpr std::chrono::milliseconds WAL_GROUP_COMMIT_INTERVAL{50};
+  // a fuzzy checkpoint starts once the log has grown this much since the
+  // last one, or this long after it, bounding the log recovery replays
+  constexpr lsn_t WAL_CHECKPOINT_BYTES = 16 << 20;
+  constexpr std::chrono::seconds WAL_CHECKPOINT_INTERVAL{30};
+  // the dirty pages a running checkpoint writes at the end of each command
+  constexpr size_t CHECKPOINT_PAGES_PER_COMMAND = 16;
+
+  /**
+   * @brief The number of consecutive base pages (of PAGE_SIZE bytes) a page
+   * holding the given number of bytes spans.
+   * @details Spans are always powers of two, so that pages of every size can
+   * share the buffer pool like buddies.
+   */
+  constexpr page_size_t page_span_of(const size_t &bytes) {
+    page_size_t span = 1;
+    while (span * PAGE_SIZE < bytes)
+      span *= 2;
+    return span;
+  }
+
+  template <typename T>
+  inline constexpr page_size_t page_span_v = page_span_of(sizeof(T));
+
+  // Whether page_size is a page size PersistentMemory can hold.
+  constexpr bool is_valid_page_size(const page_size_t &page_size) {
+    return page_size >= PAGE_SIZE && page_size <= MAX_PAGE_SIZE &&
+           page_size == page_span_of(page_size) * PAGE_SIZE;
+  }
 
   /**
    * @class PersistentMemory
@@ -26,6 +75,17 @@ namespace norb {
    * @remark The FileManager must be a singleton.
    * @remark References MEMORY_SIZE, PAGE_SIZE, LRU_K_INDEX, PMEM_FILE_NAME from
    * shared.hpp
+   * @remark Pages may be any power-of-two multiple of PAGE_SIZE up to
+   * MAX_PAGE_SIZE. A page of span n occupies n consecutive base pages on disk
+   * and an n-aligned run of n slots in the buffer.
+   * @remark Handles hold logical page ids. A page table maps each to the
+   * physical page, counted in base pages of the file, that holds it, so that
+   * snapshots can share physical pages with the current state and copy them
+   * only on write. The buffer pool is keyed by physical page.
+   * @remark Pages may be marked compressible. Those not in use are compressed
+   * whenever everything is written back, into extents of 512-byte sectors
+   * packed in base pages, and are read back from them. A write copies a
+   * compressed page out to a physical page of its own, as for a shared one.
    */
   class PersistentMemory {
   public:
@@ -54,42 +114,101 @@ namespace norb {
     static constexpr slot_id_t SLOT_COUNT = MEMORY_SIZE / PAGE_SIZE;
     static_assert(LRU_K_INDEX <= SLOT_COUNT,
                   "LRU_K_INDEX is larger than PAGE_COUNT");
+    static_assert(SLOT_COUNT % (MAX_PAGE_SIZE / PAGE_SIZE) == 0,
+                  "The buffer cannot be split into runs of the largest page");
+    static constexpr slot_id_t no_slot_ = static_cast<slot_id_t>(-1);
+    // one garbage collector per span: 1, 2, 4, ... base pages
+    static constexpr size_t SPAN_CLASS_COUNT = 5;
+    static_assert(1 << (SPAN_CLASS_COUNT - 1) == MAX_PAGE_SIZE / PAGE_SIZE);
+
+    static constexpr size_t span_class_of(const page_size_t &span) {
+      size_t span_class = 0;
+      while ((static_cast<page_size_t>(1) << span_class) < span)
+        ++span_class;
+      return span_class;
+    }
 
     class GarbageCollector;
 
     // private params
     time_stamp_t time_stamp = 1;
     page_id_t current_pages_in_disk = 0;
-    slot_id_t current_pages_in_buffer = 0;
+    // per-page bookkeeping lives at the first slot of the page
     LoopedQueue<time_stamp_t, LRU_K_INDEX> history[SLOT_COUNT];
     page_id_t buffer_page_id[SLOT_COUNT]{};
+    page_size_t buffer_page_span[SLOT_COUNT]{};
     bool is_dirty[SLOT_COUNT]{};
     short lock_count[SLOT_COUNT]{};
+    // the first slot of the page occupying each slot, no_slot_ if free
+    slot_id_t slot_owner[SLOT_COUNT];
+    // slots at and beyond this one have never held a page
+    slot_id_t buffer_high_water = 0;
+    // the first slot of each buffered page, indexed by page id; no_slot_ if not buffered
+    vector<slot_id_t> page_slot;
     char buffer[SLOT_COUNT][PAGE_SIZE];
 
     std::fstream fconfig;
     std::fstream fmemory;
+    // kept so that growing the file does not build a new path on every allocation
+    std::filesystem::path memory_path;
 
     // auxiliary functions
 
     // Returns the slot number for the page_id, -1 if not found
     slot_id_t find_page_id_in_buffer(const page_id_t &page_id) const {
-      for (slot_id_t id = 0; id < current_pages_in_buffer; id++) {
-        if (buffer_page_id[id] == page_id) {
-          return id;
-        }
+      if (page_id & EXTENT_KEY) {
+        const auto found = extent_slot.find(page_id);
+        return found == extent_slot.cend() ? no_slot_ : found->second;
       }
-      return -1;
+      return page_id < page_slot.size() ? page_slot[page_id] : -1;
     }
 
-    // Find the lru-k page from the buffer
-    slot_id_t get_lru_k() const {
+    void set_page_slot(const page_id_t &page_id, const slot_id_t &slot_id) {
+      if (not(page_id & EXTENT_KEY))
+        page_slot[page_id] = slot_id;
+      else if (slot_id != no_slot_)
+        extent_slot[page_id] = slot_id;
+      else
+        extent_slot.erase(extent_slot.find(page_id));
+    }
+
+    // Keep page_slot covering every page in the disk
+    void track_pages_in_disk() {
+      while (page_slot.size() < current_pages_in_disk)
+        page_slot.push_back(no_slot_);
+    }
+
+    // Find an aligned run of span slots to load a page into: the first free
+    // run if there is one, otherwise the run whose pages are the lru-k victims
+    slot_id_t get_lru_k(const page_size_t &span) const {
+      // fill the never-used part of the buffer first
+      const slot_id_t fresh = (buffer_high_water + span - 1) / span * span;
+      if (fresh + span <= SLOT_COUNT)
+        return fresh;
       std::pair<time_stamp_t, slot_id_t> evict_lru_k = {time_stamp_inf_, -1};
-      for (slot_id_t id = 0; id < current_pages_in_buffer; id++) {
-        if (lock_count[id])
+      for (slot_id_t group = 0; group < SLOT_COUNT; group += span) {
+        // a run is as recent as the most recent page it would evict
+        time_stamp_t score = 0;
+        bool evictable = true;
+        for (slot_id_t id = group; id < group + span;) {
+          const auto owner = slot_owner[id];
+          if (owner == no_slot_) {
+            ++id;
+            continue;
+          }
+          if (lock_count[owner]) {
+            evictable = false;
+            break;
+          }
+          score = std::max(score, history[owner].back());
+          id = owner + buffer_page_span[owner];
+        }
+        if (not evictable)
           continue;
-        if (history[id].back() < evict_lru_k.first) {
-          evict_lru_k = {history[id].back(), id};
+        if (score == 0)
+          return group;
+        if (score < evict_lru_k.first) {
+          evict_lru_k = {score, group};
         }
       }
       if (evict_lru_k.second == static_cast<slot_id_t>(-1))
@@ -97,30 +216,122 @@ namespace norb {
       return evict_lru_k.second;
     }
 
+    // Write a dirty page in place, keeping it in the buffer pool
+    void write_page(const slot_id_t &slot_id) {
+      if (not is_dirty[slot_id])
+        return;
+      // the log must hold every change before the page is written in place
+      if (wal)
+        wal->sync_up_to(page_lsn[slot_id]);
+      const page_id_t page_id = buffer_page_id[slot_id];
+      assert(not(page_id & EXTENT_KEY) && "Compressed pages are copied out before a write");
+      fmemory.seekp(page_id * PAGE_SIZE, std::ios::beg);
+      fmemory.write(buffer[slot_id], PAGE_SIZE * buffer_page_span[slot_id]);
+      assert(fmemory.good());
+      is_dirty[slot_id] = false;
+    }
+
     // Evict a page from the buffer pool
     void evict_page(const slot_id_t &slot_id) {
       assert(fmemory.good());
-      if (is_dirty[slot_id]) {
-        // write back to disk
-        const page_id_t page_id = buffer_page_id[slot_id];
-        fmemory.seekp(page_id * PAGE_SIZE, std::ios::beg);
-        fmemory.write(buffer[slot_id], PAGE_SIZE);
-        assert(fmemory.good());
+      log_page_delta(slot_id);
+      write_page(slot_id);
+    }
+
+    // Evict every page overlapping the run of span slots starting at group
+    void evict_run(const slot_id_t &group, const page_size_t &span) {
+      for (slot_id_t id = group; id < group + span;) {
+        const auto owner = slot_owner[id];
+        if (owner == no_slot_) {
+          ++id;
+          continue;
+        }
+        evict_page(owner);
+        set_page_slot(buffer_page_id[owner], no_slot_);
+        const auto owner_span = buffer_page_span[owner];
+        for (slot_id_t freed = owner; freed < owner + owner_span; freed++)
+          slot_owner[freed] = no_slot_;
+        id = owner + owner_span;
       }
     }
 
     // Register a page to the buffer pool
-    void load_page_from_disk(const page_id_t &page_id,
-                             const slot_id_t &slot_id) {
+    void load_page_from_disk(const page_id_t &page_id, const slot_id_t &slot_id,
+                             const page_size_t &span) {
       history[slot_id].insert(time_stamp++);
       buffer_page_id[slot_id] = page_id;
+      buffer_page_span[slot_id] = span;
+      is_dirty[slot_id] = false;
+      page_lsn[slot_id] = 0;
+      exclusive[slot_id] = false;
+      for (slot_id_t id = slot_id; id < slot_id + span; id++)
+        slot_owner[id] = slot_id;
+      buffer_high_water = std::max(buffer_high_water, slot_id + span);
+      set_page_slot(page_id, slot_id);
       // copy the disk info to the memory
       assert(fmemory.good());
+      if (page_id & EXTENT_KEY) {
+        read_extent(page_id, buffer[slot_id], PAGE_SIZE * span);
+        return;
+      }
       fmemory.seekg(page_id * PAGE_SIZE, std::ios::beg);
-      filesystem::binary_read(fmemory, buffer[slot_id]);
+      fmemory.read(buffer[slot_id], PAGE_SIZE * span);
       assert(fmemory.good());
     }
 
+    // Bring a page into the buffer if needed and pin it there
+    slot_id_t pin_page(const page_id_t &page_id, const page_size_t &span) {
+      auto slot_id = find_page_id_in_buffer(page_id);
+      if (slot_id == static_cast<slot_id_t>(-1)) {
+        slot_id = get_lru_k(span);
+        evict_run(slot_id, span);
+        load_page_from_disk(page_id, slot_id, span);
+      }
+      assert(buffer_page_span[slot_id] == span &&
+             "A page must always be accessed with the same size");
+      ++lock_count[slot_id];
+      return slot_id;
+    }
+
+    // Evict what the buffer holds of a recycled run of span base pages under
+    // another span, as a page split off a larger one or rebuilt by recover
+    // may be, so that it is neither found with the wrong span nor written
+    // over the run later
+    void evict_overlapping(const page_id_t &page_id, const page_size_t &span) {
+      const page_size_t max_span = MAX_PAGE_SIZE / PAGE_SIZE;
+      const page_id_t first = page_id < max_span ? 0 : page_id - max_span + 1;
+      for (page_id_t other = first; other < page_id + span; other++) {
+        const auto slot_id = find_page_id_in_buffer(other);
+        if (slot_id == no_slot_ || (other == page_id && buffer_page_span[slot_id] == span) ||
+            other + buffer_page_span[slot_id] <= page_id)
+          continue;
+        evict_run(slot_id, buffer_page_span[slot_id]);
+      }
+    }
+
+    // Reserve a new physical page of span base pages, recycling one if
+    // possible, or else the front of a larger one, whose rest is freed
+    page_id_t allocate_physical(const page_size_t &span) {
+      const auto span_class = span_class_of(span);
+      for (size_t larger = span_class; larger < SPAN_CLASS_COUNT; larger++) {
+        auto &collector = garbage_collector[larger];
+        if (not collector.available())
+          continue;
+        // recycle from the garbage collector
+        const auto page_id = collector.recycle();
+        for (size_t rest = larger; rest-- > span_class;)
+          garbage_collector[rest].dump(page_id + (static_cast<page_id_t>(1) << rest));
+        evict_overlapping(page_id, span);
+        return page_id;
+      }
+      // create a new page at the end of the file
+      const auto page_id = current_pages_in_disk;
+      current_pages_in_disk += span;
+      std::filesystem::resize_file(memory_path, current_pages_in_disk * PAGE_SIZE);
+      track_pages_in_disk();
+      return page_id;
+    }
+
     /**
      * @class GarbageCollector
      * @brief A helper class to collect deallocated pages.
@@ -146,8 +357,15 @@ namespace norb {
 
       [[nodiscard]] bool available() const { return not garbage.empty(); }
 
+      [[nodiscard]] const vector<page_id_t> &pages() const { return garbage; }
+
       void read_config(std::fstream &fconfig) {
-        vector_size_t size;
+        vector_size_t size = 0;
+        // configs written before mixed page sizes hold a single list
+        if (fconfig.peek() == std::char_traits<char>::eof()) {
+          fconfig.clear();
+          return;
+        }
         filesystem::binary_read(fconfig, size);
         for (vector_size_t i = 0; i < size; i++) {
           page_id_t page_id;
@@ -163,7 +381,7 @@ namespace norb {
           filesystem::binary_write(fconfig, garbage[i]);
         }
       }
-    } garbage_collector{};
+    } garbage_collector[SPAN_CLASS_COUNT]{};
 
     //! [Changelog] Change the two Reference types to implement lifespan-lock
     //! modeling
@@ -178,26 +396,12 @@ namespace norb {
       slot_id_t slot_id = 0;
 
       void allocate_page_and_update_slot() {
-        auto &pmem = get_instance();
-        slot_id = pmem.find_page_id_in_buffer(page_id);
-        if (slot_id == static_cast<slot_id_t>(-1)) {
-          if (pmem.current_pages_in_buffer < SLOT_COUNT) {
-            // create a new page
-            slot_id = pmem.current_pages_in_buffer++;
-          } else {
-            // use eviction to remove tree
-            slot_id = pmem.get_lru_k();
-            pmem.evict_page(slot_id);
-          }
-          pmem.load_page_from_disk(page_id, slot_id);
-        }
-        pmem.is_dirty[slot_id] = true;
-        ++pmem.lock_count[slot_id];
+        slot_id = get_instance().pin_logical_page(page_id, page_span_v<T>, true);
       }
 
     public:
       explicit HandledReference(const page_id_t &page_id) : page_id(page_id) {
-        if (page_id > get_instance().current_pages_in_disk) {
+        if (page_id >= get_instance().superblock.logical_page_count) {
           if (page_id == static_cast<page_id_t>(-1))
             throw std::invalid_argument("Nullptr cannot be dereferenced");
           else
@@ -245,26 +449,13 @@ namespace norb {
       slot_id_t slot_id = 0;
 
       void allocate_page_and_update_slot() {
-        auto &pmem = get_instance();
-        slot_id = pmem.find_page_id_in_buffer(page_id);
-        if (slot_id == static_cast<slot_id_t>(-1)) {
-          if (pmem.current_pages_in_buffer < SLOT_COUNT) {
-            // create a new page
-            slot_id = pmem.current_pages_in_buffer++;
-          } else {
-            // use eviction to remove tree
-            slot_id = pmem.get_lru_k();
-            pmem.evict_page(slot_id);
-          }
-          pmem.load_page_from_disk(page_id, slot_id);
-        }
-        ++pmem.lock_count[slot_id];
+        slot_id = get_instance().pin_logical_page(page_id, page_span_v<T>, false);
       }
 
     public:
       explicit ConstHandledReference(const page_id_t &page_id)
           : page_id(page_id) {
-        if (page_id > get_instance().current_pages_in_disk) {
+        if (page_id >= get_instance().superblock.logical_page_count) {
           if (page_id == static_cast<page_id_t>(-1))
             throw std::invalid_argument("Nullptr cannot be dereferenced");
           else
@@ -303,7 +494,8 @@ namespace norb {
       }
     };
 
-    explicit PersistentMemory(const std::string &path) {
+    explicit PersistentMemory(const std::string &path) : memory_path(path) {
+      std::fill(slot_owner, slot_owner + SLOT_COUNT, no_slot_);
       // create the file if it does not exist
       filesystem::fassert(path);
       filesystem::fassert(path + ".config");
@@ -315,28 +507,130 @@ namespace norb {
         fconfig.seekg(0, std::ios::beg);
         filesystem::binary_read(fconfig, current_pages_in_disk);
         // read the evicted pages
-        garbage_collector.read_config(fconfig);
+        for (auto &collector : garbage_collector)
+          collector.read_config(fconfig);
+        logical_garbage.read_config(fconfig);
+        for (auto &collector : extent_garbage)
+          collector.read_config(fconfig);
       }
       fmemory.open(path, std::ios::in | std::ios::out | std::ios::binary);
       assert(fmemory.good());
+      if (std::filesystem::file_size(memory_path) == 0) {
+        // a new file: forget any config left behind, and reserve the superblock slots
+        for (auto &collector : garbage_collector)
+          collector = GarbageCollector();
+        logical_garbage = GarbageCollector();
+        for (auto &collector : extent_garbage)
+          collector = GarbageCollector();
+        current_pages_in_disk = SUPERBLOCK_SLOT_COUNT;
+        std::filesystem::resize_file(memory_path, current_pages_in_disk * PAGE_SIZE);
+        superblock.logical_page_count = SUPERBLOCK_SLOT_COUNT;
+        write_superblock();
+      } else {
+        read_superblock();
+        // the file grows with every allocation, so its size is right even when the config is stale
+        current_pages_in_disk = std::filesystem::file_size(memory_path) / PAGE_SIZE;
+      }
+      track_pages_in_disk();
+      wal = std::make_unique<WriteAheadLog>(path + ".wal", WAL_GROUP_COMMIT_COMMANDS,
+                                            WAL_GROUP_COMMIT_INTERVAL);
+      if (wal->end_lsn() > superblock.checkpoint_lsn)
+        recover();
+      if (superblock.logical_page_count == 0)
+        convert_to_page_table();
+      refresh_sharing();
     }
     explicit PersistentMemory(const char *path)
         : PersistentMemory(std::string(path)) {}
 
     ~PersistentMemory() {
+      if (logging) {
+        end_command();
+        checkpoint();
+      } else {
+        write_back();
+      }
+      // close the streams
+      fconfig.close();
+      fmemory.close();
+    }
+
+    // Write every dirty page and the config, then publish the catalog in the superblock.
+    void write_back() {
+      compress_cold_pages();
       // update all dirty pages
-      for (slot_id_t slot = 0; slot < current_pages_in_buffer; slot++) {
+      for (slot_id_t slot = 0; slot < SLOT_COUNT; slot++) {
         // if locking fails, assert here to determine why
         // assert(lock_count[slot] == 0);
-        evict_page(slot);
+        if (slot_owner[slot] == slot)
+          evict_page(slot);
       }
+      fmemory.flush();
       // write the config to the fconfig
       fconfig.seekp(0, std::ios::beg);
       filesystem::binary_write(fconfig, current_pages_in_disk);
-      garbage_collector.write_config(fconfig);
-      // close the streams
-      fconfig.close();
-      fmemory.close();
+      for (const auto &collector : garbage_collector)
+        collector.write_config(fconfig);
+      logical_garbage.write_config(fconfig);
+      for (const auto &collector : extent_garbage)
+        collector.write_config(fconfig);
+      fconfig.flush();
+      write_superblock();
+    }
+
+    // Write everything back and make it durable, after which the log is no
+    // longer needed for recovery. See advance_checkpoint for the incremental
+    // checkpoints taken while commands run.
+    void checkpoint() {
+      checkpoint_running = false;
+      wal->sync();
+      superblock.checkpoint_lsn = 0; // the log starts over
+      write_back();
+      filesystem::sync_to_disk(memory_path.string());
+      filesystem::sync_to_disk(memory_path.string() + ".config");
+      wal->truncate();
+      catalog_before = superblock;
+      last_checkpoint = std::chrono::steady_clock::now();
+    }
+
+    // Take a fuzzy checkpoint a few pages at a time, between commands.
+    // Starting at LSN begin, it sweeps the buffer pool once, writing the dirty
+    // pages in place and keeping them buffered. When the sweep ends every
+    // change logged before begin is on disk, as the pages not swept were
+    // written on eviction, so begin becomes the checkpoint LSN recovery
+    // replays from, and the log before it is dropped.
+    void advance_checkpoint() {
+      const auto now = std::chrono::steady_clock::now();
+      if (not checkpoint_running) {
+        const lsn_t logged = wal->end_lsn() - superblock.checkpoint_lsn;
+        if (logged < WAL_CHECKPOINT_BYTES &&
+            (logged == 0 || now - last_checkpoint < WAL_CHECKPOINT_INTERVAL))
+          return;
+        checkpoint_running = true;
+        checkpoint_begin = wal->end_lsn();
+        checkpoint_cursor = 0;
+      }
+      for (size_t written = 0; checkpoint_cursor < buffer_high_water &&
+                               written < CHECKPOINT_PAGES_PER_COMMAND;
+           checkpoint_cursor++) {
+        if (slot_owner[checkpoint_cursor] == checkpoint_cursor &&
+            is_dirty[checkpoint_cursor]) {
+          write_page(checkpoint_cursor);
+          written++;
+        }
+      }
+      if (checkpoint_cursor < buffer_high_water)
+        return;
+      fmemory.flush();
+      filesystem::sync_to_disk(memory_path.string());
+      // the catalog written with it holds commands that must be in the log
+      wal->sync();
+      superblock.checkpoint_lsn = catalog_before.checkpoint_lsn = checkpoint_begin;
+      write_superblock();
+      filesystem::sync_to_disk(memory_path.string());
+      wal->discard_before(checkpoint_begin);
+      checkpoint_running = false;
+      last_checkpoint = now;
     }
 
   public:
@@ -418,23 +712,1039 @@ namespace norb {
       void set_nullptr() { page_id = static_cast<page_id_t>(-1); }
     };
 
+    /**
+     * @struct CatalogEntry
+     * @brief The persistent state of a structure stored in the pages: its
+     * root page and two counters, kept in the superblock under its name.
+     * @details A BPlusTree keeps its height and size here, a PagedSegmentList
+     * its directory depth and element count.
+     */
+    struct CatalogEntry {
+      static constexpr size_t max_name_length = 39;
+
+      char name[max_name_length + 1]{};
+      MutableHandle root;
+      uint64_t height = 0;
+      uint64_t size = 0;
+    };
+
+  private:
+    /**
+     * @struct Superblock
+     * @brief The catalog of every named structure in the file.
+     * @details Two slots at base pages 0 and 1 hold alternate versions: an
+     * update is written to the older slot, so the newer one survives a torn
+     * write and is picked by sequence and checksum on startup.
+     */
+    struct Superblock {
+      static constexpr uint32_t magic_v = 0x4253504e; // "NPSB"
+      static constexpr uint32_t current_version = 1;
+      static constexpr size_t header_size = 32;
+      static constexpr size_t capacity =
+          (PAGE_SIZE - header_size) / sizeof(CatalogEntry);
+
+      uint32_t magic = magic_v;
+      uint32_t version = current_version;
+      uint64_t sequence = 0;
+      uint64_t checksum = 0;
+      uint64_t entry_count = 0;
+      CatalogEntry entries[capacity];
+      // the rest lies in the slack after the entries, which older superblocks
+      // read as zero
+      // where recovery starts reading the write-ahead log
+      lsn_t checkpoint_lsn = 0;
+      // the page table of the current state, and the logical page ids it
+      // spans; both 0 in files written before the page table
+      page_id_t page_table_root = 0;
+      page_id_t logical_page_count = 0;
+      // the physical page listing the snapshots, 0 if none was ever taken
+      page_id_t snapshot_directory = 0;
+
+      [[nodiscard]] uint64_t compute_checksum() const {
+        Superblock copy = *this;
+        copy.checksum = 0;
+        return hash::Fnv1a64Hash::hash(
+            std::string(reinterpret_cast<const char *>(&copy), sizeof(copy)));
+      }
+    };
+    static_assert(sizeof(Superblock) <= PAGE_SIZE);
+    // the part of the superblock logged as catalog deltas; the checkpoint LSN
+    // in it is kept out of them, see advance_checkpoint
+    static constexpr size_t catalog_offset = offsetof(Superblock, entry_count);
+    static constexpr size_t catalog_length = sizeof(Superblock) - catalog_offset;
+    static constexpr page_id_t SUPERBLOCK_SLOT_COUNT = 2;
+
+    Superblock superblock;
+    // the number of structures opened without a name so far
+    size_t anonymous_count = 0;
+
+    // Load the newest valid superblock slot, both slots in one read
+    void read_superblock() {
+      const std::unique_ptr<char[]> bytes(new char[SUPERBLOCK_SLOT_COUNT * PAGE_SIZE]);
+      fmemory.seekg(0, std::ios::beg);
+      fmemory.read(bytes.get(), SUPERBLOCK_SLOT_COUNT * PAGE_SIZE);
+      assert(fmemory.good());
+      std::unique_ptr<Superblock[]> slots(new Superblock[SUPERBLOCK_SLOT_COUNT]);
+      const Superblock *newest = nullptr;
+      for (page_id_t slot = 0; slot < SUPERBLOCK_SLOT_COUNT; slot++) {
+        auto &candidate = slots[slot];
+        std::memcpy(&candidate, bytes.get() + slot * PAGE_SIZE, sizeof(Superblock));
+        if (candidate.magic != Superblock::magic_v ||
+            candidate.version != Superblock::current_version ||
+            candidate.checksum != candidate.compute_checksum())
+          continue;
+        if (newest == nullptr || candidate.sequence > newest->sequence)
+          newest = &candidate;
+      }
+      if (newest == nullptr)
+        throw std::runtime_error("PersistentMemory: NO VALID SUPERBLOCK!");
+      superblock = *newest;
+    }
+
+    // Publish the catalog into the slot not holding the current version
+    void write_superblock() {
+      ++superblock.sequence;
+      superblock.checksum = superblock.compute_checksum();
+      fmemory.seekp((superblock.sequence % SUPERBLOCK_SLOT_COUNT) * PAGE_SIZE,
+                    std::ios::beg);
+      fmemory.write(reinterpret_cast<const char *>(&superblock),
+                    sizeof(Superblock));
+      fmemory.flush();
+      assert(fmemory.good());
+    }
+
+    // write-ahead logging, see enable_logging
+    enum wal_record_t : uint32_t {
+      WAL_PAGE_DELTA = 1,    // DeltaHeader, then the changed ranges of a page
+      WAL_CATALOG_DELTA = 2, // DeltaHeader, then the changed ranges of the catalog
+      WAL_COMMIT = 3,        // CommitRecord, closing a command
+    };
+    struct DeltaHeader {
+      uint64_t command = 0;
+      page_id_t page_id = 0;
+      page_size_t span = 0;
+      uint64_t range_count = 0;
+    };
+    struct RangeHeader {
+      uint32_t offset = 0;
+      uint32_t length = 0;
+    };
+    struct CommitRecord {
+      uint64_t command = 0;
+      page_id_t pages_in_disk = 0;
+    };
+
+    std::unique_ptr<WriteAheadLog> wal;
+    bool logging = false;
+    uint64_t command_count = 0;
+    // the image of each page at its first change in the running command,
+    // kept at the first slot of the page
+    char before_image[SLOT_COUNT][PAGE_SIZE];
+    bool captured[SLOT_COUNT]{};
+    vector<slot_id_t> captured_slots;
+    // the end of the last log record of each buffered page
+    lsn_t page_lsn[SLOT_COUNT]{};
+    Superblock catalog_before;
+    std::string delta_scratch;
+    // the fuzzy checkpoint in progress, see advance_checkpoint
+    bool checkpoint_running = false;
+    lsn_t checkpoint_begin = 0;
+    slot_id_t checkpoint_cursor = 0;
+    std::chrono::steady_clock::time_point last_checkpoint =
+        std::chrono::steady_clock::now();
+
+    // Encode the 8-byte words that differ between before and after as
+    // ranges of old and new bytes, nearby runs merged. Returns the count.
+    static uint64_t encode_delta(const char *before, const char *after,
+                                 const size_t length, std::string &out) {
+      constexpr size_t word = sizeof(uint64_t);
+      constexpr size_t merge_gap = 2; // words
+      const auto differs = [&](const size_t i) {
+        return std::memcmp(before + i * word, after + i * word, word) != 0;
+      };
+      const size_t words = length / word;
+      uint64_t range_count = 0;
+      out.clear();
+      for (size_t i = 0; i < words; i++) {
+        if (not differs(i))
+          continue;
+        size_t last = i;
+        for (size_t j = i + 1; j < words && j - last <= merge_gap; j++) {
+          if (differs(j))
+            last = j;
+        }
+        const RangeHeader range{static_cast<uint32_t>(i * word),
+                                static_cast<uint32_t>((last + 1 - i) * word)};
+        out.append(reinterpret_cast<const char *>(&range), sizeof(range));
+        out.append(before + range.offset, range.length);
+        out.append(after + range.offset, range.length);
+        ++range_count;
+        i = last;
+      }
+      return range_count;
+    }
+
+    // Copy the new bytes (redo) or the old bytes (undo) of encoded ranges
+    static void apply_delta(char *target, const char *ranges,
+                            const uint64_t range_count, const bool redo) {
+      for (uint64_t i = 0; i < range_count; i++) {
+        RangeHeader range;
+        std::memcpy(&range, ranges, sizeof(range));
+        ranges += sizeof(range);
+        std::memcpy(target + range.offset, redo ? ranges + range.length : ranges,
+                    range.length);
+        ranges += 2 * range.length;
+      }
+    }
+
+    // Remember a page as it was before the running command changed it
+    void capture_before_image(const slot_id_t &slot_id) {
+      if (not logging || captured[slot_id])
+        return;
+      std::memcpy(before_image[slot_id], buffer[slot_id],
+                  PAGE_SIZE * buffer_page_span[slot_id]);
+      captured[slot_id] = true;
+      captured_slots.push_back(slot_id);
+    }
+
+    // Log what the running command changed in a page so far
+    void log_page_delta(const slot_id_t &slot_id) {
+      if (not captured[slot_id])
+        return;
+      captured[slot_id] = false;
+      const auto span = buffer_page_span[slot_id];
+      DeltaHeader header{command_count, buffer_page_id[slot_id], span, 0};
+      header.range_count = encode_delta(before_image[slot_id], buffer[slot_id],
+                                        PAGE_SIZE * span, delta_scratch);
+      if (header.range_count == 0)
+        return;
+      page_lsn[slot_id] = wal->append(WAL_PAGE_DELTA, &header, sizeof(header),
+                                      delta_scratch.data(), delta_scratch.size());
+    }
+
+    // Log the changes of the running command and close it
+    void commit_command() {
+      for (const auto &slot_id : captured_slots)
+        log_page_delta(slot_id);
+      captured_slots.clear();
+      DeltaHeader header{command_count, static_cast<page_id_t>(-1), 0, 0};
+      header.range_count =
+          encode_delta(reinterpret_cast<const char *>(&catalog_before) + catalog_offset,
+                       reinterpret_cast<const char *>(&superblock) + catalog_offset,
+                       catalog_length, delta_scratch);
+      if (header.range_count != 0) {
+        wal->append(WAL_CATALOG_DELTA, &header, sizeof(header),
+                    delta_scratch.data(), delta_scratch.size());
+        catalog_before = superblock;
+      }
+      const CommitRecord commit{command_count++, current_pages_in_disk};
+      wal->append(WAL_COMMIT, &commit, sizeof(commit));
+      wal->group_commit();
+    }
+
+    // Bring the pages and the catalog to the last command committed to the
+    // log: redo every change logged since the checkpoint LSN, then undo those
+    // of the unfinished command. The free lists in the config are only
+    // written on a clean shutdown, so they are rebuilt from the page tables.
+    void recover() {
+      vector<std::string> unfinished;
+      const auto patch = [this](const std::string &record, const bool redo) {
+        DeltaHeader header;
+        std::memcpy(&header, record.data(), sizeof(header));
+        const char *ranges = record.data() + sizeof(header);
+        if (header.page_id == static_cast<page_id_t>(-1)) {
+          apply_delta(reinterpret_cast<char *>(&superblock) + catalog_offset,
+                      ranges, header.range_count, redo);
+          return;
+        }
+        if (header.page_id + header.span > current_pages_in_disk) {
+          current_pages_in_disk = header.page_id + header.span;
+          std::filesystem::resize_file(memory_path,
+                                       current_pages_in_disk * PAGE_SIZE);
+          track_pages_in_disk();
+        }
+        const auto slot_id = pin_page(header.page_id, header.span);
+        apply_delta(buffer[slot_id], ranges, header.range_count, redo);
+        is_dirty[slot_id] = true;
+        --lock_count[slot_id];
+      };
+      wal->replay(superblock.checkpoint_lsn, [&](const uint32_t type, const char *payload,
+                      const size_t length) {
+        if (type == WAL_COMMIT) {
+          unfinished.clear();
+          return;
+        }
+        const std::string record(payload, length);
+        patch(record, true);
+        unfinished.push_back(record);
+      });
+      for (size_t i = unfinished.size(); i-- > 0;)
+        patch(unfinished[i], false);
+      if (superblock.logical_page_count != 0) {
+        rebuild_physical_garbage();
+      } else {
+        // a file from before the page table has nothing to rebuild them
+        // from, and leaks what was freed since the last clean shutdown
+        for (auto &collector : garbage_collector)
+          collector = GarbageCollector();
+        for (auto &collector : extent_garbage)
+          collector = GarbageCollector();
+      }
+      rebuild_logical_garbage();
+      refresh_sharing();
+      checkpoint();
+    }
+
+    // the page table: a radix tree of physical pages, TABLE_DEPTH levels deep,
+    // whose leaves hold a table_entry_t per logical page id
+    static constexpr size_t TABLE_FANOUT = PAGE_SIZE / sizeof(page_id_t);
+    static constexpr int TABLE_DEPTH = 3;
+    static constexpr page_id_t no_page_ = static_cast<page_id_t>(-1);
+    // a physical page and its span class, 0 if the logical page is free; a
+    // compressed page has an extent in place of the physical page
+    using table_entry_t = uint64_t;
+    // the references to a physical page or extent beyond the first
+    using refcount_t = uint32_t;
+
+    static constexpr table_entry_t ENTRY_COMPRESSIBLE = 1ULL << 63;
+    static constexpr table_entry_t ENTRY_COMPRESSED = 1ULL << 62;
+
+    static constexpr table_entry_t make_entry(const page_id_t &physical,
+                                              const size_t &span_class) {
+      return physical << 3 | span_class;
+    }
+    static constexpr page_id_t entry_page(const table_entry_t &entry) {
+      return (entry & ~(ENTRY_COMPRESSIBLE | ENTRY_COMPRESSED)) >> 3;
+    }
+    static constexpr size_t entry_span_class(const table_entry_t &entry) {
+      return entry & 7;
+    }
+
+    // extents: a run of 1 to SECTORS_PER_PAGE sectors within a base page,
+    // known to the buffer pool by a key of their own
+    static constexpr size_t SECTOR_SIZE = 512;
+    static constexpr size_t SECTORS_PER_PAGE = PAGE_SIZE / SECTOR_SIZE;
+    static constexpr page_id_t EXTENT_KEY = 1ULL << 63;
+    // the reference counts of extents follow those of the physical pages
+    static constexpr uint64_t EXTENT_REFCOUNT_BASE = 1ULL << 27;
+
+    static constexpr page_id_t extent_key(const uint64_t &sector, const size_t &sectors) {
+      return EXTENT_KEY | sector << 3 | (sectors - 1);
+    }
+    static constexpr uint64_t key_sector(const page_id_t &key) {
+      return (key & ~EXTENT_KEY) >> 3;
+    }
+    static constexpr size_t key_sectors(const page_id_t &key) {
+      return (key & 7) + 1;
+    }
+    static constexpr table_entry_t make_extent_entry(const page_id_t &key,
+                                                     const size_t &span_class) {
+      return ENTRY_COMPRESSIBLE | ENTRY_COMPRESSED |
+             make_entry(key & ~EXTENT_KEY, span_class);
+    }
+    // The key of the page in the buffer pool: its physical page or extent
+    static constexpr page_id_t entry_key(const table_entry_t &entry) {
+      return entry & ENTRY_COMPRESSED ? EXTENT_KEY | entry_page(entry)
+                                      : entry_page(entry);
+    }
+    static constexpr uint64_t refcount_index(const table_entry_t &entry) {
+      return entry & ENTRY_COMPRESSED
+                 ? EXTENT_REFCOUNT_BASE + key_sector(entry_key(entry))
+                 : entry_page(entry);
+    }
+
+    /**
+     * @struct SnapshotDirectory
+     * @brief The page listing the snapshot records, and the root of the
+     * reference counts, which only matter while a snapshot shares pages.
+     */
+    struct SnapshotDirectory {
+      static constexpr size_t capacity =
+          (PAGE_SIZE - sizeof(page_id_t) - sizeof(uint64_t)) / sizeof(page_id_t);
+
+      page_id_t refcount_root = 0;
+      uint64_t count = 0;
+      page_id_t records[capacity];
+    };
+    static_assert(sizeof(SnapshotDirectory) <= PAGE_SIZE);
+
+    /**
+     * @struct SnapshotRecord
+     * @brief The state a snapshot restores: the page table and the catalog.
+     */
+    struct SnapshotRecord {
+      static constexpr size_t max_name_length = 16;
+
+      char name[24]{};
+      page_id_t page_table_root = 0;
+      page_id_t logical_page_count = 0;
+      uint64_t entry_count = 0;
+      CatalogEntry entries[Superblock::capacity];
+    };
+    static_assert(sizeof(SnapshotRecord) <= PAGE_SIZE);
+
+    // the buffer key of each logical page looked up so far, no_page_ if not
+    vector<page_id_t> translation;
+    // the slot of each buffered extent, as page_slot for physical pages
+    map<page_id_t, slot_id_t> extent_slot;
+    // freed extents by sector count
+    GarbageCollector extent_garbage[SECTORS_PER_PAGE];
+    // the next free sector of the base page extents are packed into, 0 if none
+    uint64_t pack_cursor = 0;
+    std::unique_ptr<char[]> codec_scratch{new char[PAGE_SIZE]};
+    // freed logical page ids, recycled by allocate_page
+    GarbageCollector logical_garbage;
+    // whether a snapshot exists, so that pages may be shared
+    bool sharing = false;
+    // whether the page in a slot is known to be the current state's alone, so
+    // that it can be written without copying; only kept while sharing
+    bool exclusive[SLOT_COUNT]{};
+
+    // The child index at each level of the path to index in a table whose
+    // leaves hold leaf_capacity words
+    static std::array<size_t, TABLE_DEPTH> table_path(const uint64_t &index,
+                                                      const size_t &leaf_capacity) {
+      const uint64_t leaf = index / leaf_capacity;
+      if (leaf >= TABLE_FANOUT * TABLE_FANOUT)
+        throw std::length_error("PersistentMemory: PAGE TABLE IS FULL!");
+      return {leaf / TABLE_FANOUT, leaf % TABLE_FANOUT, index % leaf_capacity};
+    }
+
+    // Pin a physical page to write to it: it is marked dirty and its
+    // before-image is kept for the log
+    slot_id_t pin_page_for_write(const page_id_t &page_id, const page_size_t &span) {
+      const auto slot_id = pin_page(page_id, span);
+      is_dirty[slot_id] = true;
+      capture_before_image(slot_id);
+      return slot_id;
+    }
+
+    template <typename W> W read_word(const page_id_t &page_id, const size_t &index) {
+      const auto slot_id = pin_page(page_id, 1);
+      W word;
+      std::memcpy(&word, buffer[slot_id] + index * sizeof(W), sizeof(W));
+      --lock_count[slot_id];
+      return word;
+    }
+
+    template <typename W>
+    void write_word(const page_id_t &page_id, const size_t &index, const W &word) {
+      const auto slot_id = pin_page_for_write(page_id, 1);
+      std::memcpy(buffer[slot_id] + index * sizeof(W), &word, sizeof(W));
+      --lock_count[slot_id];
+    }
+
+    // Copy a whole table node out of the buffer
+    void read_node(const page_id_t &page_id, page_id_t (&words)[TABLE_FANOUT]) {
+      const auto slot_id = pin_page(page_id, 1);
+      std::memcpy(words, buffer[slot_id], PAGE_SIZE);
+      --lock_count[slot_id];
+    }
+
+    // A new physical page filled with zeros
+    page_id_t allocate_zeroed() {
+      const auto page_id = allocate_physical(1);
+      const auto slot_id = pin_page_for_write(page_id, 1);
+      std::memset(buffer[slot_id], 0, PAGE_SIZE);
+      --lock_count[slot_id];
+      return page_id;
+    }
+
+    // The word at index in the table under root, zero if its leaf is missing
+    template <typename W> W table_lookup(const page_id_t &root, const uint64_t &index) {
+      const auto path = table_path(index, PAGE_SIZE / sizeof(W));
+      page_id_t node = root;
+      for (int level = 0; level < TABLE_DEPTH - 1 && node != 0; level++)
+        node = read_word<page_id_t>(node, path[level]);
+      return node == 0 ? W{} : read_word<W>(node, path[TABLE_DEPTH - 1]);
+    }
+
+    refcount_t extra_references(const page_id_t &page_id) {
+      if (not sharing)
+        return 0;
+      const auto root = read_word<page_id_t>(superblock.snapshot_directory, 0);
+      return root == 0 ? 0 : table_lookup<refcount_t>(root, page_id);
+    }
+
+    // Change the references to a physical page; the reference counts are a
+    // radix tree like the page table, but never shared
+    void add_references(const page_id_t &page_id, const int delta) {
+      const auto &directory = superblock.snapshot_directory;
+      assert(directory != 0);
+      page_id_t node = read_word<page_id_t>(directory, 0);
+      if (node == 0) {
+        node = allocate_zeroed();
+        write_word<page_id_t>(directory, 0, node);
+      }
+      const auto path = table_path(page_id, PAGE_SIZE / sizeof(refcount_t));
+      for (int level = 0; level < TABLE_DEPTH - 1; level++) {
+        auto child = read_word<page_id_t>(node, path[level]);
+        if (child == 0) {
+          child = allocate_zeroed();
+          write_word<page_id_t>(node, path[level], child);
+        }
+        node = child;
+      }
+      const auto count = read_word<refcount_t>(node, path[TABLE_DEPTH - 1]);
+      assert(delta > 0 || count > 0);
+      write_word<refcount_t>(node, path[TABLE_DEPTH - 1], count + delta);
+    }
+
+    // Copy a table node shared with a snapshot; the children gain the copy as
+    // a parent, and the node loses the current state
+    page_id_t copy_table_node(const page_id_t &node, const bool &leaf) {
+      page_id_t words[TABLE_FANOUT];
+      read_node(node, words);
+      const auto copy = allocate_physical(1);
+      const auto slot_id = pin_page_for_write(copy, 1);
+      std::memcpy(buffer[slot_id], words, PAGE_SIZE);
+      --lock_count[slot_id];
+      for (const auto &word : words) {
+        if (word != 0)
+          add_references(leaf ? refcount_index(word) : word, 1);
+      }
+      add_references(node, -1);
+      return copy;
+    }
+
+    // The page table leaf holding the entry of page_id, with every node on
+    // the way made the current state's alone: missing nodes are created, and
+    // nodes shared with a snapshot are copied
+    page_id_t page_table_leaf(const page_id_t &page_id) {
+      const auto path = table_path(page_id, TABLE_FANOUT);
+      page_id_t parent = 0; // 0 for the root in the superblock
+      page_id_t node = superblock.page_table_root;
+      for (int level = 0;; level++) {
+        page_id_t own = node;
+        if (node == 0)
+          own = allocate_zeroed();
+        else if (extra_references(node) > 0)
+          own = copy_table_node(node, level == TABLE_DEPTH - 1);
+        if (own != node) {
+          if (parent == 0)
+            superblock.page_table_root = own;
+          else
+            write_word<page_id_t>(parent, path[level - 1], own);
+        }
+        if (level == TABLE_DEPTH - 1)
+          return own;
+        parent = own;
+        node = read_word<page_id_t>(own, path[level]);
+      }
+    }
+
+    // Point a logical page at a physical one, or free it with entry 0
+    void map_page(const page_id_t &page_id, const table_entry_t &entry) {
+      write_word<table_entry_t>(page_table_leaf(page_id), page_id % TABLE_FANOUT, entry);
+      while (translation.size() <= page_id)
+        translation.push_back(no_page_);
+      translation[page_id] = entry == 0 ? no_page_ : entry_key(entry);
+    }
+
+    // The physical page holding a logical page
+    page_id_t translate(const page_id_t &page_id) {
+      if (page_id < translation.size() && translation[page_id] != no_page_)
+        return translation[page_id];
+      const auto entry =
+          page_id < superblock.logical_page_count
+              ? table_lookup<table_entry_t>(superblock.page_table_root, page_id)
+              : 0;
+      if (entry == 0)
+        throw std::invalid_argument("Page ID out of range");
+      while (translation.size() <= page_id)
+        translation.push_back(no_page_);
+      return translation[page_id] = entry_key(entry);
+    }
+
+    // Reserve a new logical page, held by a new physical page
+    page_id_t allocate_page(const page_size_t &span) {
+      const auto physical = allocate_physical(span);
+      const page_id_t page_id = logical_garbage.available()
+                                    ? logical_garbage.recycle()
+                                    : superblock.logical_page_count++;
+      map_page(page_id, make_entry(physical, span_class_of(span)));
+      return page_id;
+    }
+
+    // Drop a reference to the physical page or extent of an entry, freeing it
+    // with the last one
+    void release_physical(const table_entry_t &entry) {
+      const auto index = refcount_index(entry);
+      if (extra_references(index) > 0)
+        add_references(index, -1);
+      else if (entry & ENTRY_COMPRESSED)
+        free_extent(entry_key(entry));
+      else
+        garbage_collector[entry_span_class(entry)].dump(entry_page(entry));
+    }
+
+    // Free a logical page and drop its physical page
+    void release_page(const page_id_t &page_id) {
+      const auto leaf = page_table_leaf(page_id);
+      const auto entry = read_word<table_entry_t>(leaf, page_id % TABLE_FANOUT);
+      assert(entry != 0 && "A page must not be freed twice");
+      write_word<table_entry_t>(leaf, page_id % TABLE_FANOUT, 0);
+      if (page_id < translation.size())
+        translation[page_id] = no_page_;
+      logical_garbage.dump(page_id);
+      release_physical(entry);
+    }
+
+    // Drop a reference to a table node, and to everything under it with the
+    // last one
+    void release_table(const page_id_t &node, const int &level) {
+      if (node == 0)
+        return;
+      if (extra_references(node) > 0) {
+        add_references(node, -1);
+        return;
+      }
+      page_id_t words[TABLE_FANOUT];
+      read_node(node, words);
+      for (const auto &word : words) {
+        if (word == 0)
+          continue;
+        if (level == TABLE_DEPTH - 1)
+          release_physical(word);
+        else
+          release_table(word, level + 1);
+      }
+      garbage_collector[0].dump(node);
+    }
+
+    // Give a buffered page a new physical page, keeping it in its slot so
+    // that references to it stay valid: the copy on write of a shared page
+    void move_page(const slot_id_t &slot_id, const page_id_t &to) {
+      assert(not is_dirty[slot_id] && "A shared page is always clean");
+      const auto other = find_page_id_in_buffer(to);
+      if (other != no_slot_) {
+        assert(lock_count[other] == 0);
+        evict_run(other, buffer_page_span[other]);
+      }
+      set_page_slot(buffer_page_id[slot_id], no_slot_);
+      page_slot[to] = slot_id;
+      buffer_page_id[slot_id] = to;
+      is_dirty[slot_id] = true;
+      page_lsn[slot_id] = 0;
+      if (logging) {
+        // the log holds the changes from what the disk has at the new page
+        fmemory.seekg(to * PAGE_SIZE, std::ios::beg);
+        fmemory.read(before_image[slot_id], PAGE_SIZE * buffer_page_span[slot_id]);
+        assert(fmemory.good());
+        if (not captured[slot_id]) {
+          captured[slot_id] = true;
+          captured_slots.push_back(slot_id);
+        }
+      }
+    }
+
+    // Pin a logical page; one to be written to is first made the current
+    // state's alone, copying it away from the snapshots sharing it, and out
+    // of its extent if compressed
+    slot_id_t pin_logical_page(const page_id_t &page_id, const page_size_t &span,
+                               const bool &write) {
+      const auto key = translate(page_id);
+      if (not write)
+        return pin_page(key, span);
+      const auto buffered = find_page_id_in_buffer(key);
+      slot_id_t slot_id;
+      if (not(key & EXTENT_KEY) &&
+          (not sharing || (buffered != no_slot_ && exclusive[buffered]))) {
+        slot_id = pin_page(key, span);
+      } else {
+        const auto leaf = page_table_leaf(page_id);
+        const auto entry = read_word<table_entry_t>(leaf, page_id % TABLE_FANOUT);
+        slot_id = pin_page(entry_key(entry), span);
+        if (entry & ENTRY_COMPRESSED || extra_references(refcount_index(entry)) > 0) {
+          const auto copy = allocate_physical(span);
+          move_page(slot_id, copy);
+          release_physical(entry);
+          map_page(page_id, make_entry(copy, span_class_of(span)) |
+                                (entry & ENTRY_COMPRESSIBLE));
+        }
+        if (sharing)
+          exclusive[slot_id] = true;
+      }
+      is_dirty[slot_id] = true;
+      capture_before_image(slot_id);
+      return slot_id;
+    }
+
+    // Decompress an extent into length bytes
+    void read_extent(const page_id_t &key, char *out, const size_t &length) {
+      const size_t bytes = key_sectors(key) * SECTOR_SIZE;
+      fmemory.seekg(key_sector(key) * SECTOR_SIZE, std::ios::beg);
+      fmemory.read(codec_scratch.get(), bytes);
+      assert(fmemory.good());
+      if (not PageCodec::decompress(codec_scratch.get() + sizeof(uint32_t),
+                                    read_compressed_size(), out, length))
+        throw std::runtime_error("PersistentMemory: CORRUPT COMPRESSED PAGE!");
+    }
+
+    // the size of the compressed bytes in codec_scratch, stored in front of them
+    uint32_t read_compressed_size() const {
+      uint32_t size;
+      std::memcpy(&size, codec_scratch.get(), sizeof(size));
+      return size;
+    }
+
+    // Reserve an extent of a number of sectors, recycling one if possible
+    uint64_t allocate_extent(const size_t &sectors) {
+      auto &collector = extent_garbage[sectors - 1];
+      if (collector.available())
+        return collector.recycle();
+      if (pack_cursor != 0 &&
+          SECTORS_PER_PAGE - pack_cursor % SECTORS_PER_PAGE < sectors)
+        close_pack();
+      if (pack_cursor == 0) {
+        const auto page_id = allocate_physical(1);
+        // what the buffer holds of a recycled page must not land on the extents later
+        const auto slot_id = find_page_id_in_buffer(page_id);
+        if (slot_id != no_slot_)
+          evict_run(slot_id, buffer_page_span[slot_id]);
+        pack_cursor = page_id * SECTORS_PER_PAGE;
+      }
+      const auto sector = pack_cursor;
+      pack_cursor += sectors;
+      if (pack_cursor % SECTORS_PER_PAGE == 0)
+        pack_cursor = 0;
+      return sector;
+    }
+
+    // Free the rest of the base page extents are packed into
+    void close_pack() {
+      if (pack_cursor == 0)
+        return;
+      extent_garbage[SECTORS_PER_PAGE - pack_cursor % SECTORS_PER_PAGE - 1].dump(pack_cursor);
+      pack_cursor = 0;
+    }
+
+    void free_extent(const page_id_t &key) {
+      // the page read from it must not be found under the key once it is reused
+      const auto slot_id = find_page_id_in_buffer(key);
+      if (slot_id != no_slot_) {
+        assert(lock_count[slot_id] == 0 && not is_dirty[slot_id]);
+        evict_run(slot_id, buffer_page_span[slot_id]);
+      }
+      extent_garbage[key_sectors(key) - 1].dump(key_sector(key));
+    }
+
+    // Compress the compressible pages not pinned, each into the smallest
+    // extent it fits, if that saves a sector. Pages shared with a snapshot
+    // stay as they are, so nothing is compressed while there are snapshots.
+    void compress_cold_pages() {
+      if (not sharing && superblock.page_table_root != 0)
+        compress_table(superblock.page_table_root, 0, 0);
+      close_pack();
+    }
+
+    void compress_table(const page_id_t &node, const int &level, const page_id_t &first) {
+      page_id_t stride = 1;
+      for (int i = level; i < TABLE_DEPTH - 1; i++)
+        stride *= TABLE_FANOUT;
+      page_id_t words[TABLE_FANOUT];
+      read_node(node, words);
+      for (size_t i = 0; i < TABLE_FANOUT; i++) {
+        if (words[i] == 0)
+          continue;
+        if (level < TABLE_DEPTH - 1)
+          compress_table(words[i], level + 1, first + i * stride);
+        else if (words[i] & ENTRY_COMPRESSIBLE && not(words[i] & ENTRY_COMPRESSED))
+          compress_page(first + i, words[i]);
+      }
+    }
+
+    void compress_page(const page_id_t &page_id, const table_entry_t &entry) {
+      const auto physical = entry_page(entry);
+      const size_t length = PAGE_SIZE << entry_span_class(entry);
+      const auto slot_id = find_page_id_in_buffer(physical);
+      if (slot_id != no_slot_ && lock_count[slot_id] != 0)
+        return;
+      const std::unique_ptr<char[]> bytes(new char[length]);
+      if (slot_id != no_slot_) {
+        std::memcpy(bytes.get(), buffer[slot_id], length);
+      } else {
+        fmemory.seekg(physical * PAGE_SIZE, std::ios::beg);
+        fmemory.read(bytes.get(), length);
+        assert(fmemory.good());
+      }
+      // the compressed size, then the compressed bytes, in whole sectors
+      const auto size = static_cast<uint32_t>(
+          PageCodec::compress(bytes.get(), length, codec_scratch.get() + sizeof(uint32_t),
+                              PAGE_SIZE - sizeof(uint32_t)));
+      const size_t sectors = (sizeof(size) + size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+      if (size == 0 || sectors >= length / SECTOR_SIZE)
+        return;
+      std::memcpy(codec_scratch.get(), &size, sizeof(size));
+      std::memset(codec_scratch.get() + sizeof(size) + size, 0,
+                  sectors * SECTOR_SIZE - sizeof(size) - size);
+      const auto sector = allocate_extent(sectors);
+      fmemory.seekp(sector * SECTOR_SIZE, std::ios::beg);
+      fmemory.write(codec_scratch.get(), sectors * SECTOR_SIZE);
+      assert(fmemory.good());
+      if (slot_id != no_slot_)
+        evict_run(slot_id, buffer_page_span[slot_id]);
+      garbage_collector[entry_span_class(entry)].dump(physical);
+      map_page(page_id, make_extent_entry(extent_key(sector, sectors),
+                                          entry_span_class(entry)));
+    }
+
+    // Rebuild the logical free list: every id below the count not mapped
+    void rebuild_logical_garbage() {
+      logical_garbage = GarbageCollector();
+      collect_unmapped(superblock.page_table_root, 0, 0);
+    }
+
+    void collect_unmapped(const page_id_t &node, const int &level,
+                          const page_id_t &first) {
+      page_id_t stride = 1;
+      for (int i = level; i < TABLE_DEPTH - 1; i++)
+        stride *= TABLE_FANOUT;
+      page_id_t words[TABLE_FANOUT]{};
+      if (node != 0)
+        read_node(node, words);
+      for (size_t i = 0; i < TABLE_FANOUT; i++) {
+        const page_id_t begin = first + i * stride;
+        if (begin >= superblock.logical_page_count)
+          return;
+        if (level < TABLE_DEPTH - 1)
+          collect_unmapped(words[i], level + 1, begin);
+        else if (words[i] == 0 && begin >= SUPERBLOCK_SLOT_COUNT)
+          logical_garbage.dump(begin);
+      }
+    }
+
+    // Rebuild the physical and extent free lists: every base page that no
+    // page table, snapshot or reference count uses, split into the largest
+    // spans it holds, and every run of sectors no extent covers in a base
+    // page extents are packed into
+    void rebuild_physical_garbage() {
+      vector<bool> used;
+      // the sectors in use of each base page, a bit per sector
+      vector<uint64_t> used_sectors;
+      for (page_id_t page_id = 0; page_id < current_pages_in_disk; page_id++) {
+        used.push_back(page_id < SUPERBLOCK_SLOT_COUNT);
+        used_sectors.push_back(0);
+      }
+      mark_table(superblock.page_table_root, 0, used, used_sectors);
+      if (const auto directory = superblock.snapshot_directory; directory != 0) {
+        used[directory] = true;
+        mark_refcounts(read_word<page_id_t>(directory, 0), 0, used);
+        const auto count = read_word<uint64_t>(directory, 1);
+        for (uint64_t i = 0; i < count; i++) {
+          const auto record_page = read_word<page_id_t>(directory, 2 + i);
+          used[record_page] = true;
+          mark_table(read_word<page_id_t>(record_page,
+                                          offsetof(SnapshotRecord, page_table_root) /
+                                              sizeof(page_id_t)),
+                     0, used, used_sectors);
+        }
+      }
+
+      for (auto &collector : garbage_collector)
+        collector = GarbageCollector();
+      for (auto &collector : extent_garbage)
+        collector = GarbageCollector();
+      page_id_t run_begin = SUPERBLOCK_SLOT_COUNT;
+      const auto free_run = [this](page_id_t begin, const page_id_t &end) {
+        for (size_t span_class = SPAN_CLASS_COUNT; span_class-- > 0;) {
+          const page_id_t span = static_cast<page_id_t>(1) << span_class;
+          for (; end - begin >= span; begin += span)
+            garbage_collector[span_class].dump(begin);
+        }
+      };
+      for (page_id_t page_id = SUPERBLOCK_SLOT_COUNT; page_id < current_pages_in_disk;
+           page_id++) {
+        if (not used[page_id] && used_sectors[page_id] == 0)
+          continue;
+        free_run(run_begin, page_id);
+        run_begin = page_id + 1;
+        for (size_t sector = 0; sector < SECTORS_PER_PAGE && used_sectors[page_id] != 0;) {
+          if (used_sectors[page_id] >> sector & 1) {
+            ++sector;
+            continue;
+          }
+          size_t end = sector;
+          while (end < SECTORS_PER_PAGE && not(used_sectors[page_id] >> end & 1))
+            ++end;
+          extent_garbage[end - sector - 1].dump(page_id * SECTORS_PER_PAGE + sector);
+          sector = end;
+        }
+      }
+      free_run(run_begin, current_pages_in_disk);
+    }
+
+    // Mark the nodes of a page table and the pages and sectors its entries
+    // hold; a node met before is shared, and so is everything under it
+    void mark_table(const page_id_t &node, const int &level, vector<bool> &used,
+                    vector<uint64_t> &used_sectors) {
+      if (node == 0 || used[node])
+        return;
+      used[node] = true;
+      page_id_t words[TABLE_FANOUT];
+      read_node(node, words);
+      for (const auto &word : words) {
+        if (word == 0)
+          continue;
+        if (level < TABLE_DEPTH - 1) {
+          mark_table(word, level + 1, used, used_sectors);
+        } else if (word & ENTRY_COMPRESSED) {
+          const auto key = entry_key(word);
+          for (auto sector = key_sector(key); sector < key_sector(key) + key_sectors(key); sector++)
+            used_sectors[sector / SECTORS_PER_PAGE] |= uint64_t{1} << sector % SECTORS_PER_PAGE;
+        } else {
+          for (page_id_t k = 0; k < (static_cast<page_id_t>(1) << entry_span_class(word)); k++)
+            used[entry_page(word) + k] = true;
+        }
+      }
+    }
+
+    // Mark the nodes of the reference counts; their leaves hold counts
+    void mark_refcounts(const page_id_t &node, const int &level, vector<bool> &used) {
+      if (node == 0)
+        return;
+      used[node] = true;
+      if (level == TABLE_DEPTH - 1)
+        return;
+      page_id_t words[TABLE_FANOUT];
+      read_node(node, words);
+      for (const auto &word : words)
+        mark_refcounts(word, level + 1, used);
+    }
+
+    // Map a file written before the page table one to one: every base page
+    // is the logical page of the same id, but for those in the free lists
+    void convert_to_page_table() {
+      superblock.logical_page_count = current_pages_in_disk;
+      vector<bool> free;
+      for (page_id_t page_id = 0; page_id < current_pages_in_disk; page_id++)
+        free.push_back(false);
+      for (size_t span_class = 0; span_class < SPAN_CLASS_COUNT; span_class++) {
+        for (const auto &page_id : garbage_collector[span_class].pages()) {
+          for (page_id_t k = 0; k < (static_cast<page_id_t>(1) << span_class); k++)
+            free[page_id + k] = true;
+        }
+      }
+      logical_garbage = GarbageCollector();
+      for (page_id_t page_id = SUPERBLOCK_SLOT_COUNT; page_id < current_pages_in_disk;
+           page_id++) {
+        if (free[page_id])
+          logical_garbage.dump(page_id);
+        else
+          map_page(page_id, make_entry(page_id, 0));
+      }
+    }
+
+    void refresh_sharing() {
+      sharing = superblock.snapshot_directory != 0 &&
+                read_word<uint64_t>(superblock.snapshot_directory, 1) != 0;
+      std::fill(exclusive, exclusive + SLOT_COUNT, false);
+    }
+
+    static void check_snapshot_name(const std::string &name) {
+      if (name.empty() || name.size() > SnapshotRecord::max_name_length)
+        throw std::invalid_argument("PersistentMemory: BAD SNAPSHOT NAME!");
+      for (const char &c : name) {
+        if (not std::isalnum(static_cast<unsigned char>(c)))
+          throw std::invalid_argument("PersistentMemory: BAD SNAPSHOT NAME!");
+      }
+    }
+
+    // The index in the directory and the record page of a snapshot, the
+    // record page 0 if there is none of the name
+    std::pair<size_t, page_id_t> find_snapshot(const std::string &name) {
+      const auto &directory = superblock.snapshot_directory;
+      if (directory == 0)
+        return {0, 0};
+      const auto count = read_word<uint64_t>(directory, 1);
+      for (size_t i = 0; i < count; i++) {
+        const auto record = read_word<page_id_t>(directory, 2 + i);
+        const auto slot_id = pin_page(record, 1);
+        const bool found =
+            name == reinterpret_cast<const SnapshotRecord *>(buffer[slot_id])->name;
+        --lock_count[slot_id];
+        if (found)
+          return {i, record};
+      }
+      return {0, 0};
+    }
+
+  public:
+    /**
+     * @brief Turn on write-ahead logging of every change to the pages and the
+     * catalog.
+     * @details Changes are grouped by command, see end_command. A crash then
+     * loses at most the commands of the last unsynced group, and recovery on
+     * the next start replays the log since the last checkpoint.
+     */
+    static void enable_logging() {
+      auto &pmem = get_instance();
+      pmem.logging = true;
+      // start the log from a durable state
+      pmem.checkpoint();
+    }
+
+    /**
+     * @brief Close a command: log its changes, commit them in the current
+     * group, and carry on with the checkpoint in progress, if any.
+     */
+    static void end_command() {
+      auto &pmem = get_instance();
+      if (not pmem.logging)
+        return;
+      pmem.commit_command();
+      pmem.advance_checkpoint();
+    }
+
+    /**
+     * @brief Make every committed command durable now.
+     */
+    static void sync_log() { get_instance().wal->sync(); }
+
+  public:
+    /**
+     * @brief Find the catalog entry of a structure, creating an empty one on
+     * first use.
+     * @details The entry lives as long as PersistentMemory, and is written to
+     * the superblock with the pages.
+     * @param name The name of the structure, unique within the file.
+     */
+    static CatalogEntry &catalog_entry(const std::string &name) {
+      auto &superblock = get_instance().superblock;
+      if (name.empty() || name.size() > CatalogEntry::max_name_length)
+        throw std::length_error("PersistentMemory: BAD CATALOG NAME!");
+      for (uint64_t i = 0; i < superblock.entry_count; i++) {
+        if (name == superblock.entries[i].name)
+          return superblock.entries[i];
+      }
+      if (superblock.entry_count == Superblock::capacity)
+        throw std::length_error("PersistentMemory: CATALOG IS FULL!");
+      auto &entry = superblock.entries[superblock.entry_count++];
+      std::strcpy(entry.name, name.c_str());
+      return entry;
+    }
+
+    /**
+     * @brief A catalog name for a structure constructed without one.
+     * @details Anonymous names follow the order of construction, so such
+     * structures must be constructed in the same order on every run.
+     */
+    static std::string anonymous_name() {
+      return "#" + std::to_string(get_instance().anonymous_count++);
+    }
+
+    /**
+     * @brief Write every dirty page and the catalog to the disk.
+     */
+    static void commit() { get_instance().write_back(); }
+
     /**
      * @brief Obtain a handle from the memory.
      * @tparam T The type of variable to store.
      * @return A handle to the variable stored in PersistentMemory.
      */
     template <typename T> [[nodiscard]] static Handle<T> create() {
-      auto &pmem = get_instance();
-
-      if (pmem.garbage_collector.available()) {
-        // recycle from the garbage collector
-        return Handle<T>(pmem.garbage_collector.recycle());
-      } else {
-        // create a new page and return the handle
-        const auto page_id = pmem.current_pages_in_disk++;
-        std::filesystem::resize_file(settings::PMEM_FILE_NAME, (page_id + 1) * PAGE_SIZE);
-        return Handle<T>(page_id);
-      }
+      return Handle<T>(get_instance().allocate_page(page_span_v<T>));
     }
 
     /**
@@ -453,20 +1763,12 @@ namespace norb {
 
     /**
      * @brief Obtain a mutable handle from the memory.
+     * @param span The number of base pages the page spans, a power of two.
      * @return A mutable handle to the variable stored in PersistentMemory.
      */
-    [[nodiscard]] static MutableHandle create_mutable() {
-      auto &pmem = get_instance();
-
-      if (pmem.garbage_collector.available()) {
-        // recycle from the garbage collector
-        return MutableHandle(pmem.garbage_collector.recycle());
-      } else {
-        // create a new page and return the handle
-        const auto page_id = pmem.current_pages_in_disk++;
-        std::filesystem::resize_file(settings::PMEM_FILE_NAME, (page_id + 1) * PAGE_SIZE);
-        return MutableHandle(page_id);
-      }
+    [[nodiscard]] static MutableHandle create_mutable(const page_size_t &span = 1) {
+      assert(is_valid_page_size(span * PAGE_SIZE));
+      return MutableHandle(get_instance().allocate_page(span));
     }
 
     /**
@@ -477,12 +1779,68 @@ namespace norb {
      */
     template <typename T, typename... Args>
     [[nodiscard]] static MutableHandle create_mutable_and_init(Args &&...args) {
-      const auto handle = create_mutable();
+      const MutableHandle handle = create_mutable(page_span_v<T>);
       // initialize with list, calling placement new
       new (handle.ref<T>().as_raw_ptr()) T{std::forward<Args>(args)...};
       return handle;
     }
 
+    /**
+     * @brief Load a batch of pages into the buffer ahead of their use.
+     * @details Pages already buffered are skipped; the rest are read in
+     * ascending page id order, so that the batch sweeps the file once instead
+     * of seeking back and forth. At most a quarter of the buffer is filled
+     * by one call, the rest of the batch is left to be loaded on demand.
+     * @param page_ids The pages to load, in any order.
+     * @param span The number of base pages each of the pages spans.
+     */
+    static void prefetch(vector<page_id_t> page_ids, const page_size_t &span = 1) {
+      auto &pmem = get_instance();
+      const size_t count = std::min<size_t>(page_ids.size(), SLOT_COUNT / 4 / span);
+      if (count == 0)
+        return;
+      // sorted by where they lie in the file
+      for (size_t i = 0; i < page_ids.size(); i++)
+        page_ids[i] = pmem.translate(page_ids[i]);
+      std::sort(&page_ids[0], &page_ids[0] + page_ids.size());
+      for (size_t i = 0; i < count; i++) {
+        if (pmem.find_page_id_in_buffer(page_ids[i]) != static_cast<slot_id_t>(-1))
+          continue;
+        const auto slot_id = pmem.get_lru_k(span);
+        pmem.evict_run(slot_id, span);
+        pmem.load_page_from_disk(page_ids[i], slot_id, span);
+      }
+    }
+
+    /**
+     * @brief Reserve a run of consecutive pages at the end of the file.
+     * @details Unlike create_mutable, this never recycles pages from the
+     * garbage collector, so the run is physically contiguous on disk until
+     * its pages are copied on write. The pages are left uninitialized.
+     * @param count The number of pages to reserve.
+     * @param span The number of base pages each of the pages spans.
+     * @return The page id of the first page in the run; the k-th page is at
+     * that id plus k * span.
+     */
+    [[nodiscard]] static page_id_t allocate_contiguous(const page_id_t &count,
+                                                       const page_size_t &span = 1) {
+      auto &pmem = get_instance();
+      const auto first_physical = pmem.current_pages_in_disk;
+      pmem.current_pages_in_disk += count * span;
+      std::filesystem::resize_file(pmem.memory_path, pmem.current_pages_in_disk * PAGE_SIZE);
+      pmem.track_pages_in_disk();
+      const auto first_page_id = pmem.superblock.logical_page_count;
+      pmem.superblock.logical_page_count += count * span;
+      for (page_id_t k = 0; k < count * span; k++) {
+        if (k % span == 0)
+          pmem.map_page(first_page_id + k,
+                        make_entry(first_physical + k, span_class_of(span)));
+        else
+          pmem.logical_garbage.dump(first_page_id + k); // ids between the pages
+      }
+      return first_page_id;
+    }
+
     /**
      * @brief Fetch the handle to a page.
      * @tparam T The type of variable the page stores.
@@ -514,10 +1872,10 @@ namespace norb {
     template <typename T> static void remove(const Handle<T> &handle) {
       if (handle.is_nullptr())
         return;
-      auto &persistent_memory = get_instance();
       // call the destructor of T
-      handle.ref().as_raw_ptr()->~T();
-      persistent_memory.garbage_collector.dump(handle.page_id);
+      if constexpr (not std::is_trivially_destructible_v<T>)
+        handle.ref().as_raw_ptr()->~T();
+      get_instance().release_page(handle.page_id);
     }
 
     /**
@@ -529,10 +1887,10 @@ namespace norb {
     template <typename T> static void remove(const MutableHandle &handle) {
       if (handle.is_nullptr())
         return;
-      auto &persistent_memory = get_instance();
       // call the destructor of T
-      handle.ref<T>().as_raw_ptr()->~T();
-      persistent_memory.garbage_collector.dump(handle.page_id);
+      if constexpr (not std::is_trivially_destructible_v<T>)
+        handle.ref<T>().as_raw_ptr()->~T();
+      get_instance().release_page(handle.page_id);
     }
 
     /**
@@ -541,5 +1899,142 @@ namespace norb {
     static page_id_t get_page_count() {
       return get_instance().current_pages_in_disk;
     }
+
+    /**
+     * @brief Let a page be kept compressed while it is not in use.
+     * @details Suits pages read far more often than written, as every write
+     * to a compressed page copies it out to a page of its own until the next
+     * write back compresses it again.
+     */
+    static void set_compressible(const MutableHandle &handle) {
+      auto &pmem = get_instance();
+      const auto leaf = pmem.page_table_leaf(handle.page_id);
+      const auto index = handle.page_id % TABLE_FANOUT;
+      const auto entry = pmem.read_word<table_entry_t>(leaf, index);
+      assert(entry != 0);
+      pmem.write_word<table_entry_t>(leaf, index, entry | ENTRY_COMPRESSIBLE);
+    }
+
+    /**
+     * @brief Keep the current state of every structure under a name.
+     * @details Nothing is copied: the snapshot shares the page table of the
+     * current state, and a page is only copied when either side writes to it
+     * (copy on write), so taking a snapshot costs one page and a flush.
+     * @param name 1 to 16 letters and digits, unique among the snapshots.
+     * @throws std::invalid_argument if the name is bad or taken.
+     * @throws std::length_error if there are too many snapshots.
+     */
+    static void snapshot_create(const std::string &name) {
+      auto &pmem = get_instance();
+      check_snapshot_name(name);
+      if (pmem.find_snapshot(name).second != 0)
+        throw std::invalid_argument("PersistentMemory: SNAPSHOT EXISTS!");
+      if (pmem.superblock.snapshot_directory == 0)
+        pmem.superblock.snapshot_directory = pmem.allocate_zeroed();
+      const auto directory = pmem.superblock.snapshot_directory;
+      const auto count = pmem.read_word<uint64_t>(directory, 1);
+      if (count == SnapshotDirectory::capacity)
+        throw std::length_error("PersistentMemory: TOO MANY SNAPSHOTS!");
+      // from here on the pages are shared, and a shared page must be clean
+      for (slot_id_t slot = 0; slot < SLOT_COUNT; slot++) {
+        if (pmem.slot_owner[slot] == slot)
+          pmem.evict_page(slot);
+      }
+      pmem.sharing = true;
+      if (pmem.superblock.page_table_root != 0)
+        pmem.add_references(pmem.superblock.page_table_root, 1);
+      const auto record_page = pmem.allocate_physical(1);
+      const auto slot_id = pmem.pin_page_for_write(record_page, 1);
+      auto &record = *new (pmem.buffer[slot_id]) SnapshotRecord;
+      std::strcpy(record.name, name.c_str());
+      record.page_table_root = pmem.superblock.page_table_root;
+      record.logical_page_count = pmem.superblock.logical_page_count;
+      record.entry_count = pmem.superblock.entry_count;
+      std::copy(pmem.superblock.entries,
+                pmem.superblock.entries + pmem.superblock.entry_count, record.entries);
+      --pmem.lock_count[slot_id];
+      pmem.write_word<page_id_t>(directory, 2 + count, record_page);
+      pmem.write_word<uint64_t>(directory, 1, count + 1);
+      pmem.refresh_sharing();
+    }
+
+    /**
+     * @brief Bring every structure back to its state in a snapshot.
+     * @details The current state is dropped, and the snapshot is kept, so it
+     * can be restored again. Structures created after the snapshot are
+     * emptied, and their catalog entries stay. Structures must reload what
+     * they keep in memory from the pages afterwards.
+     * @throws std::invalid_argument if there is no snapshot of the name.
+     * @throws std::length_error if the catalog cannot hold both states' names.
+     */
+    static void snapshot_restore(const std::string &name) {
+      auto &pmem = get_instance();
+      auto &superblock = pmem.superblock;
+      const auto record_page = pmem.find_snapshot(name).second;
+      if (record_page == 0)
+        throw std::invalid_argument("PersistentMemory: NO SUCH SNAPSHOT!");
+      const std::unique_ptr<SnapshotRecord> record(new SnapshotRecord);
+      {
+        const auto slot_id = pmem.pin_page(record_page, 1);
+        std::memcpy(record.get(), pmem.buffer[slot_id], sizeof(SnapshotRecord));
+        --pmem.lock_count[slot_id];
+      }
+      const auto find = [&](const char *entry_name) -> CatalogEntry * {
+        for (uint64_t i = 0; i < superblock.entry_count; i++) {
+          if (std::strcmp(superblock.entries[i].name, entry_name) == 0)
+            return &superblock.entries[i];
+        }
+        return nullptr;
+      };
+      uint64_t added = 0;
+      for (uint64_t i = 0; i < record->entry_count; i++)
+        added += find(record->entries[i].name) == nullptr;
+      if (superblock.entry_count + added > Superblock::capacity)
+        throw std::length_error("PersistentMemory: CATALOG IS FULL!");
+      // swap in the snapshot's table before dropping the current one, as
+      // they may share nodes
+      if (record->page_table_root != 0)
+        pmem.add_references(record->page_table_root, 1);
+      const auto old_root = superblock.page_table_root;
+      superblock.page_table_root = record->page_table_root;
+      superblock.logical_page_count = record->logical_page_count;
+      pmem.release_table(old_root, 0);
+      for (uint64_t i = 0; i < superblock.entry_count; i++) {
+        auto &entry = superblock.entries[i];
+        entry.root = MutableHandle();
+        entry.height = entry.size = 0;
+      }
+      for (uint64_t i = 0; i < record->entry_count; i++) {
+        auto *entry = find(record->entries[i].name);
+        if (entry == nullptr)
+          entry = &superblock.entries[superblock.entry_count++];
+        *entry = record->entries[i];
+      }
+      pmem.translation.clear();
+      pmem.rebuild_logical_garbage();
+      pmem.refresh_sharing();
+    }
+
+    /**
+     * @brief Drop a snapshot, freeing the pages only it still holds.
+     * @throws std::invalid_argument if there is no snapshot of the name.
+     */
+    static void snapshot_delete(const std::string &name) {
+      auto &pmem = get_instance();
+      const auto [index, record_page] = pmem.find_snapshot(name);
+      if (record_page == 0)
+        throw std::invalid_argument("PersistentMemory: NO SUCH SNAPSHOT!");
+      pmem.release_table(pmem.read_word<page_id_t>(
+                             record_page, offsetof(SnapshotRecord, page_table_root) /
+                                              sizeof(page_id_t)),
+                         0);
+      pmem.garbage_collector[0].dump(record_page);
+      const auto directory = pmem.superblock.snapshot_directory;
+      const auto count = pmem.read_word<uint64_t>(directory, 1);
+      pmem.write_word<page_id_t>(directory, 2 + index,
+                                 pmem.read_word<page_id_t>(directory, 2 + count - 1));
+      pmem.write_word<uint64_t>(directory, 1, count - 1);
+      pmem.refresh_sharing();
+    }
   };
 } // namespace norb
\ No newline at end of file
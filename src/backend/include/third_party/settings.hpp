@@ -4,5 +4,4 @@
 
 namespace norb::settings {
     const std::string PMEM_FILE_NAME = "persistent_memory.db";
-    const std::string NPMEM_FILE_NAME = "naive_persistent_memory.db";
 }
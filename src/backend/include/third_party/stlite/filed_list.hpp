@@ -1,11 +1,81 @@
 #pragma once
 
 #include "utils.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <exception>
+#include <stdexcept>
 #include <string>
 
 // Namespace norb for Norb.
 namespace norb {
+    namespace impl {
+        /*
+         * The header of a filed list. Version 1 files start with a bare int element count, so their offsets overflow
+         * past 2 GiB; version 2 files start with this header and count and address elements in 64 bits.
+         */
+        struct FiledListHeader {
+            static constexpr uint32_t magic_v = 0x314c464e; // "NFL1"
+            static constexpr uint32_t current_version = 2;
+
+            uint32_t magic = magic_v;
+            uint32_t version = current_version;
+            int64_t size = 0;
+        };
+        constexpr std::streamoff filed_list_data_offset = sizeof(FiledListHeader);
+        constexpr std::streamoff legacy_data_offset = sizeof(int);
+
+        // Opens the header of a filed list: writes a fresh one to an empty file, and rewrites a version 1 file in
+        // place, moving its elements behind the new header. Returns the element count.
+        // A version 1 file is told apart by its first word, which would have to be a count of exactly magic_v.
+        inline int64_t open_filed_list_header(std::fstream &f_stream, const std::string &f_name) {
+            f_stream.seekg(0);
+            if (filesystem::is_empty(f_stream)) {
+                f_stream.seekp(0);
+                filesystem::binary_write(f_stream, FiledListHeader{});
+                return 0;
+            }
+            const auto file_size = static_cast<std::streamoff>(filesystem::get_size(f_name));
+            FiledListHeader header;
+            if (file_size >= filed_list_data_offset) {
+                filesystem::binary_read(f_stream, header);
+                if (header.magic == FiledListHeader::magic_v) {
+                    if (header.version != FiledListHeader::current_version) {
+                        throw std::runtime_error("norb::FiledList: UNSUPPORTED FILE VERSION!");
+                    }
+                    return header.size;
+                }
+            }
+            // version 1: shift everything after the int count back by the growth of the header, last chunk first
+            f_stream.clear();
+            f_stream.seekg(0);
+            int legacy_size = 0;
+            filesystem::binary_read(f_stream, legacy_size);
+            constexpr std::streamoff shift = filed_list_data_offset - legacy_data_offset;
+            char buffer[4096];
+            for (std::streamoff end = file_size; end > legacy_data_offset;) {
+                const std::streamoff begin = std::max(legacy_data_offset, end - static_cast<std::streamoff>(sizeof(buffer)));
+                f_stream.seekg(begin);
+                f_stream.read(buffer, end - begin);
+                f_stream.seekp(begin + shift);
+                f_stream.write(buffer, end - begin);
+                end = begin;
+            }
+            header = FiledListHeader{};
+            header.size = legacy_size;
+            f_stream.seekp(0);
+            filesystem::binary_write(f_stream, header);
+            f_stream.flush();
+            return header.size;
+        }
+
+        inline void write_filed_list_size(std::fstream &f_stream, const int64_t size) {
+            f_stream.seekp(offsetof(FiledListHeader, size));
+            filesystem::binary_write(f_stream, size);
+        }
+    } // namespace impl
+
     template <typename T_> class FiledNaiveList {
       public:
         explicit FiledNaiveList(const std::string &f_name_) {
@@ -13,15 +83,7 @@ namespace norb {
             filesystem::fassert(f_name);
             f_stream.open(f_name, file_open_mode);
             assert(f_stream.good());
-            f_stream.seekg(0);
-            if (!filesystem::is_empty(f_stream)) {
-                // Read the size from the disk.
-                filesystem::binary_read(f_stream, size_);
-            } else {
-                // Write a zero to the disk.
-                f_stream.seekp(0);
-                filesystem::binary_write(f_stream, size_);
-            }
+            size_ = impl::open_filed_list_header(f_stream, f_name);
             assert(f_stream.good());
         }
         explicit FiledNaiveList(const char *f_name_) : FiledNaiveList(std::string(f_name_)) {
@@ -31,7 +93,7 @@ namespace norb {
             f_stream.close();
         }
 
-        T_ get(const int index) const {
+        T_ get(const int64_t index) const {
             assert(f_stream.good());
             if (index >= size_ || index < 0) {
                 throw std::range_error("norb::FiledNaiveList: INDEX OUT OF RANGE!");
@@ -43,15 +105,14 @@ namespace norb {
             return ret;
         }
 
-        T_ set(const int index, T_ to) {
+        T_ set(const int64_t index, T_ to) {
             assert(f_stream.good());
             if (index < 0) {
                 throw std::range_error("norb::FiledNaiveList: INDEX OUT OF RANGE!");
             }
             if (index + 1 > size_) {
                 size_ = std::max(size_, index + 1);
-                f_stream.seekp(0);
-                filesystem::binary_write(f_stream, size_);
+                impl::write_filed_list_size(f_stream, size_);
             }
             f_stream.seekp(getPos(index), std::ios::beg);
             filesystem::binary_write(f_stream, to);
@@ -59,7 +120,7 @@ namespace norb {
             return to;
         }
 
-        int size() const {
+        int64_t size() const {
             return size_;
         }
 
@@ -72,8 +133,7 @@ namespace norb {
 
         void clear() {
             size_ = 0;
-            f_stream.seekp(0, std::ios::beg);
-            filesystem::binary_write(f_stream, size_);
+            impl::write_filed_list_size(f_stream, size_);
             f_stream.flush(); // Ensure data is written
             assert(f_stream.good());
         }
@@ -82,12 +142,12 @@ namespace norb {
         static constexpr auto file_open_mode = std::ios::binary | std::ios::in | std::ios::out;
         static constexpr int sizeof_t = sizeof(T_);
 
-        int size_ = 0;
+        int64_t size_ = 0;
         std::string f_name;
         mutable std::fstream f_stream;
 
-        int getPos(const int index) const {
-            return sizeof(int) + sizeof_t * index;
+        std::streamoff getPos(const int64_t index) const {
+            return impl::filed_list_data_offset + static_cast<std::streamoff>(sizeof_t) * index;
         }
     };
 
@@ -98,15 +158,7 @@ namespace norb {
             filesystem::fassert(f_name);
             f_stream.open(f_name, file_open_mode);
             assert(f_stream.good());
-            f_stream.seekg(0);
-            if (!filesystem::is_empty(f_stream)) {
-                // Read the size from the disk.
-                filesystem::binary_read(f_stream, size_);
-            } else {
-                // Write a zero to the disk.
-                f_stream.seekp(0);
-                filesystem::binary_write(f_stream, size_);
-            }
+            size_ = impl::open_filed_list_header(f_stream, f_name);
             assert(f_stream.good());
         }
         explicit FiledSegmentList(const char *f_name_) : FiledSegmentList(std::string(f_name_)) {
@@ -117,7 +169,7 @@ namespace norb {
         }
 
         struct SegmentPointer {
-            int cur;
+            int64_t cur;
             int size;
         };
 
@@ -140,14 +192,35 @@ namespace norb {
             return to;
         }
 
+        // Reads the elements [from, to) of the segment into out with a single seek and read.
+        void read_segment(const SegmentPointer &seg, const int from, const int to, T_ *out) const {
+            if (from < 0 || to > seg.size || from > to) {
+                throw std::range_error("norb::FiledSegmentList: INDEX OUT OF RANGE!");
+            }
+            if (from == to)
+                return;
+            f_stream.seekg(getPos(seg.cur + from));
+            f_stream.read(reinterpret_cast<char *>(out), static_cast<std::streamsize>(sizeof_t) * (to - from));
+        }
+
+        // Writes in[0, to - from) over the elements [from, to) of the segment with a single seek and write.
+        void write_segment(const SegmentPointer &seg, const int from, const int to, const T_ *in) {
+            if (from < 0 || to > seg.size || from > to) {
+                throw std::range_error("norb::FiledSegmentList: INDEX OUT OF RANGE!");
+            }
+            if (from == to)
+                return;
+            f_stream.seekp(getPos(seg.cur + from));
+            f_stream.write(reinterpret_cast<const char *>(in), static_cast<std::streamsize>(sizeof_t) * (to - from));
+        }
+
         SegmentPointer allocate(const int size) {
             assert(f_stream.good());
             const SegmentPointer seg = {size_, size};
             size_ += size;
             f_stream.seekp(getPos(size_));
             f_stream.put('\0'); // Ensure the segment is allocated
-            f_stream.seekp(0);
-            filesystem::binary_write(f_stream, size_);
+            impl::write_filed_list_size(f_stream, size_);
             return seg;
         }
 
@@ -155,12 +228,12 @@ namespace norb {
         static constexpr auto file_open_mode = std::ios::binary | std::ios::in | std::ios::out;
         static constexpr int sizeof_t = sizeof(T_);
 
-        int size_ = 0;
+        int64_t size_ = 0;
         std::string f_name;
         mutable std::fstream f_stream;
 
-        int getPos(const int index) const {
-            return sizeof(int) + sizeof_t * index;
+        std::streamoff getPos(const int64_t index) const {
+            return impl::filed_list_data_offset + static_cast<std::streamoff>(sizeof_t) * index;
         }
     };
 } // namespace norb
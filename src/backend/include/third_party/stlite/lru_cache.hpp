@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+#include "map.hpp"
+
+namespace norb {
+    /**
+     * @class LruCache
+     * @brief A cache of at most capacity values, dropping the least recently used one to make room.
+     * @details Values live in a fixed array of slots found through a map from their keys, so a value found or
+     * emplaced stays where it is until its slot is reused, which takes at least capacity - 1 other misses. Lookups
+     * are counted as hits and misses for reporting.
+     */
+    template <typename key_t, typename val_t> class LruCache {
+        size_t capacity_;
+        std::unique_ptr<val_t[]> values_;
+        std::unique_ptr<key_t[]> keys_;
+        // the lookup each slot was last used by, 0 for an empty slot
+        std::unique_ptr<size_t[]> last_used_;
+        map<key_t, size_t> slot_of_;
+        size_t clock_ = 0;
+        size_t hits_ = 0;
+        size_t misses_ = 0;
+
+        size_t least_recently_used() const {
+            size_t victim = 0;
+            for (size_t slot = 1; slot < capacity_ && last_used_[victim] != 0; ++slot)
+                if (last_used_[slot] < last_used_[victim])
+                    victim = slot;
+            return victim;
+        }
+
+      public:
+        explicit LruCache(const size_t &capacity)
+            : capacity_(capacity), values_(new val_t[capacity]), keys_(new key_t[capacity]),
+              last_used_(new size_t[capacity]()) {
+            assert(capacity > 0);
+        }
+
+        // Returns the value cached under key, or nullptr if it has to be loaded
+        val_t *find(const key_t &key) {
+            const auto found = slot_of_.find(key);
+            if (found == slot_of_.end()) {
+                ++misses_;
+                return nullptr;
+            }
+            ++hits_;
+            last_used_[found->second] = ++clock_;
+            return &values_[found->second];
+        }
+
+        // Returns the value cached under key, or nullptr, without using it or counting the lookup
+        val_t *peek(const key_t &key) {
+            const auto found = slot_of_.find(key);
+            return found == slot_of_.end() ? nullptr : &values_[found->second];
+        }
+
+        // Makes room for key, which must not be cached, and returns the value to fill in
+        val_t &emplace(const key_t &key) {
+            assert(slot_of_.find(key) == slot_of_.end());
+            const size_t slot = least_recently_used();
+            if (last_used_[slot] != 0)
+                slot_of_.erase(slot_of_.find(keys_[slot]));
+            keys_[slot] = key;
+            last_used_[slot] = ++clock_;
+            slot_of_.insert({key, slot});
+            return values_[slot];
+        }
+
+        void erase(const key_t &key) {
+            const auto found = slot_of_.find(key);
+            if (found == slot_of_.end())
+                return;
+            last_used_[found->second] = 0;
+            slot_of_.erase(found);
+        }
+
+        // Drops every value, keeping the counts of hits and misses
+        void clear() {
+            for (size_t slot = 0; slot < capacity_; ++slot)
+                last_used_[slot] = 0;
+            slot_of_.clear();
+        }
+
+        [[nodiscard]] size_t size() const {
+            return slot_of_.size();
+        }
+
+        [[nodiscard]] size_t capacity() const {
+            return capacity_;
+        }
+
+        [[nodiscard]] size_t hits() const {
+            return hits_;
+        }
+
+        [[nodiscard]] size_t misses() const {
+            return misses_;
+        }
+    };
+} // namespace norb
@@ -622,7 +622,11 @@ class map {
      * return an iterator to the end
      * in fact, it returns past-the-end.
      */
-    iterator end() const {
+    iterator end() {
+        return {this, nullptr};
+    }
+
+    const_iterator end() const {
         return {this, nullptr};
     }
 
@@ -0,0 +1,282 @@
+#pragma once
+
+#include "b_plus_tree.hpp"
+#include "persistent_memory.hpp"
+#include "range.hpp"
+#include "vector.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace norb {
+    /**
+     * @struct SegmentCompactionReport
+     * @brief The number of data pages of a PagedSegmentList before and after a compaction.
+     */
+    struct SegmentCompactionReport {
+        size_t pages_before = 0;
+        size_t pages_after = 0;
+    };
+
+    /**
+     * @class PagedSegmentList
+     * @brief A FiledSegmentList whose elements live in pages of PersistentMemory.
+     * @details Reads are served from the shared buffer pool and writes reach the disk through its dirty tracking and
+     * eviction. Elements keep their global indices, so a SegmentPointer means the same as in FiledSegmentList.
+     * A segment never straddles a page: allocate skips to the next page when the rest of the current one is too
+     * short, so every segment access touches exactly one page. The data pages are listed in a three-level directory
+     * of pages, loaded into an in-memory page table on construction. Indices are 64-bit, so a list may grow past the
+     * 2 GiB that int offsets allowed, up to 512 GiB of elements.
+     * Released segments are kept in free lists by size and reused by allocate. A compaction moves every live segment,
+     * in the order its owners visit them, to the front of a fresh run of pages:
+     * begin_compaction(), then relocate() each live segment and store the new pointer in its owner, then
+     * end_compaction().
+     */
+    template <typename T_> class PagedSegmentList {
+      public:
+        struct SegmentPointer {
+            int64_t cur;
+            int size;
+
+            auto operator<=>(const SegmentPointer &other) const = default;
+            bool operator==(const SegmentPointer &other) const = default;
+        };
+
+        static constexpr int elements_per_page = PAGE_SIZE / sizeof(T_);
+        static_assert(elements_per_page > 0, "Segment elements must fit in a page");
+
+      private:
+        static constexpr size_t directory_fanout = PAGE_SIZE / sizeof(page_id_t);
+        static constexpr int directory_depth = 3;
+        static constexpr int64_t max_page_count = directory_fanout * directory_fanout * directory_fanout;
+
+        struct DataPage {
+            T_ data[elements_per_page];
+        };
+        struct DirectoryPage {
+            page_id_t pages[directory_fanout];
+        };
+
+        using MutableHandle = PersistentMemory::MutableHandle;
+
+        // the root directory, the directory depth and the element count, kept in the superblock catalog; the page
+        // count follows from the element count, as a new page is only opened by a segment that starts on it
+        PersistentMemory::CatalogEntry &catalog;
+        // page_table[i] is the page holding the elements [i * elements_per_page, (i + 1) * elements_per_page)
+        vector<page_id_t> page_table;
+        // released segments by size; the size classes are exact, allocate takes the smallest that fits. Many segments
+        // share a size, so the index nodes must hold the segments too (AUTOMATIC) for remove to find them.
+        BPlusTree<int, SegmentPointer> free_segments;
+
+        // the pages being compacted away, between begin_compaction and end_compaction
+        bool compacting = false;
+        vector<page_id_t> old_page_table;
+        MutableHandle old_root;
+
+        // Visits the first remaining data pages listed under a directory at the given level, in order, and then
+        // each directory page on the way, children before their parent.
+        template <typename DataVisitor, typename DirectoryVisitor>
+        static void walk_directory(const MutableHandle &directory, const int level, int64_t &remaining,
+                                   DataVisitor &&visit_data, DirectoryVisitor &&visit_directory) {
+            for (size_t i = 0; i < directory_fanout && remaining > 0; ++i) {
+                const page_id_t child = directory.const_ref<DirectoryPage>()->pages[i];
+                if (level == directory_depth - 1) {
+                    visit_data(child);
+                    --remaining;
+                } else {
+                    walk_directory(PersistentMemory::fetch_mutable_handle(child), level + 1, remaining, visit_data,
+                                   visit_directory);
+                }
+            }
+            visit_directory(directory);
+        }
+
+        // Returns the data pages in table and the directory under directory_root to the garbage collector.
+        static void free_pages(const vector<page_id_t> &table, const MutableHandle &directory_root) {
+            for (size_t i = 0; i < table.size(); ++i) {
+                PersistentMemory::remove<DataPage>(PersistentMemory::fetch_mutable_handle(table[i]));
+            }
+            if (directory_root.is_nullptr())
+                return;
+            int64_t remaining = static_cast<int64_t>(table.size());
+            walk_directory(directory_root, 0, remaining, [](const page_id_t &) {},
+                           [](const MutableHandle &directory) { PersistentMemory::remove<DirectoryPage>(directory); });
+        }
+
+        void reset() {
+            catalog.size = 0;
+            catalog.root.set_nullptr();
+            page_table.clear();
+            free_segments.clear();
+        }
+
+        void append_page() {
+            const int64_t page_index = static_cast<int64_t>(page_table.size());
+            if (page_index >= max_page_count) {
+                throw std::length_error("norb::PagedSegmentList: PAGE DIRECTORY IS FULL!");
+            }
+            if (catalog.root.is_nullptr()) {
+                catalog.root = PersistentMemory::create_mutable_and_init<DirectoryPage>();
+                catalog.height = directory_depth;
+            }
+            // walk down to the last-level directory of the new page, opening the directories it is the first of
+            MutableHandle directory = catalog.root;
+            int64_t stride = max_page_count / directory_fanout;
+            for (int level = 0; level < directory_depth - 1; ++level) {
+                const size_t slot = page_index / stride % directory_fanout;
+                if (page_index % stride == 0) {
+                    const MutableHandle child = PersistentMemory::create_mutable_and_init<DirectoryPage>();
+                    directory.ref<DirectoryPage>()->pages[slot] = child.page_id;
+                    directory = child;
+                } else {
+                    directory = PersistentMemory::fetch_mutable_handle(directory.const_ref<DirectoryPage>()->pages[slot]);
+                }
+                stride /= directory_fanout;
+            }
+            const MutableHandle data_page = PersistentMemory::create_mutable();
+            directory.ref<DirectoryPage>()->pages[page_index % directory_fanout] = data_page.page_id;
+            page_table.push_back(data_page.page_id);
+        }
+
+        // The page and the offset within it of the elements [from, to) of seg.
+        MutableHandle locate(const SegmentPointer &seg, const int from, const int to, int &offset) const {
+            if (from < 0 || to > seg.size || from > to) {
+                throw std::range_error("norb::PagedSegmentList: INDEX OUT OF RANGE!");
+            }
+            assert(seg.cur % elements_per_page + seg.size <= elements_per_page && "Segment straddles a page");
+            offset = static_cast<int>(seg.cur % elements_per_page) + from;
+            if (from == to)
+                return MutableHandle(); // an empty segment may lie past the last page
+            return PersistentMemory::fetch_mutable_handle(page_table[seg.cur / elements_per_page]);
+        }
+
+      public:
+        // A list keyed in the catalog by its order of construction.
+        PagedSegmentList() : PagedSegmentList(PersistentMemory::anonymous_name()) {
+        }
+        // A list kept under a name in the catalog; its free lists are kept under the name + ".free".
+        explicit PagedSegmentList(const std::string &name)
+            : catalog(PersistentMemory::catalog_entry(name)), free_segments(name + ".free") {
+            reload();
+        }
+
+        // Rebuilds the page table from the directory, after the pages changed under the list, as a snapshot
+        // restore does.
+        void reload() {
+            page_table.clear();
+            if (catalog.root.is_nullptr())
+                return;
+            if (catalog.height != directory_depth) {
+                throw std::runtime_error("norb::PagedSegmentList: UNSUPPORTED DIRECTORY DEPTH!");
+            }
+            int64_t remaining = (static_cast<int64_t>(catalog.size) + elements_per_page - 1) / elements_per_page;
+            walk_directory(catalog.root, 0, remaining, [this](const page_id_t &page) { page_table.push_back(page); },
+                           [](const MutableHandle &) {});
+        }
+
+        T_ get(const SegmentPointer &seg, const int index) const {
+            int offset;
+            const MutableHandle page = locate(seg, index, index + 1, offset);
+            return page.const_ref<DataPage>()->data[offset];
+        }
+
+        T_ set(const SegmentPointer &seg, const int index, const T_ &to) {
+            int offset;
+            const MutableHandle page = locate(seg, index, index + 1, offset);
+            page.ref<DataPage>()->data[offset] = to;
+            return to;
+        }
+
+        // Reads the elements [from, to) of the segment into out.
+        void read_segment(const SegmentPointer &seg, const int from, const int to, T_ *out) const {
+            int offset;
+            const MutableHandle page = locate(seg, from, to, offset);
+            if (from == to)
+                return;
+            std::memcpy(out, page.const_ref<DataPage>()->data + offset, sizeof(T_) * (to - from));
+        }
+
+        // Writes in[0, to - from) over the elements [from, to) of the segment.
+        void write_segment(const SegmentPointer &seg, const int from, const int to, const T_ *in) {
+            int offset;
+            const MutableHandle page = locate(seg, from, to, offset);
+            if (from == to)
+                return;
+            std::memcpy(page.ref<DataPage>()->data + offset, in, sizeof(T_) * (to - from));
+        }
+
+        SegmentPointer allocate(const int size) {
+            if (size < 0 || size > elements_per_page) {
+                throw std::length_error("norb::PagedSegmentList: SEGMENT DOES NOT FIT IN A PAGE!");
+            }
+            if (size > 0 && free_segments.size() != 0) {
+                const auto free_segment = free_segments.find_first_in_range(Range<int>(size, elements_per_page));
+                if (free_segment.has_value()) {
+                    const bool removed = free_segments.remove(free_segment->size, free_segment.value());
+                    assert(removed && "Free segment lost from its size class");
+                    // the rest stays on the same page and goes back to the free lists
+                    release({free_segment->cur + size, free_segment->size - size});
+                    return {free_segment->cur, size};
+                }
+            }
+            int64_t cur = static_cast<int64_t>(catalog.size);
+            if (cur % elements_per_page + size > elements_per_page) {
+                cur += elements_per_page - cur % elements_per_page;
+            }
+            while (static_cast<int64_t>(page_table.size()) * elements_per_page < cur + size) {
+                append_page();
+            }
+            catalog.size = cur + size;
+            return {cur, size};
+        }
+
+        // Hands the segment back for reuse by allocate. Its contents are left as they are.
+        void release(const SegmentPointer &seg) {
+            if (seg.size > 0) {
+                free_segments.insert(seg.size, seg);
+            }
+        }
+
+        // Releases every segment and returns all pages to the garbage collector.
+        void clear() {
+            assert(not compacting);
+            free_pages(page_table, catalog.root);
+            reset();
+        }
+
+        void begin_compaction() {
+            assert(not compacting);
+            compacting = true;
+            old_page_table = page_table;
+            old_root = catalog.root;
+            reset();
+        }
+
+        // Copies a live segment of the list being compacted into the new pages, returning its new pointer.
+        SegmentPointer relocate(const SegmentPointer &seg) {
+            assert(compacting);
+            const SegmentPointer moved = allocate(seg.size);
+            if (seg.size == 0)
+                return moved;
+            const MutableHandle old_page =
+                PersistentMemory::fetch_mutable_handle(old_page_table[seg.cur / elements_per_page]);
+            T_ buffer[elements_per_page];
+            std::memcpy(buffer, old_page.const_ref<DataPage>()->data + seg.cur % elements_per_page,
+                        sizeof(T_) * seg.size);
+            write_segment(moved, 0, moved.size, buffer);
+            return moved;
+        }
+
+        // Frees the pages the list had before begin_compaction; segments that were not relocated are lost.
+        SegmentCompactionReport end_compaction() {
+            assert(compacting);
+            free_pages(old_page_table, old_root);
+            const SegmentCompactionReport report{old_page_table.size(), page_table.size()};
+            old_page_table.clear();
+            old_root.set_nullptr();
+            compacting = false;
+            return report;
+        }
+    };
+} // namespace norb
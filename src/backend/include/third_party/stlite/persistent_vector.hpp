@@ -3,46 +3,116 @@
 #include "utils.hpp"
 #include "vector.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 
 namespace norb {
+    /**
+     * @class PersistentVector
+     * @brief A vector kept in memory and mirrored to an append log on disk.
+     * @details The file is a header followed by the elements, and its length gives the element count, so push_back
+     * makes the new element durable with one append and no header update. pop_back and clear truncate the file.
+     * Elements changed in place through operator[] are only written back by compact(), which rewrites the file and is
+     * run on destruction when needed. Startup loads the whole file with a single read; a torn last element, left by a
+     * crash in the middle of an append, is dropped. Files of the old format, an int count followed by the elements,
+     * are rewritten on opening.
+     */
     template <typename T> class PersistentVector {
+        static_assert(std::is_trivially_copyable_v<T>, "PersistentVector stores its elements byte by byte");
+
+        struct Header {
+            static constexpr uint32_t magic_v = 0x3156504e; // "NPV1"
+            static constexpr uint32_t current_version = 2;
+
+            uint32_t magic = magic_v;
+            uint32_t version = current_version;
+            uint64_t element_size = sizeof(T);
+        };
+        static constexpr std::streamoff data_offset = sizeof(Header);
+
         norb::vector<T> data;
+        std::string file_name;
         std::fstream f_stream;
+        // the elements [0, data.size()) on disk may differ from memory, set by the mutable operator[]
+        bool dirty = false;
         static constexpr auto file_open_mode = std::ios::binary | std::ios::in | std::ios::out;
 
+        std::streamoff get_pos(const size_t index) const {
+            return data_offset + static_cast<std::streamoff>(sizeof(T) * index);
+        }
+
+        // Cuts the file to the elements held in memory.
+        void truncate_file() {
+            f_stream.flush();
+            std::filesystem::resize_file(file_name, get_pos(data.size()));
+        }
+
+        // Fills data from the bytes of count elements.
+        void load(const char *bytes, const size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                T item;
+                std::memcpy(&item, bytes + sizeof(T) * i, sizeof(T));
+                data.push_back(item);
+            }
+        }
+
       public:
-        void flush() {
+        // Rewrites the file from memory. Only needed after changes through the mutable operator[].
+        void compact() {
             f_stream.seekp(0, std::ios::beg);
-            int size_ = data.size();
-            filesystem::binary_write(f_stream, size_);
+            filesystem::binary_write(f_stream, Header{});
             for (const auto &item : data) {
                 filesystem::binary_write(f_stream, item);
             }
-            f_stream.flush(); // Ensure data is written
+            truncate_file();
+            dirty = false;
         }
 
-        PersistentVector(const std::string &file_name) {
+        void flush() {
+            if (dirty) {
+                compact();
+            }
+            f_stream.flush();
+        }
+
+        PersistentVector(const std::string &file_name_) : file_name(file_name_) {
             filesystem::fassert(file_name);
+            const size_t file_size = filesystem::get_size(file_name);
             f_stream.open(file_name, file_open_mode);
             assert(f_stream.good());
+            if (file_size == 0) {
+                compact();
+                return;
+            }
+            // one read for the whole file
+            const std::unique_ptr<char[]> bytes(new char[file_size]);
             f_stream.seekg(0);
-            if (!filesystem::is_empty(f_stream)) {
-                // Read the size from the disk.
-                int size_;
-                filesystem::binary_read(f_stream, size_);
-                // Read the data from the disk.
-                for (int i = 0; i < size_; ++i) {
-                    T item;
-                    filesystem::binary_read(f_stream, item);
-                    data.push_back(item);
+            f_stream.read(bytes.get(), static_cast<std::streamsize>(file_size));
+            assert(f_stream.good());
+            Header header;
+            std::memcpy(&header, bytes.get(), std::min(file_size, sizeof(Header)));
+            if (file_size >= sizeof(Header) && header.magic == Header::magic_v) {
+                if (header.version != Header::current_version || header.element_size != sizeof(T)) {
+                    throw std::runtime_error("norb::PersistentVector: UNSUPPORTED FILE FORMAT!");
+                }
+                load(bytes.get() + data_offset, (file_size - data_offset) / sizeof(T));
+                if (get_pos(data.size()) != static_cast<std::streamoff>(file_size)) {
+                    truncate_file(); // drop the torn element
                 }
             } else {
-                // Write a zero to the disk.
-                f_stream.seekp(0);
+                // the old format: an int count, then the elements
                 int size_ = 0;
-                filesystem::binary_write(f_stream, size_);
+                std::memcpy(&size_, bytes.get(), std::min(file_size, sizeof(int)));
+                const size_t stored = file_size < sizeof(int) ? 0 : (file_size - sizeof(int)) / sizeof(T);
+                load(bytes.get() + sizeof(int), std::min(static_cast<size_t>(std::max(size_, 0)), stored));
+                compact();
             }
             assert(f_stream.good());
         }
@@ -51,16 +121,21 @@ namespace norb {
             flush(); // Ensure data is written before destruction
         }
 
-        // all the following functions will modify the data in the memory
+        // all the following functions will modify the data in the memory, and append or truncate the log
         void push_back(const T &item) {
             data.push_back(item);
+            f_stream.seekp(get_pos(data.size() - 1), std::ios::beg);
+            filesystem::binary_write(f_stream, item);
+            f_stream.flush();
         }
 
         void pop_back() {
             data.pop_back();
+            truncate_file();
         }
 
         T &operator[](size_t index) {
+            dirty = true;
             return data[index];
         }
 
@@ -74,6 +149,8 @@ namespace norb {
 
         void clear() {
             data.clear();
+            dirty = false;
+            truncate_file();
         }
 
         // const iterator
@@ -107,4 +184,4 @@ namespace norb {
             return const_iterator(this, data.size());
         }
     };
-} // namespace norb
\ No newline at end of file
+} // namespace norb
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace norb {
+    /**
+     * @class ThreadPool
+     * @brief A fixed set of threads that run one task at a time together with the thread that hands it over.
+     * @details run(task) calls task(worker) once for every worker in [0, size()), the calling thread taking worker 0,
+     * and returns once all of them have. The threads wait between tasks rather than being started for each one. An
+     * exception thrown by the task is rethrown by run, after every worker has finished.
+     */
+    class ThreadPool {
+        std::vector<std::thread> threads_;
+        std::mutex mutex_;
+        std::condition_variable task_ready_;
+        std::condition_variable task_done_;
+        const std::function<void(size_t)> *task_ = nullptr;
+        size_t generation_ = 0; // counts the tasks handed over, for a thread to tell a new one
+        size_t running_ = 0;
+        bool stopping_ = false;
+        std::exception_ptr error_;
+
+        void work(const size_t worker) {
+            size_t seen = 0;
+            while (true) {
+                const std::function<void(size_t)> *task;
+                {
+                    std::unique_lock lock(mutex_);
+                    task_ready_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+                    if (stopping_)
+                        return;
+                    seen = generation_;
+                    task = task_;
+                }
+                std::exception_ptr error;
+                try {
+                    (*task)(worker);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                std::lock_guard lock(mutex_);
+                if (error && not error_)
+                    error_ = error;
+                if (--running_ == 0)
+                    task_done_.notify_one();
+            }
+        }
+
+      public:
+        // A pool of size workers, size - 1 of them threads of its own
+        explicit ThreadPool(const size_t &size) {
+            for (size_t worker = 1; worker < size; ++worker)
+                threads_.emplace_back(&ThreadPool::work, this, worker);
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        ~ThreadPool() {
+            {
+                std::lock_guard lock(mutex_);
+                stopping_ = true;
+            }
+            task_ready_.notify_all();
+            for (auto &thread : threads_)
+                thread.join();
+        }
+
+        [[nodiscard]] size_t size() const {
+            return threads_.size() + 1;
+        }
+
+        void run(const std::function<void(size_t)> &task) {
+            {
+                std::lock_guard lock(mutex_);
+                task_ = &task;
+                running_ = threads_.size();
+                error_ = nullptr;
+                ++generation_;
+            }
+            task_ready_.notify_all();
+            std::exception_ptr error;
+            try {
+                task(0);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::unique_lock lock(mutex_);
+            task_done_.wait(lock, [this] { return running_ == 0; });
+            if (not error)
+                error = error_;
+            if (error)
+                std::rethrow_exception(error);
+        }
+    };
+} // namespace norb
@@ -6,8 +6,10 @@
 #include <cassert>
 #include <cstdint>
 #include <cstring>
+#include <fcntl.h>
 #include <fstream>
 #include <string>
+#include <unistd.h>
 
 namespace norb
 {
@@ -73,6 +75,17 @@ namespace norb
             fassert(file_name);
             f.open(file_name, mode);
         }
+
+        // Force what was written to a file down to the disk. The streams must
+        // be flushed first.
+        inline void sync_to_disk(const std::string& path)
+        {
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            ::fsync(fd);
+            ::close(fd);
+        }
     } // namespace filesystem
 
     namespace hash
@@ -259,8 +272,8 @@ namespace norb
         inline void remove_associated()
         {
             std::remove(settings::PMEM_FILE_NAME.c_str());
-            std::remove(settings::NPMEM_FILE_NAME.c_str());
-            std::remove("persistent.config");
+            std::remove((settings::PMEM_FILE_NAME + ".config").c_str());
+            std::remove((settings::PMEM_FILE_NAME + ".wal").c_str());
             std::remove("train_group.segments");
             std::remove("train_fare.segments");
         }
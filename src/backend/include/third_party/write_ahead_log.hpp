@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace norb {
+    using lsn_t = uint64_t;
+
+    /**
+     * @class WriteAheadLog
+     * @brief An append-only file of checksummed records, made durable in groups.
+     * @details A record is a header (type, payload length, checksum) followed by its payload; its LSN is the offset
+     * it ends at. Appends are buffered and reach the file on sync(), which also fsyncs it. group_commit() is called
+     * once per command and syncs only every group_commands commands or group_interval, whichever comes first, so a
+     * crash loses at most that much of the most recent work. Reading stops at the first torn or corrupt record.
+     * Checkpoints drop the records before their LSN by punching a hole at the front of the file.
+     * @remark Uses POSIX file descriptors, as fstream cannot fsync.
+     */
+    class WriteAheadLog {
+      public:
+        struct RecordHeader {
+            uint32_t type = 0;
+            uint32_t length = 0;
+            uint64_t checksum = 0;
+        };
+
+        // fnv-1a over 8-byte words, then the trailing bytes
+        static uint64_t checksum_of(const char *bytes, const size_t length) {
+            constexpr uint64_t prime = 0x100000001b3ULL;
+            uint64_t hash = 0xcbf29ce484222325ULL;
+            size_t i = 0;
+            for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+                uint64_t word;
+                std::memcpy(&word, bytes + i, sizeof(word));
+                hash = (hash ^ word) * prime;
+                hash ^= hash >> 29;
+            }
+            for (; i < length; i++)
+                hash = (hash ^ static_cast<unsigned char>(bytes[i])) * prime;
+            return hash;
+        }
+
+      private:
+        // buffered bytes past this are written out even before a sync
+        static constexpr size_t max_pending_bytes = 1 << 20;
+        // holes are punched in whole blocks
+        static constexpr lsn_t discard_granularity = 4096;
+
+        int fd = -1;
+        std::string pending;
+        lsn_t written_lsn = 0; // the end of the bytes in the file
+        lsn_t durable_lsn_ = 0;
+        size_t commands_since_sync = 0;
+        std::chrono::steady_clock::time_point last_sync = std::chrono::steady_clock::now();
+        size_t group_commands;
+        std::chrono::milliseconds group_interval;
+
+        void write_pending() {
+            size_t done = 0;
+            while (done < pending.size()) {
+                const auto written = ::write(fd, pending.data() + done, pending.size() - done);
+                if (written < 0)
+                    throw std::runtime_error("norb::WriteAheadLog: WRITE FAILED!");
+                done += written;
+            }
+            written_lsn += pending.size();
+            pending.clear();
+        }
+
+      public:
+        WriteAheadLog(const std::string &path, const size_t group_commands, const std::chrono::milliseconds group_interval)
+            : group_commands(group_commands), group_interval(group_interval) {
+            fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+            if (fd < 0)
+                throw std::runtime_error("norb::WriteAheadLog: CANNOT OPEN " + path);
+            struct stat status {};
+            ::fstat(fd, &status);
+            written_lsn = durable_lsn_ = status.st_size;
+        }
+
+        ~WriteAheadLog() {
+            sync();
+            ::close(fd);
+        }
+
+        WriteAheadLog(const WriteAheadLog &) = delete;
+        WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+        // Appends a record made of a fixed part and a variable tail, returning its LSN.
+        lsn_t append(const uint32_t type, const void *head, const size_t head_length, const void *tail = nullptr,
+                     const size_t tail_length = 0) {
+            RecordHeader header;
+            header.type = type;
+            header.length = static_cast<uint32_t>(head_length + tail_length);
+            const size_t start = pending.size();
+            pending.append(reinterpret_cast<const char *>(&header), sizeof(header));
+            pending.append(static_cast<const char *>(head), head_length);
+            if (tail_length)
+                pending.append(static_cast<const char *>(tail), tail_length);
+            const auto checksum = checksum_of(pending.data() + start + sizeof(header), header.length);
+            std::memcpy(pending.data() + start + offsetof(RecordHeader, checksum), &checksum, sizeof(checksum));
+            const lsn_t lsn = end_lsn();
+            if (pending.size() >= max_pending_bytes)
+                write_pending();
+            return lsn;
+        }
+
+        // Makes every record appended so far durable.
+        void sync() {
+            if (end_lsn() == durable_lsn_)
+                return;
+            write_pending();
+            ::fdatasync(fd);
+            durable_lsn_ = written_lsn;
+            commands_since_sync = 0;
+            last_sync = std::chrono::steady_clock::now();
+        }
+
+        // Ends a command, syncing if the group is full or old enough.
+        void group_commit() {
+            ++commands_since_sync;
+            if (commands_since_sync >= group_commands ||
+                std::chrono::steady_clock::now() - last_sync >= group_interval) {
+                sync();
+            }
+        }
+
+        // Makes sure the log is durable up to lsn, as needed before a page changed by it is written in place.
+        void sync_up_to(const lsn_t &lsn) {
+            if (lsn > durable_lsn_)
+                sync();
+        }
+
+        // Frees the disk space of the records before lsn, which a checkpoint has made redundant. The offsets of the
+        // later records, and so their LSNs, stay as they are.
+        void discard_before(const lsn_t &lsn) {
+            const auto length = static_cast<off_t>(lsn / discard_granularity * discard_granularity);
+            if (length > 0)
+                ::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, length); // best effort
+        }
+
+        // Drops every record, once a checkpoint has made them redundant.
+        void truncate() {
+            pending.clear();
+            if (::ftruncate(fd, 0) != 0)
+                throw std::runtime_error("norb::WriteAheadLog: TRUNCATE FAILED!");
+            ::fdatasync(fd);
+            written_lsn = durable_lsn_ = 0;
+            commands_since_sync = 0;
+        }
+
+        [[nodiscard]] lsn_t end_lsn() const {
+            return written_lsn + pending.size();
+        }
+
+        [[nodiscard]] lsn_t durable_lsn() const {
+            return durable_lsn_;
+        }
+
+        // Reads the intact records from the one at LSN from on, and calls visit(type, payload, length) for each in
+        // order.
+        template <typename Visitor> void replay(const lsn_t &from, Visitor &&visit) {
+            sync();
+            const std::string bytes = read_from(from);
+            size_t cur = 0;
+            while (cur + sizeof(RecordHeader) <= bytes.size()) {
+                RecordHeader header;
+                std::memcpy(&header, bytes.data() + cur, sizeof(header));
+                const size_t payload = cur + sizeof(header);
+                if (payload + header.length > bytes.size() ||
+                    checksum_of(bytes.data() + payload, header.length) != header.checksum)
+                    break; // torn by a crash
+                visit(header.type, bytes.data() + payload, static_cast<size_t>(header.length));
+                cur = payload + header.length;
+            }
+        }
+
+      private:
+        std::string read_from(const lsn_t &from) const {
+            std::string bytes(from < written_lsn ? written_lsn - from : 0, '\0');
+            size_t done = 0;
+            while (done < bytes.size()) {
+                const auto read =
+                    ::pread(fd, bytes.data() + done, bytes.size() - done, static_cast<off_t>(from + done));
+                if (read <= 0)
+                    break;
+                done += read;
+            }
+            bytes.resize(done);
+            return bytes;
+        }
+    };
+} // namespace norb
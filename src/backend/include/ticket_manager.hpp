@@ -2,8 +2,9 @@
 
 #include "datetime.hpp"
 #include "logging.hpp"
-#include "stlite/filed_list.hpp"
+#include "stlite/paged_segment_list.hpp"
 #include "stlite/pair.hpp"
+#include "sorted_view.hpp"
 
 #include "settings.hpp"
 #include "utility/wrappers.hpp"
@@ -30,7 +31,7 @@ namespace ticket {
     };
 
     struct TrainFare {
-        using SegmentList = norb::FiledSegmentList<TrainFareSegment>;
+        using SegmentList = norb::PagedSegmentList<TrainFareSegment>;
 
         train_id_t train_id;
         SegmentList::SegmentPointer segment_pointer;
@@ -40,9 +41,11 @@ namespace ticket {
             if (from < 0 || to >= segment_pointer.size || from > to) {
                 throw std::runtime_error("Invalid segment range query");
             }
-            auto ans = seg_ref.get(segment_pointer, from);
-            for (int i = from + 1; i <= to; ++i) {
-                ans = ans & seg_ref.get(segment_pointer, i);
+            TrainFareSegment segments[max_station_num];
+            seg_ref.read_segment(segment_pointer, from, to + 1, segments);
+            auto ans = segments[0];
+            for (int i = 1; i <= to - from; ++i) {
+                ans = ans & segments[i];
             }
             return ans;
         }
@@ -110,11 +113,25 @@ namespace ticket {
         using LogLevel = norb::LogLevel;
         using TrainStatusSegmentPointer = TrainFare::SegmentList::SegmentPointer;
 
-        norb::BPlusTree<Order::order_id_t, Order, norb::MANUAL> purchase_history_store;
-        norb::BPlusTree<norb::Pair<train_id_t, timestamp_t>, order_id_t, norb::MANUAL> pending_order_store;
+        // adds delta to the remaining seats of the stations [from_serial, to_serial), in one read and one write
+        void update_remaining_seats(const TrainStatusSegmentPointer &segment_pointer, const int from_serial,
+                                    const int to_serial, const int delta) {
+            TrainFareSegment segments[max_station_num];
+            train_fare_segments.read_segment(segment_pointer, from_serial, to_serial, segments);
+            for (int i = 0; i < to_serial - from_serial; ++i) {
+                segments[i].remaining_seats += delta;
+                assert(segments[i].remaining_seats >= 0 && "Not enough seats available");
+            }
+            train_fare_segments.write_segment(segment_pointer, from_serial, to_serial, segments);
+        }
+
+        norb::BPlusTree<Order::order_id_t, Order, norb::MANUAL, order_store_page_size> purchase_history_store{
+            "purchase_history_store", order_store_compression};
+        norb::BPlusTree<norb::Pair<train_id_t, timestamp_t>, order_id_t, norb::MANUAL> pending_order_store{
+            "pending_order_store"};
         ;
-        norb::BPlusTree<train_id_t, TrainFare, norb::MANUAL> train_fare_store;
-        norb::FiledSegmentList<TrainFareSegment> train_fare_segments;
+        norb::BPlusTree<train_id_t, TrainFare, norb::MANUAL> train_fare_store{"train_fare_store"};
+        TrainFare::SegmentList train_fare_segments{"train_fare_segments"};
 
         struct TemporalTrainGroupInfo {
             // norb::vector<price_t> prices;
@@ -168,8 +185,7 @@ namespace ticket {
         } temporary_train_group_info_store;
 
       public:
-        TicketManager() : train_fare_segments(train_fare_segments_name) {
-        }
+        TicketManager() = default;
 
         // this will not check the validity of the train group ID
         void add_train_group(const train_group_id_t &train_group_id, const norb::vector<price_t> &prices,
@@ -186,15 +202,16 @@ namespace ticket {
             const auto prices = temporary_train_group_info_store.get_prices(train_group_id);
             const auto sale_date_range = temporary_train_group_info_store.get_sale_date_range(train_group_id);
             const auto seat_num = temporary_train_group_info_store.get_seat_num(train_group_id);
+            // every date starts from the same fares and seats
+            TrainFareSegment segments[max_station_num];
+            for (size_t i = 0; i < prices.size(); ++i) {
+                segments[i] = {prices[i], seat_num};
+            }
             for (Date date = sale_date_range.get_from(); date <= sale_date_range.get_to(); ++date) {
                 auto segment_pointer = train_fare_segments.allocate(prices.size());
                 // interface::log.as(LogLevel::DEBUG) << "Allocated segment pointer: (cur=" << segment_pointer.cur
                 //                                    << ", size=" << segment_pointer.size << ")\n";
-                for (size_t i = 0; i < prices.size(); ++i) {
-                    train_fare_segments.set(segment_pointer, i, {prices[i], seat_num});
-                    // interface::log.as(LogLevel::DEBUG)
-                    //     << "Segment set to: price=" << prices[i] << " seats=" << seat_num << "\n";
-                }
+                train_fare_segments.write_segment(segment_pointer, 0, segment_pointer.size, segments);
                 const auto train_id = train_id_t{train_group_id, date};
                 train_fare_store.insert(train_id, {train_id, segment_pointer});
             }
@@ -230,10 +247,12 @@ namespace ticket {
             if (not train_status.has_value()) {
                 throw std::runtime_error("Train status not found.");
             }
+            TrainFareSegment segments[max_station_num];
+            train_fare_segments.read_segment(train_status->segment_pointer, 0, train_status->segment_pointer.size,
+                                             segments);
             norb::vector<int> remaining_seats;
             for (int i = 0; i < train_status->segment_pointer.size; ++i) {
-                remaining_seats.push_back(
-                    get_train_status_station_segment(train_status->segment_pointer, i).remaining_seats);
+                remaining_seats.push_back(segments[i].remaining_seats);
             }
             return remaining_seats;
         }
@@ -250,6 +269,41 @@ namespace ticket {
             return train_status->join_segments(train_fare_segments, from_serial, to_serial - 1);
         }
 
+        struct SectionQuery {
+            train_id_t train_id;
+            int from_serial;
+            int to_serial;
+        };
+
+        // batched get_price_seat_for_section: the fares of all sections are found in one pass over train_fare_store
+        norb::vector<TrainFareSegment> get_price_seat_for_sections(const norb::vector<SectionQuery> &sections) const {
+            const int section_count = sections.size();
+            const auto order = norb::make_sorted(section_count, [&sections](const int &a, const int &b) {
+                return sections[a].train_id < sections[b].train_id;
+            });
+            norb::vector<train_id_t> sorted_train_ids;
+            for (const auto &i : order)
+                sorted_train_ids.push_back(sections[i].train_id);
+            const auto sorted_train_status = train_fare_store.find_many(sorted_train_ids);
+            norb::vector<TrainFareSegment> ret;
+            for (int i = 0; i < section_count; ++i)
+                ret.push_back({});
+            for (int k = 0; k < section_count; ++k) {
+                const auto &train_status = sorted_train_status[k];
+                const auto &section = sections[order[k]];
+                if (not train_status.has_value()) {
+                    throw std::runtime_error("Train status not found.");
+                }
+                if (section.from_serial < 0 || section.to_serial - 1 >= train_status->segment_pointer.size ||
+                    section.from_serial > section.to_serial) {
+                    throw std::out_of_range("Invalid segment range query");
+                }
+                ret[order[k]] =
+                    train_status->join_segments(train_fare_segments, section.from_serial, section.to_serial - 1);
+            }
+            return ret;
+        }
+
         void register_order(const Order &order) {
             interface::log.as(LogLevel::DEBUG) << "[TicketManager] Registering order: " << order.id() << '\n';
             if (purchase_history_store.count(order.id())) {
@@ -265,13 +319,8 @@ namespace ticket {
                 if (not train_status.has_value()) {
                     throw std::runtime_error("Train status not found."); // this should not happen
                 }
-                auto segment_pointer = train_status->segment_pointer;
-                for (int i = order.from_station_serial; i < order.to_station_serial; ++i) {
-                    auto segment = train_fare_segments.get(segment_pointer, i);
-                    assert(segment.remaining_seats >= order.count && "Not enough seats available");
-                    segment.remaining_seats -= order.count;
-                    train_fare_segments.set(segment_pointer, i, segment);
-                }
+                update_remaining_seats(train_status->segment_pointer, order.from_station_serial,
+                                       order.to_station_serial, -order.count);
             }
         }
 
@@ -305,11 +354,7 @@ namespace ticket {
                 throw std::runtime_error("Train status not found."); // this should not happen
             }
             const auto segment_pointer = train_status->segment_pointer;
-            for (int i = order.from_station_serial; i < order.to_station_serial; ++i) {
-                auto segment = train_fare_segments.get(segment_pointer, i);
-                segment.remaining_seats += order.count;
-                train_fare_segments.set(segment_pointer, i, segment);
-            }
+            update_remaining_seats(segment_pointer, order.from_station_serial, order.to_station_serial, order.count);
             // look for pending orders that can now be verified
             auto pending_orders = pending_order_store.find_all_in_range(
                 norb::unpack_range(order.train_id, norb::Range<Order::timestamp_t>::full_range()));
@@ -326,24 +371,45 @@ namespace ticket {
                     pending_order.status = Order::Status::Success;
                     purchase_history_store.insert(pending_order_id, pending_order);
                     // update the number of remaining seats
-                    for (int i = pending_order.from_station_serial; i < pending_order.to_station_serial; ++i) {
-                        auto segment = train_fare_segments.get(segment_pointer, i);
-                        assert(segment.remaining_seats >= pending_order.count && "Not enough seats available");
-                        segment.remaining_seats -= pending_order.count;
-                        train_fare_segments.set(segment_pointer, i, segment);
-                    }
+                    update_remaining_seats(segment_pointer, pending_order.from_station_serial,
+                                           pending_order.to_station_serial, -pending_order.count);
                     interface::log.as(LogLevel::DEBUG)
                         << "Pending order " << pending_order_id << " has been successfully processed.\n";
                 }
             }
         }
 
+        // Rebuilds the named store at the given fill factor. Returns std::nullopt if no store has that name.
+        std::optional<norb::TreeRebuildReport> rebuild_tree(const std::string &tree_name, const float &fill_factor) {
+            if (tree_name == "purchase_history")
+                return purchase_history_store.rebuild(fill_factor);
+            if (tree_name == "pending_order")
+                return pending_order_store.rebuild(fill_factor);
+            if (tree_name == "train_fare")
+                return train_fare_store.rebuild(fill_factor);
+            return std::nullopt;
+        }
+
+        // rewrites the fares and seats of every train contiguously, in train id order
+        norb::SegmentCompactionReport compact_segments() {
+            train_fare_segments.begin_compaction();
+            train_fare_store.modify_all_do([this](TrainFare &train_fare) {
+                train_fare.segment_pointer = train_fare_segments.relocate(train_fare.segment_pointer);
+            });
+            return train_fare_segments.end_compaction();
+        }
+
+        // Reloads what is kept in memory, after the pages changed under the manager.
+        void reload() {
+            train_fare_segments.reload();
+        }
+
         void clear() {
             purchase_history_store.clear();
             pending_order_store.clear();
             train_fare_store.clear();
             temporary_train_group_info_store.clear();
-            // train_fare_segments = norb::FiledSegmentList<TrainFareSegment>(train_fare_segments_name);
+            train_fare_segments.clear();
             interface::log.as(LogLevel::DEBUG) << "TicketManager cleared.\n";
         }
     };
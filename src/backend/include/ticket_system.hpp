@@ -1,6 +1,7 @@
 #pragma once
 
 #include "account_manager.hpp"
+#include "route_planner.hpp"
 #include "settings.hpp"
 #include "sorted_view.hpp"
 #include "ticket_manager.hpp"
@@ -28,56 +29,46 @@ namespace ticket {
         AccountManager account_manager_;
         TrainManager train_manager_;
         TicketManager ticket_manager_;
+        RoutePlanner route_planner_{train_manager_};
 
         using LogLevel = norb::LogLevel;
         using account_id_t = Account::id_t;
         using Date = norb::Datetime::Date;
         using interface = global_interface;
         using station_id_t = TrainManager::station_id_t;
+        using station_ordinal_t = TrainManager::station_ordinal_t;
 
 #ifndef NDEBUG
         inline static std::map<train_group_id_t, std::string> db_train_group_lookup;
         inline static std::map<station_id_t, std::string> db_station_lookup;
 #endif
 
-        // when the first train is fixed, we ought to compare the time of arrival
-        static std::optional<TrainRideInfo>
-        find_best_between(const station_id_t &from_id, const station_id_t &to_id, const Datetime &datetime,
-                          const std::string &sort_by, const std::optional<train_group_id_t> &except = std::nullopt) {
-            auto &ticket_manager = get_instance().ticket_manager_;
-            auto &train_manager = get_instance().train_manager_;
-
-            if (from_id == to_id) {
-                return std::nullopt;
-            }
-            // find all trains that leave at from at date and arrive in to
-            const auto &train_query_result = train_manager.query_ticket(from_id, to_id, datetime, except);
-            if (train_query_result.empty())
-                return std::nullopt;
-            // from ticket_manager retrieve the financial information
-            norb::vector<TrainFareSegment> financial_info;
-            norb::vector<int> duration;
-            for (const auto &train_item : train_query_result) {
-                financial_info.push_back(ticket_manager.get_price_seat_for_section(
-                    train_item.train_id, train_item.from_station_serial, train_item.to_station_serial));
-                duration.push_back((train_item.to_time.to_minutes()));
+        static norb::vector<TicketManager::SectionQuery> sections_of(const norb::vector<TrainManager::TrainRange> &trains) {
+            norb::vector<TicketManager::SectionQuery> sections;
+            for (const auto &train_item : trains) {
+                sections.push_back({train_item.train_id, train_item.from_station_serial, train_item.to_station_serial});
             }
-            int best_cursor = -1;
-            const int train_count = train_query_result.size();
-            if (sort_by == "cost") {
-                best_cursor = norb::make_supreme(train_count, [&financial_info](const int &a, const int &b) {
-                    return financial_info[a].price < financial_info[b].price;
-                });
-            } else { // sort by time
-                best_cursor = norb::make_supreme(
-                    train_count, [&duration](const int &a, const int &b) { return duration[a] < duration[b]; });
-            }
-            return best_cursor == -1
-                       ? std::nullopt
-                       : std::make_optional<TrainRideInfo>(
-                             {train_query_result[best_cursor].train_id, from_id, to_id,
-                              train_query_result[best_cursor].from_time, train_query_result[best_cursor].to_time,
-                              financial_info[best_cursor].price, financial_info[best_cursor].remaining_seats});
+            return sections;
+        }
+
+        // Prints the two trains of a transfer, a line each, the first of them onto first_line
+        static void print_transfer(std::ostream &first_line, const RoutePlanner::Transfer &transfer,
+                                   const std::string &from, const std::string &to) {
+            auto &train_manager = get_instance().train_manager_;
+            auto &ticket_manager = get_instance().ticket_manager_;
+            const auto &[first_train, second_train, mid_station, first_train_name, second_train_name] = transfer;
+            const auto first_seats = ticket_manager.get_price_seat_for_section(
+                first_train.train_id, first_train.from_station_serial, first_train.to_station_serial);
+            const auto second_seats = ticket_manager.get_price_seat_for_section(
+                second_train.train_id, second_train.from_station_serial, second_train.to_station_serial);
+            const auto mid_station_name =
+                train_manager.station_name_from_id(train_manager.station_id_vector[mid_station]).value();
+            first_line << first_train_name << ' ' << from << ' ' << first_train.from_time << ' ' << "-> "
+                       << mid_station_name << ' ' << first_train.to_time << ' ' << first_train.price << ' '
+                       << first_seats.remaining_seats << '\n';
+            interface::out.as(nullptr) << second_train_name << ' ' << mid_station_name << ' ' << second_train.from_time
+                                       << ' ' << "-> " << to << ' ' << second_train.to_time << ' ' << second_train.price
+                                       << ' ' << second_seats.remaining_seats << '\n';
         }
 
       public:
@@ -278,7 +269,7 @@ namespace ticket {
                     global_interface::log.as(LogLevel::DEBUG)
                         << "Adding segment for station " << decoded_station_names[i] << ": " << "arrival at "
                         << arrival_time << ", departure at " << departure_time << '\n';
-                    train_manager.register_station(decoded_station_names[i]);
+                    const auto station_ordinal = train_manager.register_station(decoded_station_names[i]);
                     const auto station_id = TrainManager::station_id_from_name(decoded_station_names[i]);
 #ifndef NDEBUG
                     if (not db_station_lookup.contains(station_id)) {
@@ -286,8 +277,8 @@ namespace ticket {
                     }
 #endif
                     segments.emplace_back(station_id, arrival_time, departure_time,
-                                          i < station_num - 1 ? decoded_prices[i] : 0 // Last station has no price
-                    );
+                                          i < station_num - 1 ? decoded_prices[i] : 0, // Last station has no price
+                                          station_ordinal);
                 }
                 // register into the train manager
                 const auto decoded_sale_date = sale_date.as_vector();
@@ -336,6 +327,7 @@ namespace ticket {
                     << "Releasing train group " << train_group_name << " with ID #" << train_group_id << '\n';
                 train_manager.release_train_group(train_group_id);
                 ticket_manager.release_train_group(train_group_id);
+                get_instance().route_planner_.add_released_train(*train_manager.get_timetable(train_group_id));
                 return 0;
             } catch (std::runtime_error &e) {
                 global_interface::log.as(LogLevel::WARNING) << "Release train failed: " << e.what() << '\n';
@@ -348,24 +340,25 @@ namespace ticket {
             auto &ticket_manager = get_instance().ticket_manager_;
 
             const auto train_group_id = TrainManager::train_group_id_from_name(train_group_name);
-            const auto train_group_info = train_manager.get_train_group(train_group_id);
+            const auto *timetable = train_manager.get_timetable(train_group_id);
 
-            if (not train_group_info.has_value()) {
+            if (timetable == nullptr) {
                 interface::log.as(LogLevel::WARNING)
                     << "Query train failed: train group " << train_group_name << " does not exist" << '\n';
                 interface::out.as() << "-1\n";
                 return;
             }
-            if (not train_group_info->sale_date_range.contains(date)) {
+            const auto &train_group_info = timetable->train_group;
+            if (not train_group_info.sale_date_range.contains(date)) {
                 interface::log.as(LogLevel::WARNING) << "Query train failed: train group " << train_group_name
                                                      << " is not available on " << date << '\n';
                 interface::out.as() << "-1\n";
                 return;
             }
-            interface::out.as() << train_group_info->train_group_name << ' ' << train_group_info->train_type << '\n';
+            interface::out.as() << train_group_info.train_group_name << ' ' << train_group_info.train_type << '\n';
 
             const auto train_id = train_id_t{train_group_id, date};
-            const auto &train_group_segment_pointer = train_group_info->segment_pointer;
+            const int station_count = timetable->station_count;
             int accumulated_price = 0;
             const auto has_released = train_manager.has_released_train_group(train_group_id);
             interface::log.as(LogLevel::INFO) << "Train group " << train_group_name << " has "
@@ -376,32 +369,28 @@ namespace ticket {
                 interface::log.as(LogLevel::DEBUG)
                     << "Queried remaining seats for train " << train_id << ": " << seats_info << '\n';
             }
-            for (int i = 0; i < train_group_segment_pointer.size; ++i) {
-                const auto &train_group_segment = train_manager.get_train_group_segment(train_group_segment_pointer, i);
-                // const auto &ticket_segment = ticket_manager.get_train_status_station_segment(
-                //     train_segment_pointer, std::min(i, train_group_segment_pointer.size - 2));
-
+            for (int i = 0; i < station_count; ++i) {
                 // print on the same line
                 interface::out.as(nullptr)
-                    << train_manager.station_name_from_id(train_group_segment.station_id).value() << ' ';
+                    << train_manager.station_name_from_id(timetable->station_ids[i]).value() << ' ';
                 // arrival time
                 if (i == 0) {
                     interface::out.as(nullptr) << datetime_placeholder << ' ';
                 } else {
-                    interface::out.as(nullptr) << (Datetime(date) + train_group_segment.arrival_time) << ' ';
+                    interface::out.as(nullptr) << (Datetime(date) + timetable->arrival_times[i]) << ' ';
                 }
                 interface::out.as(nullptr) << "-> ";
                 // departure time
-                if (i == train_group_segment_pointer.size - 1) {
+                if (i == station_count - 1) {
                     interface::out.as(nullptr) << datetime_placeholder << ' ';
                 } else {
-                    interface::out.as(nullptr) << (Datetime(date) + train_group_segment.departure_time) << ' ';
+                    interface::out.as(nullptr) << (Datetime(date) + timetable->departure_times[i]) << ' ';
                 }
                 // accumulated price + tickets left
                 interface::out.as(nullptr) << accumulated_price << ' ';
-                if (i < train_group_segment_pointer.size - 1) {
-                    interface::out.as(nullptr) << (has_released ? seats_info[i] : train_group_info->seat_num) << '\n';
-                    accumulated_price += train_group_segment.price;
+                if (i < station_count - 1) {
+                    interface::out.as(nullptr) << (has_released ? seats_info[i] : train_group_info.seat_num) << '\n';
+                    accumulated_price += timetable->prices[i];
                 } else {
                     interface::out.as(nullptr) << 'x' << '\n';
                 }
@@ -428,13 +417,9 @@ namespace ticket {
 
             TrainRideInfo(const TrainRange &tr, TrainManager &train_man, TicketManager &ticket_man) {
                 train_id = tr.train_id;
-                const auto train_group_info = train_man.get_train_group(tr.train_id.first);
-                const auto from_train_group_seg =
-                    train_man.get_train_group_segment(train_group_info->segment_pointer, tr.from_station_serial);
-                const auto to_train_group_seg =
-                    train_man.get_train_group_segment(train_group_info->segment_pointer, tr.to_station_serial);
-                from_station_id = from_train_group_seg.station_id;
-                to_station_id = to_train_group_seg.station_id;
+                const auto *timetable = train_man.get_timetable(tr.train_id.first);
+                from_station_id = timetable->station_ids[tr.from_station_serial];
+                to_station_id = timetable->station_ids[tr.to_station_serial];
                 from_time = tr.from_time;
                 to_time = tr.to_time;
                 const auto train_fare_segment =
@@ -444,25 +429,23 @@ namespace ticket {
             }
         };
 
-        static norb::vector<TrainRideInfo> query_ticket(const station_id_t &from_id, const station_id_t &to_id,
+        static norb::vector<TrainRideInfo> query_ticket(const station_ordinal_t &from, const station_ordinal_t &to,
                                                         const Date &date, const std::string &sort_by) {
             auto &ticket_manager = get_instance().ticket_manager_;
             auto &train_manager = get_instance().train_manager_;
 
-            if (from_id == to_id) {
+            if (from == to) {
                 interface::log.as(LogLevel::WARNING)
                     << "Query ticket failed: from and to stations are the same" << '\n';
                 return {};
             }
             // find all trains that leave at from at date and arrive in to
-            const auto &train_query_result = train_manager.query_ticket(from_id, to_id, Datetime(date), std::nullopt, true);
+            const auto &train_query_result = train_manager.query_ticket(from, to, Datetime(date), std::nullopt, true);
             // from ticket_manager retrieve the financial information
-            norb::vector<TrainFareSegment> financial_info;
+            const auto financial_info = ticket_manager.get_price_seat_for_sections(sections_of(train_query_result));
             norb::vector<std::string> train_names;
             norb::vector<Datetime> duration;
             for (const auto &train_item : train_query_result) {
-                financial_info.push_back(ticket_manager.get_price_seat_for_section(
-                    train_item.train_id, train_item.from_station_serial, train_item.to_station_serial));
                 duration.push_back((train_item.to_time - train_item.from_time));
                 train_names.push_back(train_manager.train_name_from_id(train_item.train_id.first).value());
             }
@@ -482,6 +465,8 @@ namespace ticket {
                         return train_names[a] < train_names[b];
                     });
             }
+            const auto from_id = train_manager.station_id_vector[from];
+            const auto to_id = train_manager.station_id_vector[to];
             norb::vector<TrainRideInfo> ret;
             // sort according to the sort_by parameter
             for (const auto &i : sorted_indices) {
@@ -497,10 +482,15 @@ namespace ticket {
                                            const std::string &sort_by) {
             auto &train_manager = get_instance().train_manager_;
 
-            const auto from_id = TrainManager::station_id_from_name(from);
-            const auto to_id = TrainManager::station_id_from_name(to);
+            const auto from_station = train_manager.station_ordinal_from_id(TrainManager::station_id_from_name(from));
+            const auto to_station = train_manager.station_ordinal_from_id(TrainManager::station_id_from_name(to));
+            if (not from_station.has_value() or not to_station.has_value()) {
+                // no train has ever stopped there
+                interface::out.as() << "0\n";
+                return;
+            }
 
-            const auto query_ans = query_ticket(from_id, to_id, date, sort_by);
+            const auto query_ans = query_ticket(from_station.value(), to_station.value(), date, sort_by);
             interface::out.as() << query_ans.size() << '\n';
             for (const auto &item : query_ans) {
                 const auto train_name = train_manager.get_train_group(item.train_id.first)->train_group_name;
@@ -510,6 +500,8 @@ namespace ticket {
             }
         }
 
+        // With sort_by "pareto", prints the number of transfers no other is both as fast and as cheap as, and then
+        // each of them by total time, rather than the best by time or cost
         static void query_transfer_and_print(const std::string &from, const std::string &to, const Date &date,
                                              const std::string &sort_by) {
             auto &train_manager = get_instance().train_manager_;
@@ -522,87 +514,76 @@ namespace ticket {
                 interface::out.as() << "-1\n";
                 return;
             }
-            // iterate over the cities for mid and calculate the best trade between (from -> mid) and (mid -> to)
-            using obj_t = std::pair<TrainRideInfo, TrainRideInfo>;
-            norb::impl::cmp_func_t<obj_t> cmp_func;
-            if (sort_by == "time") {
-                cmp_func = [&train_manager](const obj_t &a, const obj_t &b) {
-                    if (a.second.to_time - a.first.from_time != b.second.to_time - b.first.from_time) {
-                        return a.second.to_time - a.first.from_time < b.second.to_time - b.first.from_time;
-                    }
-                    if (a.first.price + a.second.price != b.first.price + b.second.price) {
-                        return a.first.price + a.second.price < b.first.price + b.second.price;
-                    }
-                    if (a.first.train_id != b.first.train_id) {
-                        return train_manager.get_train_group(a.first.train_id.first)->train_group_name <
-                               train_manager.get_train_group(b.first.train_id.first)->train_group_name;
-                    } else {
-                        return train_manager.get_train_group(a.second.train_id.first)->train_group_name <
-                               train_manager.get_train_group(b.second.train_id.first)->train_group_name;
-                    }
-                };
-            } else { // sort by cost
-                cmp_func = [&train_manager](const obj_t &a, const obj_t &b) {
-                    if (a.first.price + a.second.price != b.first.price + b.second.price) {
-                        return a.first.price + a.second.price < b.first.price + b.second.price;
-                    }
-                    if (a.second.to_time - a.first.from_time != b.second.to_time - b.first.from_time) {
-                        return a.second.to_time - a.first.from_time < b.second.to_time - b.first.from_time;
-                    }
-                    if (a.first.train_id != b.first.train_id) {
-                        return train_manager.get_train_group(a.first.train_id.first)->train_group_name <
-                               train_manager.get_train_group(b.first.train_id.first)->train_group_name;
-                    } else {
-                        return train_manager.get_train_group(a.second.train_id.first)->train_group_name <
-                               train_manager.get_train_group(b.second.train_id.first)->train_group_name;
-                    }
-                };
-            }
-            norb::SupremeKeep<obj_t> best_transfer(cmp_func);
-            for (const auto &mid_id : train_manager.station_id_vector) {
-                // // todo remember to delete
-                // const auto mid_station_name = train_manager.station_name_from_id(mid_id);
-                // interface::log.as(LogLevel::DEBUG) << "Considering middle station: #" << mid_station_name.value() << '\n';
-                const auto list_from_mid = query_ticket(from_id, mid_id, date, sort_by);
-                interface::log.as(LogLevel::DEBUG) << "From to Mid containing " << list_from_mid.size() << " trains" << '\n';
-                for (const auto &from_mid_train : list_from_mid) {
-                    // // todo remember to delete
-                    // const auto from_mid_train_group_info = train_manager.get_train_group(from_mid_train.train_id.first);
-
-                    const auto datetime_at_arrival = from_mid_train.to_time;
-                    const auto best_mid_to =
-                        find_best_between(mid_id, to_id, datetime_at_arrival, sort_by, from_mid_train.train_id.first);
-                    // // todo remember to delete
-                    // const auto mid_to_train_group_info = train_manager.get_train_group(from_mid_train.train_id.first);
-
-                    if (not best_mid_to.has_value()) {
-                        continue; // skip if no valid train found
-                    }
-                    best_transfer.add(std::make_pair(from_mid_train, best_mid_to.value()));
-                }
-                // best_transfer.add(std::make_pair(best_from_mid.value(), best_mid_to.value()));
+            const auto from_station = train_manager.station_ordinal_from_id(from_id);
+            const auto to_station = train_manager.station_ordinal_from_id(to_id);
+            if (not from_station.has_value() or not to_station.has_value()) {
+                interface::log.as(LogLevel::WARNING)
+                    << "Query transfer failed: no valid transfer found from " << from << " to " << to << '\n';
+                interface::out.as() << "0\n";
+                return;
             }
-
-            if (not best_transfer.val.has_value()) {
+            if (sort_by == "pareto") {
+                const auto transfers =
+                    get_instance().route_planner_.pareto_transfers(from_station.value(), to_station.value(), date);
+                interface::out.as() << transfers.size() << '\n';
+                for (const auto &transfer : transfers)
+                    print_transfer(interface::out.as(nullptr), transfer, from, to);
+                return;
+            }
+            const auto transfer = get_instance().route_planner_.best_transfer(from_station.value(), to_station.value(),
+                                                                              date, sort_by);
+            if (not transfer.has_value()) {
                 interface::log.as(LogLevel::WARNING)
                     << "Query transfer failed: no valid transfer found from " << from << " to " << to << '\n';
                 interface::out.as() << "0\n";
                 return;
-            } else {
-                const auto [first_train, second_train] = best_transfer.val.value();
-                const auto first_train_name =
-                    train_manager.get_train_group(first_train.train_id.first)->train_group_name;
-                const auto second_train_name =
-                    train_manager.get_train_group(second_train.train_id.first)->train_group_name;
-                const auto mid_station_name = train_manager.station_name_from_id(first_train.to_station_id).value();
-                interface::out.as() << first_train_name << ' ' << from << ' ' << first_train.from_time << ' ' << "-> "
-                                    << mid_station_name << ' ' << first_train.to_time << ' ' << first_train.price << ' '
-                                    << first_train.remaining_seats << '\n';
-                interface::out.as(nullptr) << second_train_name << ' ' << mid_station_name << ' ' << second_train.from_time
-                                    << ' ' << "-> " << to << ' ' << second_train.to_time << ' ' << second_train.price
-                                    << ' ' << second_train.remaining_seats << '\n';
+            }
+            print_transfer(interface::out.as(), transfer.value(), from, to);
+        }
+
+        // Prints the number of journeys and then each of them, as the number of its trains followed by a line per
+        // train in the form of query_transfer, fewest trains first. As query_transfer, prints -1 if from and to are
+        // the same station, and 0 if either is not on any train; it also prints -1 for a negative max_transfers
+        static void query_route_and_print(const std::string &from, const std::string &to, const Date &date,
+                                          const int &max_transfers) {
+            auto &train_manager = get_instance().train_manager_;
+            auto &ticket_manager = get_instance().ticket_manager_;
+
+            if (max_transfers < 0) {
+                interface::log.as(LogLevel::WARNING) << "Query route failed: negative number of transfers" << '\n';
+                interface::out.as() << "-1\n";
+                return;
+            }
+            const auto from_id = TrainManager::station_id_from_name(from);
+            const auto to_id = TrainManager::station_id_from_name(to);
+            if (from_id == to_id) {
+                interface::log.as(LogLevel::WARNING) << "Query route failed: from and to stations are the same" << '\n';
+                interface::out.as() << "-1\n";
+                return;
+            }
+            const auto from_station = train_manager.station_ordinal_from_id(from_id);
+            const auto to_station = train_manager.station_ordinal_from_id(to_id);
+            if (not from_station.has_value() or not to_station.has_value()) {
+                interface::out.as() << "0\n";
                 return;
             }
+            const auto routes = get_instance().route_planner_.pareto_routes(from_station.value(), to_station.value(),
+                                                                            date, max_transfers);
+            interface::out.as() << routes.size() << '\n';
+            for (const auto &route : routes) {
+                interface::out.as(nullptr) << route.size() << '\n';
+                for (const auto &leg : route) {
+                    const auto &timetable = *train_manager.get_timetable(leg.train_id.first);
+                    const auto seats = ticket_manager.get_price_seat_for_section(leg.train_id, leg.from_station_serial,
+                                                                                 leg.to_station_serial);
+                    interface::out.as(nullptr)
+                        << timetable.train_group.train_group_name << ' '
+                        << train_manager.station_name_from_id(timetable.station_ids[leg.from_station_serial]).value()
+                        << ' ' << leg.from_time << ' ' << "-> "
+                        << train_manager.station_name_from_id(timetable.station_ids[leg.to_station_serial]).value()
+                        << ' ' << leg.to_time << ' ' << leg.price << ' ' << seats.remaining_seats << '\n';
+                }
+            }
         }
 
         static std::variant<int, std::string> buy_ticket(const std::string &username,
@@ -634,18 +615,16 @@ namespace ticket {
                     << " from station " << from_station_name << '\n';
                 return -1;
             }
-            const auto train_group_info = train_manager.get_train_group(train_group_id);
-            const auto from_station_serial =
-                train_manager.get_station_serial_from_id(train_group_info.value(), from_station_id);
-            const auto to_station_serial =
-                train_manager.get_station_serial_from_id(train_group_info.value(), to_station_id);
+            const auto &timetable = *train_manager.get_timetable(train_group_id);
+            const auto from_station_serial = timetable.station_serial(from_station_id);
+            const auto to_station_serial = timetable.station_serial(to_station_id);
             if (not to_station_serial.has_value()) {
                 global_interface::log.as(LogLevel::WARNING)
                     << "Buy ticket failed: train group " << train_group_name << " does not have a train to station #"
                     << to_station_name << '\n';
                 return -1;
             }
-            if (train_group_info->seat_num < count) {
+            if (timetable.train_group.seat_num < count) {
                 global_interface::log.as(LogLevel::WARNING)
                     << "Buy ticket failed: requested more tickets than train group " << train_group_name << " has seats";
                 return -1;
@@ -672,8 +651,8 @@ namespace ticket {
                                                    .train_id = train_id.value(),
                                                    .from_station_serial = from_station_serial.value(),
                                                    .to_station_serial = to_station_serial.value(),
-                                                   .from_time = train_manager.get_departure_datetime(train_group_info.value(), from_station_serial.value(), train_id->second),
-                                                   .to_time = train_manager.get_arrival_datetime(train_group_info.value(), to_station_serial.value(), train_id->second),
+                                                   .from_time = TrainManager::get_departure_datetime(timetable, from_station_serial.value(), train_id->second),
+                                                   .to_time = TrainManager::get_arrival_datetime(timetable, to_station_serial.value(), train_id->second),
                                                    .purchase_timestamp = interface::get_timestamp(),
                                                    .count = count,
                                                    .price = price,
@@ -687,8 +666,8 @@ namespace ticket {
                                                .train_id = train_id.value(),
                                                .from_station_serial = from_station_serial.value(),
                                                .to_station_serial = to_station_serial.value(),
-                                               .from_time = train_manager.get_departure_datetime(train_group_info.value(), from_station_serial.value(), train_id->second),
-                                               .to_time = train_manager.get_arrival_datetime(train_group_info.value(), to_station_serial.value(), train_id->second),
+                                               .from_time = TrainManager::get_departure_datetime(timetable, from_station_serial.value(), train_id->second),
+                                               .to_time = TrainManager::get_arrival_datetime(timetable, to_station_serial.value(), train_id->second),
                                                .purchase_timestamp = interface::get_timestamp(),
                                                .count = count,
                                                .price = price,
@@ -721,22 +700,21 @@ namespace ticket {
             // therefore, we should output them in reversed order
             for (int i = static_cast<int>(orders.size()) - 1; i >= 0; --i) {
                 const auto &order = orders[i];
-                const auto &train_group_info = train_manager.get_train_group(order.train_id.first);
-                const auto &from_station_name = train_manager.station_name_from_id(
-                    train_manager.get_train_group_segment(train_group_info->segment_pointer, order.from_station_serial).station_id
-                );
-                const auto &to_station_name = train_manager.station_name_from_id(
-                    train_manager.get_train_group_segment(train_group_info->segment_pointer, order.to_station_serial).station_id
-                );
+                const auto *timetable = train_manager.get_timetable(order.train_id.first);
+                const auto &train_group_info = timetable->train_group;
+                const auto &from_station_name =
+                    train_manager.station_name_from_id(timetable->station_ids[order.from_station_serial]);
+                const auto &to_station_name =
+                    train_manager.station_name_from_id(timetable->station_ids[order.to_station_serial]);
                 interface::out.as(nullptr)  << '[' << order.status_string() << "] "
-                                            << train_group_info->train_group_name << ' '
+                                            << train_group_info.train_group_name << ' '
                                             << from_station_name.value() << ' '
                                             << order.from_time << " -> "
                                             << to_station_name.value() << ' '
                                             << order.to_time << ' '
                                             << order.price << ' '
                                             << order.count << '\n';
-                interface::log.as(LogLevel::DEBUG) << train_group_info->train_group_name << " registered at " << order.id() << '\n';
+                interface::log.as(LogLevel::DEBUG) << train_group_info.train_group_name << " registered at " << order.id() << '\n';
                 interface::log.as(LogLevel::DEBUG) << "From station " << from_station_name.value() << " to " << to_station_name.value() << " at " << order.from_time << '\n';
                 interface::log.as(LogLevel::DEBUG) << "Train ID: " << order.train_id << '\n';
                 interface::log.as(LogLevel::DEBUG) << "From #" << order.from_station_serial << " to #" << order.to_station_serial << '\n';
@@ -776,6 +754,56 @@ namespace ticket {
             }
         }
 
+        // Rebuilds one B+ tree into contiguous pages, reporting the pages and height before and after.
+        static std::variant<int, std::string> compact_tree(const std::string &tree_name, const int &fill_percent) {
+            if (fill_percent <= 0 or fill_percent > 100) {
+                interface::log.as(LogLevel::WARNING)
+                    << "Compact tree failed: fill factor " << fill_percent << "% is out of range" << '\n';
+                return -1;
+            }
+            const float fill_factor = static_cast<float>(fill_percent) / 100;
+            auto report = get_instance().account_manager_.rebuild_tree(tree_name, fill_factor);
+            if (not report.has_value())
+                report = get_instance().train_manager_.rebuild_tree(tree_name, fill_factor);
+            if (not report.has_value())
+                report = get_instance().ticket_manager_.rebuild_tree(tree_name, fill_factor);
+            if (not report.has_value()) {
+                interface::log.as(LogLevel::WARNING) << "Compact tree failed: no tree named " << tree_name << '\n';
+                return -1;
+            }
+            interface::log.as(LogLevel::INFO) << "Tree " << tree_name << " has been rebuilt" << '\n';
+            return "pages " + std::to_string(report->pages_before) + " -> " + std::to_string(report->pages_after) +
+                   " height " + std::to_string(report->height_before) + " -> " + std::to_string(report->height_after);
+        }
+
+        static std::string compact_segments() {
+            const auto train_group_report = get_instance().train_manager_.compact_segments();
+            const auto train_fare_report = get_instance().ticket_manager_.compact_segments();
+            interface::log.as(LogLevel::INFO) << "Segment lists have been compacted" << '\n';
+            return "train_group pages " + std::to_string(train_group_report.pages_before) + " -> " +
+                   std::to_string(train_group_report.pages_after) + " train_fare pages " +
+                   std::to_string(train_fare_report.pages_before) + " -> " +
+                   std::to_string(train_fare_report.pages_after);
+        }
+
+        // Counters kept while running, for tuning
+        static std::string debug_stats() {
+            const auto &train_manager = get_instance().train_manager_;
+            const auto &route_planner = get_instance().route_planner_;
+            const auto cache_stats = [](const std::string &name, const size_t &hits, const size_t &misses) {
+                const auto lookups = hits + misses;
+                return name + " hits " + std::to_string(hits) + " of " + std::to_string(lookups) + " hit_rate " +
+                       std::to_string(lookups == 0 ? 0 : hits * 100 / lookups) + "%";
+            };
+            return cache_stats("train_cache", train_manager.timetable_cache_hits(),
+                               train_manager.timetable_cache_misses()) +
+                   " " +
+                   cache_stats("reachable_cache", route_planner.reachable_cache_hits(),
+                               route_planner.reachable_cache_misses()) +
+                   " transfer_pruned " + std::to_string(route_planner.pruned_transfers()) + " of " +
+                   std::to_string(route_planner.pruned_transfers() + route_planner.tried_transfers());
+        }
+
         static int clean() {
             auto &train_manager = get_instance().train_manager_;
             auto &ticket_manager = get_instance().ticket_manager_;
@@ -791,5 +819,50 @@ namespace ticket {
 
             return 0;
         }
+
+        // Keeps the current state of the whole system under a name. Pages are shared with the snapshot and only
+        // copied when written, so a snapshot costs a page and grows with the changes made after it.
+        static int snapshot_create(const std::string &snapshot_id) {
+            try {
+                norb::PersistentMemory::snapshot_create(snapshot_id);
+            } catch (const std::invalid_argument &e) {
+                interface::log.as(LogLevel::WARNING) << "Create snapshot failed: " << e.what() << '\n';
+                return -1;
+            } catch (const std::length_error &e) {
+                interface::log.as(LogLevel::WARNING) << "Create snapshot failed: " << e.what() << '\n';
+                return -1;
+            }
+            interface::log.as(LogLevel::INFO) << "Snapshot " << snapshot_id << " has been created" << '\n';
+            return 0;
+        }
+
+        // Brings the whole system back to a snapshot, which is kept. Every user is logged out.
+        static int snapshot_restore(const std::string &snapshot_id) {
+            try {
+                norb::PersistentMemory::snapshot_restore(snapshot_id);
+            } catch (const std::invalid_argument &e) {
+                interface::log.as(LogLevel::WARNING) << "Restore snapshot failed: " << e.what() << '\n';
+                return -1;
+            } catch (const std::length_error &e) {
+                interface::log.as(LogLevel::WARNING) << "Restore snapshot failed: " << e.what() << '\n';
+                return -1;
+            }
+            get_instance().train_manager_.reload();
+            get_instance().ticket_manager_.reload();
+            get_instance().account_manager_.reload();
+            interface::log.as(LogLevel::INFO) << "Snapshot " << snapshot_id << " has been restored" << '\n';
+            return 0;
+        }
+
+        static int snapshot_delete(const std::string &snapshot_id) {
+            try {
+                norb::PersistentMemory::snapshot_delete(snapshot_id);
+            } catch (const std::invalid_argument &e) {
+                interface::log.as(LogLevel::WARNING) << "Delete snapshot failed: " << e.what() << '\n';
+                return -1;
+            }
+            interface::log.as(LogLevel::INFO) << "Snapshot " << snapshot_id << " has been deleted" << '\n';
+            return 0;
+        }
     };
 } // namespace ticket
\ No newline at end of file
@@ -4,8 +4,9 @@
 
 #include "b_plus_tree.hpp"
 #include "datetime.hpp"
-#include "stlite/persistent_vector.hpp"
+#include "stlite/paged_segment_list.hpp"
 #include "stlite/fixed_string.hpp"
+#include "stlite/lru_cache.hpp"
 #include "stlite/pair.hpp"
 #include "stlite/range.hpp"
 
@@ -20,16 +21,19 @@ namespace ticket {
 
     struct TrainGroupSegment {
         using station_id_t = hash_t;
+        using station_ordinal_t = uint32_t;
         using price_t = int;
 
         station_id_t station_id = 0;
         DeltaDatetime arrival_time;
         DeltaDatetime departure_time;
         price_t price = 0;
+        // the dense number of the station, see TrainManager::register_station
+        station_ordinal_t station_ordinal = 0;
     };
 
     struct TrainGroup {
-        using SegmentList = norb::FiledSegmentList<TrainGroupSegment>;
+        using SegmentList = norb::PagedSegmentList<TrainGroupSegment>;
         using train_group_name_t = norb::FixedUTF8String<max_train_id_length>;
         using train_group_id_t = hash_t;
         using seat_num_t = int;
@@ -59,13 +63,19 @@ namespace ticket {
         using train_group_id_t = TrainGroup::train_group_id_t;
         using station_name_t = norb::FixedUTF8String<max_station_name_characters * max_bytes_per_chinese_char>;
         using station_id_t = hash_t;
+        using station_ordinal_t = TrainGroupSegment::station_ordinal_t;
         using interface = global_interface;
         using LogLevel = norb::LogLevel;
 
+        // A train group between two of its stations, with its timetable there so that queries need not fetch it
         struct StationLookupStruct {
             train_group_id_t train_group_id = 0;
             int station_from_serial = 0;
             int station_to_serial = 0;
+            // counted from the first departure of the train
+            DeltaDatetime departure_time;
+            DeltaDatetime arrival_time;
+            norb::Range<Date> sale_date_range;
 
             using id_t = train_group_id_t;
             [[nodiscard]] id_t id() const {
@@ -73,21 +83,196 @@ namespace ticket {
             }
         };
 
+        // A train group at one of its stations, with its timetable there
+        struct StationStopStruct {
+            int station_serial = 0;
+            DeltaDatetime arrival_time;
+            DeltaDatetime departure_time;
+            norb::Range<Date> sale_date_range;
+        };
+
+        // A train group decoded from its record and its segments, as kept in the train cache
+        struct TrainTimetable {
+            TrainGroup train_group;
+            int station_count = 0;
+            station_id_t station_ids[max_station_num] = {};
+            station_ordinal_t station_ordinals[max_station_num] = {};
+            DeltaDatetime arrival_times[max_station_num];
+            DeltaDatetime departure_times[max_station_num];
+            TrainGroupSegment::price_t prices[max_station_num] = {};
+
+            [[nodiscard]] std::optional<int> station_serial(const station_id_t &station_id) const {
+                for (int i = 0; i < station_count; ++i)
+                    if (station_ids[i] == station_id)
+                        return i;
+                return std::nullopt;
+            }
+        };
+
       private:
-        using SegmentList = norb::FiledSegmentList<TrainGroupSegment>;
+        using SegmentList = norb::PagedSegmentList<TrainGroupSegment>;
         using TrainGroupSegmentPointer = SegmentList::SegmentPointer;
-        norb::BPlusTree<train_group_id_t, TrainGroup, norb::MANUAL> train_group_store;
-        norb::BPlusTree<train_group_id_t, bool, norb::MANUAL> train_group_release_store;
-        norb::BPlusTree<station_id_t, station_name_t, norb::MANUAL> station_name_store;
-        // this lookup table keeps track of all RELEASED stores
-        // format:
-        norb::BPlusTree<norb::Pair<station_id_t, station_id_t>, StationLookupStruct, norb::AUTOMATIC>
-            station_train_group_lookup_store;
-        SegmentList train_group_segments;
+        norb::BPlusTree<train_group_id_t, TrainGroup, norb::MANUAL> train_group_store{"train_group_store"};
+        norb::BPlusTree<train_group_id_t, bool, norb::MANUAL> train_group_release_store{"train_group_release_store"};
+        norb::BPlusTree<station_id_t, station_name_t, norb::MANUAL> station_name_store{"station_name_store"};
+        // this lookup table keeps track of all RELEASED stores, by station ordinal
+        // format: (from, to) -> (train group, serial of from, serial of to), filled if station_index is
+        // STATION_PAIR_TABLE
+        norb::BPlusTree<norb::Pair<station_ordinal_t, station_ordinal_t>, StationLookupStruct, norb::AUTOMATIC,
+                        lookup_store_page_size>
+            station_train_group_lookup_store{"station_train_group_lookup_store"};
+        // format: (station, train group) -> the train group at the station, filled whatever station_index is, since
+        // the transfer search walks it too. The train group is part of the key so that the trains of a station are
+        // listed in order
+        norb::BPlusTree<norb::Pair<station_ordinal_t, train_group_id_t>, StationStopStruct, norb::MANUAL,
+                        lookup_store_page_size>
+            station_train_store{"station_train_store"};
+        SegmentList train_group_segments{"train_group_segments"};
+        // the stations in the order they were registered, kept in the pages so that snapshots hold it too. A station
+        // is numbered by its place in this order, its ordinal, which station_ordinal_store looks up
+        norb::BPlusTree<int, station_id_t, norb::MANUAL> station_order_store{"station_order_store"};
+        norb::BPlusTree<station_id_t, station_ordinal_t, norb::MANUAL> station_ordinal_store{"station_ordinal_store"};
+        // the trains last looked up, decoded
+        mutable norb::LruCache<train_group_id_t, TrainTimetable> timetable_cache{train_cache_capacity};
+        // bumped whenever the released trains may have changed, for what is derived from them to tell it is stale
+        size_t released_version_ = 0;
+
+        // the layout the stores of the trains were written in, under key 0, see check_format
+        norb::BPlusTree<int, int, norb::MANUAL> train_format_store{"train_format_store"};
+
+        // The layout of the segments and the station indexes. Version 1 is the first recorded: the segments carry
+        // the station ordinal, and the station indexes are keyed by ordinal and carry the timetable. Trains written
+        // before it was recorded are laid out otherwise, and are not told apart from the current layout.
+        static constexpr int train_format_version = 1;
+
+        // Records the layout of new data, and refuses data in any other, which would be misread
+        void check_format() {
+            const auto format = train_format_store.find_first(0);
+            if (format.has_value()) {
+                if (format.value() != train_format_version)
+                    throw std::runtime_error("TrainManager: UNSUPPORTED DATA FORMAT!");
+                return;
+            }
+            if (train_group_store.size() != 0 || station_name_store.size() != 0)
+                throw std::runtime_error("TrainManager: DATA FORMAT NOT RECORDED, REBUILD THE DATA DIRECTORY!");
+            train_format_store.insert(0, train_format_version);
+        }
+
+        void load_station_order() {
+            station_id_vector = station_order_store.find_all_in_range(norb::Range<int>::full_range());
+        }
+
+        // Adds the stations of a released train group to the station train lists, and to the pair table if with_pairs
+        void index_train_group(const train_group_id_t &train_group_id, const TrainGroup &train_group_info,
+                               const bool &with_lists, const bool &with_pairs) {
+            const auto &segment_pointer = train_group_info.segment_pointer;
+            TrainGroupSegment segments[max_station_num];
+            get_train_group_segments(segment_pointer, segments);
+            const auto &sale_date_range = train_group_info.sale_date_range;
+            for (int i = 0; i < segment_pointer.size; ++i) {
+                const auto from_station = segments[i].station_ordinal;
+                if (with_lists) {
+                    station_train_store.insert(
+                        {from_station, train_group_id},
+                        StationStopStruct{i, segments[i].arrival_time, segments[i].departure_time, sale_date_range});
+                }
+                if (with_pairs) {
+                    for (int j = i + 1; j < segment_pointer.size; ++j) {
+                        const auto to_station = segments[j].station_ordinal;
+                        station_train_group_lookup_store.insert(
+                            {from_station, to_station},
+                            StationLookupStruct{train_group_id, i, j, segments[i].departure_time,
+                                                segments[j].arrival_time, sale_date_range});
+                    }
+                }
+            }
+        }
+
+        // Fills the station train lists, and the pair table if chosen by station_index, where they are empty while
+        // trains have been released, as after the program is built with the other index
+        void build_station_index() {
+            if constexpr (station_index == STATION_TRAIN_LISTS)
+                station_train_group_lookup_store.clear();
+            const bool with_lists = station_train_store.size() == 0;
+            const bool with_pairs = station_index == STATION_PAIR_TABLE && station_train_group_lookup_store.size() == 0;
+            if (not with_lists and not with_pairs)
+                return;
+            norb::vector<train_group_id_t> released;
+            train_group_release_store.find_all_in_range_do(
+                norb::Range<train_group_id_t>::full_range(),
+                [&released](const train_group_id_t &train_group_id, const bool &is_released) {
+                    if (is_released)
+                        released.push_back(train_group_id);
+                });
+            if (released.empty())
+                return;
+            const auto train_group_infos = train_group_store.find_many(released);
+            for (size_t i = 0; i < released.size(); ++i)
+                index_train_group(released[i], train_group_infos[i].value(), with_lists, with_pairs);
+        }
+
+        // The trains that pass from_station and later to_station, with the serials of both stations. The order they
+        // come in depends on station_index, so callers rank them by rules of their own
+        norb::vector<StationLookupStruct> find_train_groups_between(const station_ordinal_t &from_station,
+                                                                    const station_ordinal_t &to_station) const {
+            norb::vector<StationLookupStruct> train_groups;
+            if constexpr (station_index == STATION_PAIR_TABLE) {
+                station_train_group_lookup_store.find_all_do(
+                    {from_station, to_station},
+                    [&train_groups](const StationLookupStruct &train_group) { train_groups.push_back(train_group); });
+                return train_groups;
+            }
+            // both lists are sorted by train group, so they are merged in one pass
+            const auto from_trains = stops_at(from_station);
+            if (from_trains.empty())
+                return train_groups;
+            const auto to_trains = stops_at(to_station);
+            size_t i = 0, j = 0;
+            while (i < from_trains.size() && j < to_trains.size()) {
+                if (from_trains[i].first < to_trains[j].first) {
+                    ++i;
+                } else if (to_trains[j].first < from_trains[i].first) {
+                    ++j;
+                } else {
+                    const auto &from_stop = from_trains[i].second;
+                    const auto &to_stop = to_trains[j].second;
+                    if (from_stop.station_serial < to_stop.station_serial)
+                        train_groups.push_back(StationLookupStruct{from_trains[i].first, from_stop.station_serial,
+                                                                   to_stop.station_serial, from_stop.departure_time,
+                                                                   to_stop.arrival_time, from_stop.sale_date_range});
+                    ++i, ++j;
+                }
+            }
+            return train_groups;
+        }
 
       public:
-        norb::PersistentVector<station_id_t> station_id_vector;
-        TrainManager() : train_group_segments(train_group_segments_name), station_id_vector("station_id.data") {
+        // The train groups released through station, sorted by train group, with their timetable there
+        norb::vector<norb::Pair<train_group_id_t, StationStopStruct>> stops_at(const station_ordinal_t &station) const {
+            norb::vector<norb::Pair<train_group_id_t, StationStopStruct>> trains;
+            station_train_store.find_all_in_range_do(
+                norb::unpack_range(station, norb::Range<train_group_id_t>::full_range()),
+                [&trains](const norb::Pair<station_ordinal_t, train_group_id_t> &key, const StationStopStruct &stop) {
+                    trains.push_back({key.second, stop});
+                });
+            return trains;
+        }
+
+        // station_order_store in memory, the id of every station by its ordinal
+        norb::vector<station_id_t> station_id_vector;
+        TrainManager() {
+            check_format();
+            load_station_order();
+            build_station_index();
+        }
+
+        // Reloads what is kept in memory, after the pages changed under the manager.
+        void reload() {
+            check_format();
+            timetable_cache.clear();
+            ++released_version_;
+            train_group_segments.reload();
+            load_station_order();
         }
 
         static auto train_group_id_from_name(const std::string &name) {
@@ -103,9 +288,9 @@ namespace ticket {
         }
 
         std::optional<std::string> train_name_from_id(const train_group_id_t &id) const {
-            const auto train_group_info = train_group_store.find_first(id);
-            if (train_group_info.has_value()) {
-                return static_cast<std::string>(train_group_info->train_group_name);
+            const auto *timetable = get_timetable(id);
+            if (timetable != nullptr) {
+                return static_cast<std::string>(timetable->train_group.train_group_name);
             }
             return std::nullopt;
         }
@@ -118,12 +303,22 @@ namespace ticket {
             return train_group_release_store.find_first(train_group_id).value_or(false);
         }
 
-        void register_station(const station_name_t &station_name) {
+        std::optional<station_ordinal_t> station_ordinal_from_id(const station_id_t &id) const {
+            return station_ordinal_store.find_first(id);
+        }
+
+        // Registers the station if it is new, numbering it after the stations before. Returns its ordinal.
+        station_ordinal_t register_station(const station_name_t &station_name) {
             const auto station_id = station_id_from_name(static_cast<std::string>(station_name));
-            if (not station_name_store.count(station_id)) {
-                station_name_store.insert(station_id, station_name);
-                station_id_vector.push_back(station_id);
-            }
+            const auto registered = station_ordinal_store.find_first(station_id);
+            if (registered.has_value())
+                return registered.value();
+            const auto station = static_cast<station_ordinal_t>(station_id_vector.size());
+            station_name_store.insert(station_id, station_name);
+            station_order_store.insert(static_cast<int>(station), station_id);
+            station_ordinal_store.insert(station_id, station);
+            station_id_vector.push_back(station_id);
+            return station;
         }
 
         void add_train_group(const std::string &train_group_name, const std::vector<TrainGroupSegment> &segments,
@@ -145,9 +340,7 @@ namespace ticket {
             auto segment_pointer = train_group_segments.allocate(segments.size());
             // interface::log.as(LogLevel::DEBUG) << "Allocated segment pointer: (cur=" << segment_pointer.cur
             //                                    << ", size=" << segment_pointer.size << ")\n";
-            for (size_t i = 0; i < segments.size(); ++i) {
-                train_group_segments.set(segment_pointer, i, segments[i]);
-            }
+            train_group_segments.write_segment(segment_pointer, 0, segment_pointer.size, segments.data());
             new_train_group.segment_pointer = segment_pointer;
 
             train_group_store.insert(train_group_id, new_train_group);
@@ -163,21 +356,13 @@ namespace ticket {
             }
             train_group_release_store.remove(train_group_id, false);
             train_group_release_store.insert(train_group_id, true);
+            timetable_cache.erase(train_group_id);
+            ++released_version_;
 
             // append the group info into the lookup table
             const auto train_group_info = train_group_store.find_first(train_group_id);
             assert(train_group_info.has_value() && "Train group should exist when releasing it");
-            const auto &segment_pointer = train_group_info->segment_pointer;
-            // for each segment, register the station and its train group
-            for (int i = 0; i < segment_pointer.size; ++i) {
-                const auto from_station_id = train_group_segments.get(segment_pointer, i).station_id;
-                for (int j = i + 1; j < segment_pointer.size; ++j) {
-                    const auto to_station_id = train_group_segments.get(segment_pointer, j).station_id;
-                    // insert into the lookup table
-                    station_train_group_lookup_store.insert({from_station_id, to_station_id},
-                                                            StationLookupStruct{train_group_id, i, j});
-                }
-            }
+            index_train_group(train_group_id, train_group_info.value(), true, station_index == STATION_PAIR_TABLE);
             interface::log.as(LogLevel::DEBUG) << "The lookup table in TrainManager has been updated.\n";
         }
 
@@ -188,118 +373,138 @@ namespace ticket {
             if (train_group_release_store.find_first(train_group_id).value()) {
                 throw std::runtime_error("Train group is released and cannot be deleted.");
             }
-            // remove in train_group_store and train_group_release_store
-            // there is no need to remove segments from train_group_segments since it is a dynamic segment list
+            // remove in train_group_store and train_group_release_store, and hand the segments back for reuse
+            timetable_cache.erase(train_group_id);
+            train_group_segments.release(train_group_store.find_first(train_group_id)->segment_pointer);
             assert(train_group_store.remove_all(train_group_id));
             assert(train_group_release_store.remove(train_group_id, false));
         }
 
+        // The train group decoded in full, from the cache if it is there, or nullptr if it does not exist. The
+        // pointer stays valid until train_cache_capacity - 1 other trains have been loaded into the cache.
+        const TrainTimetable *get_timetable(const train_group_id_t &train_group_id) const {
+            if (const auto *cached = timetable_cache.find(train_group_id))
+                return cached;
+            const auto train_group_info = train_group_store.find_first(train_group_id);
+            if (not train_group_info.has_value())
+                return nullptr;
+            const auto &seg_ptr = train_group_info->segment_pointer;
+            TrainGroupSegment segments[max_station_num];
+            get_train_group_segments(seg_ptr, segments);
+            auto &timetable = timetable_cache.emplace(train_group_id);
+            timetable.train_group = train_group_info.value();
+            timetable.station_count = seg_ptr.size;
+            for (int i = 0; i < seg_ptr.size; ++i) {
+                timetable.station_ids[i] = segments[i].station_id;
+                timetable.station_ordinals[i] = segments[i].station_ordinal;
+                timetable.arrival_times[i] = segments[i].arrival_time;
+                timetable.departure_times[i] = segments[i].departure_time;
+                timetable.prices[i] = segments[i].price;
+            }
+            return &timetable;
+        }
+
+        // the lookups of decoded trains answered by the cache, and those that had to load the train
+        [[nodiscard]] size_t timetable_cache_hits() const {
+            return timetable_cache.hits();
+        }
+
+        [[nodiscard]] size_t timetable_cache_misses() const {
+            return timetable_cache.misses();
+        }
+
+        [[nodiscard]] size_t released_version() const {
+            return released_version_;
+        }
+
         std::optional<TrainGroup> get_train_group(const train_group_id_t &train_group_id) const {
-            return train_group_store.find_first(train_group_id);
+            const auto *timetable = get_timetable(train_group_id);
+            if (timetable == nullptr)
+                return std::nullopt;
+            return timetable->train_group;
         }
 
-        auto get_train_group_segment(const TrainGroupSegmentPointer &seg_ptr, const int cursor) const {
-            return train_group_segments.get(seg_ptr, cursor);
+        // reads every segment of the train group into out, which must hold seg_ptr.size elements
+        void get_train_group_segments(const TrainGroupSegmentPointer &seg_ptr, TrainGroupSegment *out) const {
+            train_group_segments.read_segment(seg_ptr, 0, seg_ptr.size, out);
+        }
+
+        // The dates on which the trains sold over sale_date_range leave a station departure_time after they start
+        static auto get_departure_date_range(const norb::Range<Date> &sale_date_range,
+                                             const DeltaDatetime &departure_time) {
+            return norb::Range(sale_date_range.get_from() + departure_time.to_days(),
+                               sale_date_range.get_to() + departure_time.to_days());
+        }
+
+        static auto get_departure_datetime_range(const norb::Range<Date> &sale_date_range,
+                                                 const DeltaDatetime &departure_time) {
+            return norb::Range(Datetime(sale_date_range.get_from()) + departure_time.to_minutes(),
+                               Datetime(sale_date_range.get_to()) + departure_time.to_minutes());
         }
 
         auto get_departure_date_range(const train_group_id_t &train_group_id, const int station_serial) const {
-            const auto train_group_info = train_group_store.find_first(train_group_id).value();
-            const auto seg_ptr = train_group_info.segment_pointer;
-            if (station_serial < 0 || station_serial >= seg_ptr.size) {
+            const auto &timetable = *get_timetable(train_group_id);
+            if (station_serial < 0 || station_serial >= timetable.station_count) {
                 throw std::out_of_range("Station serial out of range.");
             }
-            const auto &segment = train_group_segments.get(seg_ptr, station_serial);
-            return norb::Range(train_group_info.sale_date_range.get_from() + segment.departure_time.to_days(),
-                               train_group_info.sale_date_range.get_to() + segment.departure_time.to_days());
+            return get_departure_date_range(timetable.train_group.sale_date_range,
+                                            timetable.departure_times[station_serial]);
         }
 
         auto get_departure_datetime_range(const train_group_id_t &train_group_id, const int station_serial) const {
-            const auto train_group_info = train_group_store.find_first(train_group_id).value();
-            const auto seg_ptr = train_group_info.segment_pointer;
-            if (station_serial < 0 || station_serial >= seg_ptr.size) {
+            const auto &timetable = *get_timetable(train_group_id);
+            if (station_serial < 0 || station_serial >= timetable.station_count) {
                 throw std::out_of_range("Station serial out of range.");
             }
-            const auto &segment = train_group_segments.get(seg_ptr, station_serial);
-            return norb::Range(
-                Datetime(train_group_info.sale_date_range.get_from()) + segment.departure_time.to_minutes(),
-                Datetime(train_group_info.sale_date_range.get_to()) + segment.departure_time.to_minutes());
+            return get_departure_datetime_range(timetable.train_group.sale_date_range,
+                                                timetable.departure_times[station_serial]);
         }
 
         Date deduce_departure_date_from(const train_group_id_t &train_group_id, const int &station_serial,
                                         const Date &date_at_station) const {
-            const auto &train_group_info = train_group_store.find_first(train_group_id).value();
-            const TrainGroupSegment &from_station_segment =
-                train_group_segments.get(train_group_info.segment_pointer, station_serial);
-            return date_at_station - from_station_segment.arrival_time.to_days();
+            return date_at_station - get_timetable(train_group_id)->arrival_times[station_serial].to_days();
         }
 
         // Get the FDD (First Departure Date) from a train group with the date when the train leaves at a given station
-        Date deduce_departure_date_from(const TrainGroup &group_train_info, const int &station_serial,
-                                        const Date &date_at_station) const {
-            TrainGroupSegment from_station_segment =
-                train_group_segments.get(group_train_info.segment_pointer, station_serial);
-            return date_at_station - from_station_segment.departure_time.to_days();
+        static Date deduce_departure_date_from(const TrainTimetable &timetable, const int &station_serial,
+                                               const Date &date_at_station) {
+            return date_at_station - timetable.departure_times[station_serial].to_days();
         }
 
-        Date deduce_departure_date_from(const TrainGroup &group_train_info, const int &station_serial,
-                                        const Datetime &datetime_at_station) const {
-            const TrainGroupSegment &from_station_segment =
-                train_group_segments.get(group_train_info.segment_pointer, station_serial);
-            return (datetime_at_station - from_station_segment.departure_time.to_minutes()).getDate();
+        static Date deduce_departure_date_from(const TrainTimetable &timetable, const int &station_serial,
+                                               const Datetime &datetime_at_station) {
+            return (datetime_at_station - timetable.departure_times[station_serial].to_minutes()).getDate();
         }
 
-        // the first train in train_group_info that departs after the given datetime at the station
-        Date deduce_departure_time_for_first_after(const TrainGroup &train_group_info, const int &station_serial,
-                                                   const Datetime &after_datetime_at_station) const {
-            const TrainGroupSegment &from_station_segment =
-                train_group_segments.get(train_group_info.segment_pointer, station_serial);
-            const auto critical_datetime = after_datetime_at_station - from_station_segment.departure_time.to_minutes();
+        // the first train in timetable that departs after the given datetime at the station
+        static Date deduce_departure_time_for_first_after(const TrainTimetable &timetable, const int &station_serial,
+                                                          const Datetime &after_datetime_at_station) {
+            const auto critical_datetime =
+                after_datetime_at_station - timetable.departure_times[station_serial].to_minutes();
             // return ceil(critical_datetime)
             return critical_datetime.getDateCeil();
         }
 
-        Datetime get_departure_datetime(const TrainGroup &train_group_info, const int &station_serial,
-                                        const Date &first_departure_date) const {
-            const TrainGroupSegment &from_station_segment =
-                train_group_segments.get(train_group_info.segment_pointer, station_serial);
-            return Datetime(first_departure_date) + from_station_segment.departure_time;
+        static Datetime get_departure_datetime(const TrainTimetable &timetable, const int &station_serial,
+                                               const Date &first_departure_date) {
+            return Datetime(first_departure_date) + timetable.departure_times[station_serial];
         }
 
-        Datetime get_arrival_datetime(const TrainGroup &train_group_info, const int &station_serial,
-                                      const Date &first_departure_date) const {
-            const TrainGroupSegment &to_station_segment =
-                train_group_segments.get(train_group_info.segment_pointer, station_serial);
-            return Datetime(first_departure_date) + to_station_segment.arrival_time;
+        static Datetime get_arrival_datetime(const TrainTimetable &timetable, const int &station_serial,
+                                             const Date &first_departure_date) {
+            return Datetime(first_departure_date) + timetable.arrival_times[station_serial];
         }
 
         std::optional<int> get_station_serial_from_id(const train_group_id_t &train_group_id,
                                                       const station_id_t &station_id) const {
-            const auto &train_group_info = train_group_store.find_first(train_group_id).value();
-            const auto seg_ptr = train_group_info.segment_pointer;
-            for (int i = 0; i < seg_ptr.size; ++i) {
-                if (train_group_segments.get(seg_ptr, i).station_id == station_id) {
-                    return i; // Found the station serial
-                }
-            }
-            return std::nullopt; // Station not found in the train group
-        }
-
-        std::optional<int> get_station_serial_from_id(const TrainGroup &train_group_info,
-                                                      station_id_t station_id) const {
-            const auto seg_ptr = train_group_info.segment_pointer;
-            for (int i = 0; i < seg_ptr.size; ++i) {
-                if (train_group_segments.get(seg_ptr, i).station_id == station_id) {
-                    return i; // Found the station serial
-                }
-            }
-            return std::nullopt; // Station not found in the train group
+            return get_timetable(train_group_id)->station_serial(station_id);
         }
 
         std::optional<train_id_t> deduce_train_id_from(const train_group_id_t train_group_id,
                                                        const Date departure_date_at_s,
                                                        const station_id_t from_station_id) const {
-            const auto &train_group_info = train_group_store.find_first(train_group_id).value();
-            std::optional<int> from_station_serial = get_station_serial_from_id(train_group_info, from_station_id);
+            const auto &timetable = *get_timetable(train_group_id);
+            std::optional<int> from_station_serial = timetable.station_serial(from_station_id);
             if (not from_station_serial.has_value()) {
                 interface::log.as(LogLevel::DEBUG)
                     << "(TrainManager) (deduce_train_id_from) Station ID " << from_station_id
@@ -307,8 +512,8 @@ namespace ticket {
                 return std::nullopt; // Station not found in the train group
             }
             const auto departure_date =
-                deduce_departure_date_from(train_group_info, from_station_serial.value(), departure_date_at_s);
-            if (train_group_info.sale_date_range.contains(departure_date)) {
+                deduce_departure_date_from(timetable, from_station_serial.value(), departure_date_at_s);
+            if (timetable.train_group.sale_date_range.contains(departure_date)) {
                 return train_id_t(train_group_id, departure_date);
             } else {
                 interface::log.as(LogLevel::DEBUG)
@@ -328,27 +533,25 @@ namespace ticket {
 
         // if use_loose_date is set to false, then the datetime is not required to be IN the range for the station
         // in case of early arrival (datetime < first departure) the first train is returned
-        norb::vector<TrainRange> query_ticket(const station_id_t &from_station_id, const station_id_t &to_station_id,
+        norb::vector<TrainRange> query_ticket(const station_ordinal_t &from_station, const station_ordinal_t &to_station,
                                               const Datetime &datetime,
                                               const std::optional<train_group_id_t> &except = std::nullopt,
                                               const bool use_loose_date = false) const {
             norb::vector<TrainRange> results;
-            // Step 1: Get the train groups from the lookup table
-            const auto all_candidate_train_groups =
-                station_train_group_lookup_store.find_all({from_station_id, to_station_id});
-            // Step 2: Iterate through all_candidate_train_groups to verify them
-            for (const auto &candidate_train_group : all_candidate_train_groups) {
-                interface::log.as(LogLevel::DEBUG) << "Checking train group " << candidate_train_group.train_group_id
-                                                   << " in range: [" << candidate_train_group.station_from_serial
-                                                   << ", " << candidate_train_group.station_to_serial << "]\n";
+            // The lookup table carries the timetable of every candidate, so none of them is fetched to verify it
+            for (const auto &candidate_train_group : find_train_groups_between(from_station, to_station)) {
                 if (except.has_value() && except.value() == candidate_train_group.train_group_id) {
                     interface::log.as(LogLevel::DEBUG) << "Skipped because train group is in the except list.\n";
                     continue; // Skip this train group
                 }
+                interface::log.as(LogLevel::DEBUG) << "Checking train group " << candidate_train_group.train_group_id
+                                                   << " in range: [" << candidate_train_group.station_from_serial
+                                                   << ", " << candidate_train_group.station_to_serial << "]\n";
+                const auto &sale_date_range = candidate_train_group.sale_date_range;
+                const auto &departure_time = candidate_train_group.departure_time;
                 // todo check fix
                 if (use_loose_date) {
-                    const auto arrival_date_range = get_departure_date_range(candidate_train_group.train_group_id,
-                                                                             candidate_train_group.station_from_serial);
+                    const auto arrival_date_range = get_departure_date_range(sale_date_range, departure_time);
                     if (not arrival_date_range.contains(datetime.getDate())) {
                         interface::log.as(LogLevel::DEBUG)
                             << "Skipped because train group is not available on the given date.\n";
@@ -356,8 +559,7 @@ namespace ticket {
                     }
                 } else {
                     // Check if the train group is available on the given datetime
-                    const auto arrival_datetime_range = get_departure_datetime_range(
-                        candidate_train_group.train_group_id, candidate_train_group.station_from_serial);
+                    const auto arrival_datetime_range = get_departure_datetime_range(sale_date_range, departure_time);
                     // if (not arrival_datetime_range.contains(datetime)) {
                     if (not arrival_datetime_range.contains_from_right(datetime)) {
                         interface::log.as(LogLevel::DEBUG)
@@ -365,44 +567,69 @@ namespace ticket {
                         continue; // Not available on this datetime
                     }
                 }
-                const auto train_group_info =
-                    train_group_store.find_first(candidate_train_group.train_group_id).value();
                 // done fix this (fixed)
                 Datetime::Date first_departure_date;
                 if (use_loose_date) {
-                    first_departure_date = deduce_departure_date_from(
-                        train_group_info, candidate_train_group.station_from_serial, datetime.getDate());
+                    first_departure_date = datetime.getDate() - departure_time.to_days();
                 } else {
-                    first_departure_date = deduce_departure_time_for_first_after(
-                        train_group_info, candidate_train_group.station_from_serial, datetime);
-                    if (first_departure_date < train_group_info.sale_date_range.get_from()) {
+                    // the first train in the group that departs after the given datetime at the station
+                    first_departure_date = (datetime - departure_time.to_minutes()).getDateCeil();
+                    if (first_departure_date < sale_date_range.get_from()) {
                         // overwrite with the first train to leave
-                        first_departure_date = train_group_info.sale_date_range.get_from();
+                        first_departure_date = sale_date_range.get_from();
                     }
                 }
                 const auto &train_id = train_id_t(candidate_train_group.train_group_id, first_departure_date);
                 interface::log.as(LogLevel::DEBUG) << "Registering train ID: " << train_id << '\n';
 
-                const auto from_station_info = get_train_group_segment(train_group_info.segment_pointer,
-                                                                       candidate_train_group.station_from_serial);
-                const auto to_station_info =
-                    get_train_group_segment(train_group_info.segment_pointer, candidate_train_group.station_to_serial);
                 results.emplace_back(norb::Pair{candidate_train_group.train_group_id, first_departure_date},
-                                     Datetime(first_departure_date) + from_station_info.departure_time,
+                                     Datetime(first_departure_date) + departure_time,
                                      candidate_train_group.station_from_serial,
-                                     Datetime(first_departure_date) + to_station_info.arrival_time,
+                                     Datetime(first_departure_date) + candidate_train_group.arrival_time,
                                      candidate_train_group.station_to_serial);
             }
             return results;
         }
 
+        // Rebuilds the named store at the given fill factor. Returns std::nullopt if no store has that name.
+        std::optional<norb::TreeRebuildReport> rebuild_tree(const std::string &tree_name, const float &fill_factor) {
+            if (tree_name == "train_group")
+                return train_group_store.rebuild(fill_factor);
+            if (tree_name == "train_group_release")
+                return train_group_release_store.rebuild(fill_factor);
+            if (tree_name == "station_name")
+                return station_name_store.rebuild(fill_factor);
+            if (tree_name == "station_ordinal")
+                return station_ordinal_store.rebuild(fill_factor);
+            if (tree_name == "station_lookup")
+                return station_train_group_lookup_store.rebuild(fill_factor);
+            if (tree_name == "station_train")
+                return station_train_store.rebuild(fill_factor);
+            return std::nullopt;
+        }
+
+        // rewrites the segments of every train group contiguously, in train group id order
+        norb::SegmentCompactionReport compact_segments() {
+            timetable_cache.clear();
+            train_group_segments.begin_compaction();
+            train_group_store.modify_all_do([this](TrainGroup &train_group) {
+                train_group.segment_pointer = train_group_segments.relocate(train_group.segment_pointer);
+            });
+            return train_group_segments.end_compaction();
+        }
+
         void clear() {
             train_group_store.clear();
             train_group_release_store.clear();
             station_name_store.clear();
             station_train_group_lookup_store.clear();
-            // train_group_segments.clear();
+            station_train_store.clear();
+            train_group_segments.clear();
+            station_order_store.clear();
+            station_ordinal_store.clear();
             station_id_vector.clear();
+            timetable_cache.clear();
+            ++released_version_;
         }
     };
 } // namespace ticket
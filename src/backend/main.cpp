@@ -19,6 +19,8 @@ int main() {
     // std::cerr.rdbuf(err_stream.rdbuf());
     // redirect from screen
     std::freopen("../testcases/nul", "a+", stderr);
+    // every command is logged before its pages reach the disk
+    norb::PersistentMemory::enable_logging();
 
     CommandRegistry cmdr;
     register_commands(cmdr);
@@ -43,6 +45,7 @@ int main() {
             interface::log.as(LogLevel::ERROR) << "Command registry error: " << e.what() << '\n';
             interface::out.as() << -1 << '\n';
         }
+        norb::PersistentMemory::end_command();
     }
     interface::log.as(LogLevel::INFO) << "Exiting ticket system\n";
     return 0;
@@ -119,7 +122,14 @@ void register_commands(CommandRegistry &cmdr) {
                               {'s'},        // from station name
                               {'t'},        // to station name
                               {'d'},        // date of departure
-                              {'p', "time"} // sort by "time" or "cost"
+                              {'p', "time"} // sort by "time" or "cost", or "pareto" for all trade-offs
+                          });
+    cmdr.register_command("query_route", TicketSystem::query_route_and_print,
+                          {
+                              {'s'},   // from station name
+                              {'t'},   // to station name
+                              {'d'},   // date of departure
+                              {'k', 2} // the most transfers to make
                           });
     cmdr.register_command("buy_ticket", $print(TicketSystem::buy_ticket),
                           {
@@ -141,4 +151,23 @@ void register_commands(CommandRegistry &cmdr) {
                               {'n', 1} // order id
                           });
     cmdr.register_command("clean", $print(TicketSystem::clean), {});
+    cmdr.register_command("compact_tree", $print(TicketSystem::compact_tree),
+                          {
+                              {'n'},    // tree name
+                              {'f', 90} // target fill factor, in percent
+                          });
+    cmdr.register_command("compact_segments", $print(TicketSystem::compact_segments), {});
+    cmdr.register_command("debug_stats", $print(TicketSystem::debug_stats), {});
+    cmdr.register_command("snapshot_create", $print(TicketSystem::snapshot_create),
+                          {
+                              {'i'} // snapshot id
+                          });
+    cmdr.register_command("snapshot_restore", $print(TicketSystem::snapshot_restore),
+                          {
+                              {'i'} // snapshot id
+                          });
+    cmdr.register_command("snapshot_delete", $print(TicketSystem::snapshot_delete),
+                          {
+                              {'i'} // snapshot id
+                          });
 }
\ No newline at end of file
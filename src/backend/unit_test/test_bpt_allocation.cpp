@@ -0,0 +1,60 @@
+#include "b_plus_tree.hpp"
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+// Counts every call to the global allocator, so that the modifying paths of the tree can be checked to be
+// allocation-free once the page garbage collector has grown to its working size.
+static size_t allocation_count = 0;
+
+void *operator new(const size_t size) {
+  ++allocation_count;
+  if (void *ptr = std::malloc(size == 0 ? 1 : size))
+    return ptr;
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+using bpt_type = norb::BPlusTree<int, int>;
+constexpr int N = 60000;
+
+void fill(bpt_type &bpt) {
+  for (int i = 0; i < N; i++)
+    bpt.insert(i * 7 % N, i);
+}
+
+void drain(bpt_type &bpt) {
+  for (int i = 0; i < N; i++)
+    assert(bpt.remove(i * 7 % N, i));
+}
+
+int main() {
+  norb::chore::remove_associated();
+  {
+    bpt_type bpt;
+    // warm up: grows the file and lets the garbage collector reach its final capacity
+    fill(bpt);
+    drain(bpt);
+    assert(bpt.size() == 0);
+
+    const size_t before_insert = allocation_count;
+    fill(bpt);
+    const size_t insert_allocations = allocation_count - before_insert;
+    assert(bpt.size() == N);
+
+    const size_t before_remove = allocation_count;
+    drain(bpt);
+    const size_t remove_allocations = allocation_count - before_remove;
+    assert(bpt.size() == 0);
+
+    std::cout << "height bound: " << bpt_type::max_tree_height << '\n';
+    std::cout << "allocations during insert: " << insert_allocations << '\n';
+    std::cout << "allocations during remove: " << remove_allocations << '\n';
+    assert(insert_allocations == 0);
+    assert(remove_allocations == 0);
+  }
+  norb::chore::remove_associated();
+  std::cout << "All tests passed!" << '\n';
+  return 0;
+}
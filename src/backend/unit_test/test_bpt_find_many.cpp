@@ -0,0 +1,46 @@
+#include "b_plus_tree.hpp"
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <random>
+
+// find_many must agree with find_first on every key of a sorted batch, including duplicate keys, missing keys and
+// keys whose first value lives past the end of the leaf the descent lands in.
+using bpt_type = norb::BPlusTree<int, int>;
+constexpr int N = 100000;
+constexpr int Q = 20000;
+
+int main() {
+  norb::chore::remove_associated();
+  {
+    bpt_type bpt;
+    std::multimap<int, int> reference;
+    std::mt19937 rng(7);
+    for (int i = 0; i < N; i++) {
+      // few distinct keys with many values each, so that runs of one key span several leaves
+      const int key = static_cast<int>(rng() % (N / 8)) * 2;
+      bpt.insert(key, i);
+      reference.emplace(key, i);
+    }
+
+    std::vector<int> keys;
+    for (int i = 0; i < Q; i++)
+      keys.push_back(static_cast<int>(rng() % (N / 4 + 10)) - 5);
+    std::sort(keys.begin(), keys.end());
+    norb::vector<int> sorted_keys;
+    for (const auto &key : keys)
+      sorted_keys.push_back(key);
+
+    const auto found = bpt.find_many(sorted_keys);
+    assert(found.size() == sorted_keys.size());
+    for (size_t i = 0; i < sorted_keys.size(); ++i)
+      assert(found[i] == bpt.find_first(sorted_keys[i]));
+    std::cout << "Batch lookup passed" << '\n';
+
+    const auto none = bpt.find_many(norb::vector<int>());
+    assert(none.size() == 0);
+  }
+  norb::chore::remove_associated();
+  std::cout << "All tests passed!" << '\n';
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include "b_plus_tree.hpp"
+#include <cassert>
+#include <map>
+#include <random>
+
+// Trees of different page sizes share one buffer pool; the data set is large enough to force eviction of pages of
+// every size, and each tree is checked against a std::map after every phase.
+using small_tree_t = norb::BPlusTree<int, int, norb::MANUAL>;
+using medium_tree_t = norb::BPlusTree<int, int, norb::MANUAL, norb::PAGE_SIZE * 4>;
+using large_tree_t = norb::BPlusTree<int, int, norb::MANUAL, norb::MAX_PAGE_SIZE>;
+constexpr int N = 250000;
+
+template <typename tree_t> void check(const tree_t &tree, const std::map<int, int> &reference) {
+  assert(tree.size() == reference.size());
+  for (const auto &[key, val] : reference) {
+    const auto found = tree.find_first(key);
+    assert(found.has_value() && found.value() == val);
+  }
+}
+
+int main() {
+  norb::chore::remove_associated();
+  static_assert(medium_tree_t::LeafNode::node_capacity > 3 * small_tree_t::LeafNode::node_capacity);
+  {
+    small_tree_t small_tree;
+    medium_tree_t medium_tree;
+    large_tree_t large_tree;
+    std::map<int, int> reference;
+    std::mt19937 rng(42);
+
+    for (int i = 0; i < N; i++) {
+      const int key = static_cast<int>(rng() % (4 * N));
+      if (reference.contains(key))
+        continue;
+      reference[key] = i;
+      small_tree.insert(key, i);
+      medium_tree.insert(key, i);
+      large_tree.insert(key, i);
+    }
+    check(small_tree, reference);
+    check(medium_tree, reference);
+    check(large_tree, reference);
+    std::cout << "Insertion passed, " << norb::PersistentMemory::get_page_count() << " base pages on disk" << '\n';
+
+    for (auto it = reference.begin(); it != reference.end();) {
+      if (rng() % 3 == 0) {
+        assert(small_tree.remove(it->first, it->second));
+        assert(medium_tree.remove(it->first, it->second));
+        assert(large_tree.remove(it->first, it->second));
+        it = reference.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    check(small_tree, reference);
+    check(medium_tree, reference);
+    check(large_tree, reference);
+    std::cout << "Removal passed" << '\n';
+
+    medium_tree.rebuild(0.9f);
+    large_tree.rebuild(0.5f);
+    check(medium_tree, reference);
+    check(large_tree, reference);
+    std::cout << "Rebuild passed" << '\n';
+  }
+  norb::chore::remove_associated();
+  std::cout << "All tests passed!" << '\n';
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include "b_plus_tree.hpp"
+#include "datetime.hpp"
+#include <cassert>
+#include <map>
+#include <random>
+
+// Packed keys must order exactly as the keys they encode, and a tree over packed composite keys must answer point
+// and range queries as a tree over the plain keys would.
+using Date = norb::Datetime::Date;
+using train_id_t = norb::Pair<uint64_t, Date>;
+using pending_key_t = norb::Pair<train_id_t, int>;
+static_assert(std::is_same_v<norb::packed_key_t<pending_key_t>, norb::PackedKey<pending_key_t>>);
+static_assert(std::is_same_v<norb::packed_key_t<norb::Pair<uint64_t, uint64_t>>,
+                             norb::PackedKey<norb::Pair<uint64_t, uint64_t>>>);
+static_assert(std::is_same_v<norb::packed_key_t<int>, int>);
+static_assert(sizeof(norb::PackedKey<norb::Pair<uint32_t, int>>) == 8);
+static_assert(sizeof(norb::PackedKey<pending_key_t>) == 16);
+constexpr int N = 60000;
+
+pending_key_t random_key(std::mt19937_64 &rng) {
+  // few train groups and dates, so that equal prefixes are common
+  const train_id_t train_id{rng() % 64 * 0x9e3779b97f4a7c15ULL, Date(1 + static_cast<int>(rng() % 12),
+                                                                     1 + static_cast<int>(rng() % 31))};
+  return {train_id, static_cast<int>(rng() % 2000) - 1000};
+}
+
+int main() {
+  std::mt19937_64 rng(11);
+  for (int i = 0; i < N; i++) {
+    const auto a = random_key(rng), b = random_key(rng);
+    const norb::PackedKey<pending_key_t> pa(a), pb(b);
+    assert((a <=> b) == (pa <=> pb));
+    assert(pa.unpack() == a);
+  }
+  std::cout << "Order preservation passed" << '\n';
+
+  norb::chore::remove_associated();
+  {
+    norb::BPlusTree<pending_key_t, int, norb::MANUAL> bpt;
+    std::multimap<pending_key_t, int> reference;
+    for (int i = 0; i < N; i++) {
+      const auto key = random_key(rng);
+      bpt.insert(key, i);
+      reference.emplace(key, i);
+    }
+    for (int i = 0; i < 2000; i++) {
+      const auto key = random_key(rng);
+      assert(bpt.count(key) == reference.count(key));
+    }
+
+    const auto key = reference.begin()->first;
+    const auto range = norb::unpack_range(key.first, norb::Range<int>::full_range());
+    int expected = 0;
+    for (auto it = reference.lower_bound({key.first, INT32_MIN}); it != reference.end() && it->first.first == key.first;
+         ++it)
+      ++expected;
+    assert(bpt.count_in_range(range) == expected);
+    int seen = 0;
+    bpt.find_all_in_range_do(range, [&](const pending_key_t &found, const int &) {
+      assert(found.first == key.first);
+      ++seen;
+    });
+    assert(seen == expected);
+    std::cout << "Tree queries passed" << '\n';
+  }
+  norb::chore::remove_associated();
+  std::cout << "All tests passed!" << '\n';
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include "stlite/filed_list.hpp"
+#include "stlite/paged_segment_list.hpp"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Segment files must address elements past 4 GiB, keep their size across reopening, and convert the version 1
+// files that had a bare int header. The files are sparse: only the segments written here take up disk space.
+struct Fare {
+  int price;
+  int seats;
+};
+constexpr int64_t four_gib = int64_t(1) << 32;
+
+const char *filed_name = "test_large_filed.dat";
+const char *legacy_name = "test_legacy_filed.dat";
+
+int main() {
+  // a filed segment list whose last segments lie past 4 GiB
+  std::remove(filed_name);
+  norb::FiledSegmentList<Fare>::SegmentPointer far_segment{};
+  {
+    norb::FiledSegmentList<Fare> list(filed_name);
+    const auto near_segment = list.allocate(10);
+    for (int i = 0; i < 3; ++i)
+      list.allocate(250'000'000); // 2 GB each
+    far_segment = list.allocate(100);
+    assert(far_segment.cur * static_cast<int64_t>(sizeof(Fare)) > four_gib);
+    Fare fares[100];
+    for (int i = 0; i < 100; ++i)
+      fares[i] = {i, -i};
+    list.write_segment(far_segment, 0, 100, fares);
+    list.set(near_segment, 3, {7, 7});
+  }
+  assert(norb::filesystem::get_size(filed_name) > four_gib);
+  {
+    norb::FiledSegmentList<Fare> list(filed_name);
+    Fare fares[100];
+    list.read_segment(far_segment, 0, 100, fares);
+    for (int i = 0; i < 100; ++i)
+      assert(fares[i].price == i && fares[i].seats == -i);
+    assert(list.get({0, 10}, 3).price == 7);
+    // the size survived the reopening: the next segment follows the far one
+    assert(list.allocate(1).cur == far_segment.cur + 100);
+  }
+  std::remove(filed_name);
+  std::cout << "Filed list past 4 GiB passed" << '\n';
+
+  // a version 1 file: an int count followed by the elements
+  std::remove(legacy_name);
+  {
+    std::fstream f(legacy_name, std::ios::binary | std::ios::out);
+    const int count = 1000;
+    f.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    for (int i = 0; i < count; ++i)
+      f.write(reinterpret_cast<const char *>(&i), sizeof(i));
+  }
+  {
+    norb::FiledNaiveList<int> list(legacy_name);
+    assert(list.size() == 1000);
+    for (int i = 0; i < 1000; ++i)
+      assert(list.get(i) == i);
+    list.push_back(1000);
+  }
+  {
+    norb::FiledNaiveList<int> list(legacy_name);
+    assert(list.size() == 1001);
+    assert(list.get(0) == 0 && list.get(1000) == 1000);
+  }
+  std::remove(legacy_name);
+  std::cout << "Version 1 conversion passed" << '\n';
+
+  // a paged segment list spanning more than 4 GiB of pages, past the reach of a two-level directory
+  norb::chore::remove_associated();
+  {
+    using list_t = norb::PagedSegmentList<Fare>;
+    list_t list;
+    std::vector<list_t::SegmentPointer> marked;
+    int64_t k = 0;
+    while (list.allocate(0).cur * static_cast<int64_t>(sizeof(Fare)) <= four_gib) {
+      const auto seg = list.allocate(list_t::elements_per_page);
+      if (k % 4099 == 0) {
+        list.set(seg, static_cast<int>(k % list_t::elements_per_page), {static_cast<int>(k), 1});
+        marked.push_back(seg);
+      }
+      ++k;
+    }
+    const auto last = list.allocate(3);
+    list.set(last, 2, {-1, -1});
+    for (size_t i = 0; i < marked.size(); ++i) {
+      const int64_t id = static_cast<int64_t>(i) * 4099;
+      assert(list.get(marked[i], static_cast<int>(id % list_t::elements_per_page)).price == id);
+    }
+    assert(list.get(last, 2).price == -1);
+    std::cout << "Paged list past 4 GiB passed, " << k << " pages" << '\n';
+  }
+  norb::chore::remove_associated();
+  std::cout << "All tests passed!" << '\n';
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include "stlite/lru_cache.hpp"
+#include <cassert>
+#include <iostream>
+#include <random>
+
+// The cache must hand back what was put in, drop the least recently used value when full, and count every lookup.
+// A random run is checked against a plain list of the keys in order of use.
+int main() {
+    constexpr size_t capacity = 16;
+    norb::LruCache<int, long long> cache(capacity);
+    for (int key = 0; key < static_cast<int>(capacity); key++)
+        cache.emplace(key) = key * 10LL;
+    assert(cache.size() == capacity);
+    // using 0 makes 1 the least recently used
+    assert(*cache.find(0) == 0);
+    cache.emplace(100) = 1000;
+    assert(cache.find(1) == nullptr);
+    assert(*cache.find(0) == 0 && *cache.find(2) == 20 && *cache.find(100) == 1000);
+    cache.erase(2);
+    assert(cache.find(2) == nullptr && cache.size() == capacity - 1);
+    // the erased slot is taken before any value is dropped
+    cache.emplace(200) = 2000;
+    assert(*cache.find(3) == 30);
+    assert(cache.hits() == 5 && cache.misses() == 2);
+    // peeking at 4, the least recently used, neither counts nor saves it
+    assert(*cache.peek(4) == 40 && cache.peek(1) == nullptr);
+    cache.emplace(300) = 3000;
+    assert(cache.peek(4) == nullptr);
+    assert(cache.hits() == 5 && cache.misses() == 2);
+    cache.clear();
+    assert(cache.size() == 0 && cache.find(0) == nullptr);
+    std::cout << "Basic operations passed" << '\n';
+
+    std::mt19937 random(42);
+    int order[capacity]; // the cached keys, least recently used first
+    size_t cached = 0;
+    size_t hits = cache.hits(), misses = cache.misses();
+    for (int step = 0; step < 100000; step++) {
+        const int key = static_cast<int>(random() % (capacity * 2));
+        size_t position = 0;
+        while (position < cached && order[position] != key)
+            position++;
+        const long long *value = cache.find(key);
+        if (position < cached) {
+            assert(value != nullptr && *value == key * 7LL);
+            hits++;
+        } else {
+            assert(value == nullptr);
+            misses++;
+            cache.emplace(key) = key * 7LL;
+            if (cached == capacity) {
+                position = 0; // the least recently used key is dropped
+            } else {
+                order[cached] = key;
+                position = cached++;
+            }
+        }
+        for (; position + 1 < cached; position++)
+            order[position] = order[position + 1];
+        order[cached - 1] = key;
+    }
+    assert(cache.hits() == hits && cache.misses() == misses);
+    std::cout << "All tests passed!" << '\n';
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "b_plus_tree.hpp"
+#include "page_codec.hpp"
+#include <cassert>
+#include <cstdlib>
+#include <random>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// The codec must give back every page it compresses. The leaves of a compressed tree must be stored in fewer pages
+// once written back, read back right after a restart, take writes again, and keep working with snapshots and after a
+// crash. Each phase runs in a child process, so that the next one reopens the file.
+struct Record {
+  uint64_t account = 0;
+  uint64_t train = 0;
+  int count = 0;
+  int price = 0;
+};
+using bpt_type = norb::BPlusTree<int, Record, norb::MANUAL>;
+using pmem = norb::PersistentMemory;
+constexpr int N = 20000;
+
+// a few accounts, each with many records in a row, as in the order history
+Record record_of(const int i, const int version = 0) {
+  return {static_cast<uint64_t>(i / 50) * 0x9e3779b97f4a7c15ULL, static_cast<uint64_t>(i % 7), 1 + i % 3,
+          100 * (i % 11) + version};
+}
+
+void check_codec() {
+  std::mt19937 random(42);
+  char page[norb::PAGE_SIZE * 4], packed[norb::PAGE_SIZE * 5], unpacked[norb::PAGE_SIZE * 4];
+  for (int round = 0; round < 100; round++) {
+    // runs of repeated bytes between random ones, of every length
+    const size_t length = norb::PAGE_SIZE << (round % 3);
+    for (size_t i = 0; i < length;) {
+      const size_t run = random() % 300;
+      const char byte = static_cast<char>(random());
+      for (size_t k = 0; k < run && i < length; k++, i++)
+        page[i] = round % 2 ? byte : static_cast<char>(random() % 4);
+    }
+    const size_t size = norb::PageCodec::compress(page, length, packed, sizeof(packed));
+    assert(size > 0);
+    assert(norb::PageCodec::decompress(packed, size, unpacked, length));
+    assert(std::memcmp(page, unpacked, length) == 0);
+    assert(not norb::PageCodec::decompress(packed, size, unpacked, length - 1));
+  }
+  for (auto &byte : page)
+    byte = static_cast<char>(random());
+  // random bytes do not shrink
+  assert(norb::PageCodec::compress(page, norb::PAGE_SIZE, packed, norb::PAGE_SIZE / 2) == 0);
+}
+
+void fill() {
+  bpt_type tree("orders", norb::COMPRESSED_LEAVES);
+  for (int i = 0; i < N; i++)
+    tree.insert(i, record_of(i));
+  const auto leaves = N / bpt_type::LeafNode::node_capacity;
+  pmem::commit();
+  // most leaves moved to extents, and the pages they left are taken before the file grows
+  const auto pages = pmem::get_page_count();
+  size_t recycled = 0;
+  while (pmem::get_page_count() == pages) {
+    static_cast<void>(pmem::create_mutable());
+    recycled++;
+  }
+  assert(recycled > leaves / 2);
+}
+
+void check(const int version) {
+  const bpt_type tree("orders", norb::COMPRESSED_LEAVES);
+  assert(tree.size() == N);
+  for (int i = 0; i < N; i++) {
+    const auto record = tree.find_first(i);
+    assert(record.has_value() && record->price == record_of(i, i % 5 == 0 ? version : 0).price);
+    assert(record->account == record_of(i).account);
+  }
+}
+
+void check_fresh() { check(0); }
+
+void rewrite() {
+  bpt_type tree("orders", norb::COMPRESSED_LEAVES);
+  check(0);
+  for (int i = 0; i < N; i += 5) {
+    tree.remove(i, record_of(i));
+    tree.insert(i, record_of(i, 1));
+  }
+  check(1);
+}
+
+void check_rewritten() { check(1); }
+
+void snapshot() {
+  pmem::snapshot_create("before");
+  bpt_type tree("orders", norb::COMPRESSED_LEAVES);
+  for (int i = 0; i < N; i += 5) {
+    tree.remove(i, record_of(i, 1));
+    tree.insert(i, record_of(i, 2));
+  }
+  check(2);
+  pmem::snapshot_restore("before");
+  check(1);
+  pmem::snapshot_delete("before");
+}
+
+void rewrite_then_crash() {
+  pmem::enable_logging();
+  bpt_type tree("orders", norb::COMPRESSED_LEAVES);
+  check(1);
+  for (int i = 0; i < N; i += 5) {
+    tree.remove(i, record_of(i, 1));
+    tree.insert(i, record_of(i, 3));
+  }
+  pmem::end_command();
+  pmem::sync_log();
+  // an unfinished command
+  for (int i = 0; i < N; i += 5)
+    tree.remove(i, record_of(i, 3));
+  _exit(0);
+}
+
+void check_recovered() {
+  pmem::enable_logging();
+  check(3);
+}
+
+void run_in_child(void (*phase)()) {
+  std::cout.flush();
+  const pid_t pid = fork();
+  if (pid == 0) {
+    phase();
+    std::exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main() {
+  check_codec();
+  std::cout << "Codec passed" << '\n';
+  norb::chore::remove_associated();
+  run_in_child(fill);
+  run_in_child(check_fresh);
+  std::cout << "Leaves compressed" << '\n';
+  run_in_child(rewrite);
+  run_in_child(check_rewritten);
+  run_in_child(snapshot);
+  run_in_child(check_rewritten);
+  std::cout << "Compressed leaves rewritten" << '\n';
+  run_in_child(rewrite_then_crash);
+  run_in_child(check_recovered);
+  norb::chore::remove_associated();
+  std::cout << "All tests passed!" << '\n';
+  return 0;
+}
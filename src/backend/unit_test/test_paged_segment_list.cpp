@@ -0,0 +1,88 @@
+#include "stlite/paged_segment_list.hpp"
+#include <cassert>
+#include <random>
+#include <vector>
+
+// Segments of a PagedSegmentList must keep their contents while their pages are evicted and reloaded, and no
+// segment may straddle a page. Released segments must be reused, and compaction must keep every relocated segment.
+struct Fare {
+  int price;
+  int seats;
+};
+using list_t = norb::PagedSegmentList<Fare>;
+constexpr int segment_count = 60000; // about 3 million elements, several times the buffer pool
+
+int main() {
+  norb::chore::remove_associated();
+  {
+    list_t list;
+    std::mt19937 rng(3);
+    std::vector<list_t::SegmentPointer> segments;
+    for (int k = 0; k < segment_count; ++k) {
+      const auto seg = list.allocate(1 + static_cast<int>(rng() % 99));
+      assert(seg.cur % list_t::elements_per_page + seg.size <= list_t::elements_per_page);
+      Fare fares[100];
+      for (int i = 0; i < seg.size; ++i)
+        fares[i] = {k, i};
+      list.write_segment(seg, 0, seg.size, fares);
+      segments.push_back(seg);
+    }
+    assert(list.allocate(0).size == 0);
+
+    for (int k = 0; k < segment_count; k += 7) {
+      const auto &seg = segments[k];
+      list.set(seg, seg.size - 1, {k, -1});
+    }
+    for (int k = 0; k < segment_count; ++k) {
+      const auto &seg = segments[k];
+      Fare fares[100];
+      list.read_segment(seg, 0, seg.size, fares);
+      for (int i = 0; i < seg.size; ++i) {
+        assert(fares[i].price == k);
+        assert(fares[i].seats == ((k % 7 == 0 && i == seg.size - 1) ? -1 : i));
+      }
+      assert(list.get(seg, 0).price == k);
+    }
+    std::cout << "Segments passed, " << norb::PersistentMemory::get_page_count() << " pages on disk" << '\n';
+
+    // release every other segment, then allocate the same sizes again: the list must not grow
+    const int end_before_reuse = list.allocate(0).cur;
+    for (int k = 1; k < segment_count; k += 2)
+      list.release(segments[k]);
+    for (int k = 1; k < segment_count; k += 2) {
+      const auto seg = list.allocate(segments[k].size);
+      Fare fares[100];
+      for (int i = 0; i < seg.size; ++i)
+        fares[i] = {k, i};
+      list.write_segment(seg, 0, seg.size, fares);
+      segments[k] = seg;
+    }
+    assert(list.allocate(0).cur == end_before_reuse);
+    std::cout << "Reuse passed" << '\n';
+
+    // drop a third of the segments, then compact the rest; the rewritten odd segments lost their -1
+    std::vector<int> live;
+    for (int k = 0; k < segment_count; ++k)
+      if (k % 3 != 0)
+        live.push_back(k);
+    list.begin_compaction();
+    for (const auto &k : live)
+      segments[k] = list.relocate(segments[k]);
+    const auto report = list.end_compaction();
+    assert(report.pages_after < report.pages_before);
+    for (const auto &k : live) {
+      const auto &seg = segments[k];
+      Fare fares[100];
+      list.read_segment(seg, 0, seg.size, fares);
+      for (int i = 0; i < seg.size; ++i)
+        assert(fares[i].price == k && fares[i].seats == ((k % 14 == 0 && i == seg.size - 1) ? -1 : i));
+    }
+    std::cout << "Compaction passed, pages " << report.pages_before << " -> " << report.pages_after << '\n';
+
+    list.clear();
+    assert(list.allocate(5).cur == 0);
+  }
+  norb::chore::remove_associated();
+  std::cout << "All tests passed!" << '\n';
+  return 0;
+}
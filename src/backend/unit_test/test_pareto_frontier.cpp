@@ -0,0 +1,145 @@
+#include "route_planner.hpp"
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// query_transfer -p pareto keeps the transfers no other is both as fast and as cheap as, by total time. The
+// frontier must come out the same whatever order the transfers are added in: each one faster and dearer than the
+// next, those made worse by a new one left out, and of two as fast and as cheap, the one -p time ranks first.
+using ticket::Date;
+using ticket::Datetime;
+using ticket::RoutePlanner;
+using ticket::TrainManager;
+using Transfer = RoutePlanner::Transfer;
+using Frontier = norb::vector<Transfer>;
+
+// A transfer taking so many minutes and costing price, by trains named first and second
+Transfer transfer(const int &time, const int &price, const std::string &first = "F", const std::string &second = "S") {
+    const Datetime departure(Date(6, 10));
+    Transfer result;
+    result.first.train_id = ticket::train_id_t(TrainManager::train_group_id_from_name(first), Date(6, 10));
+    result.first.from_time = departure;
+    result.first.to_time = departure;
+    result.first.price = price;
+    result.second.train_id = ticket::train_id_t(TrainManager::train_group_id_from_name(second), Date(6, 10));
+    result.second.from_time = departure;
+    result.second.to_time = Datetime::from_minutes(departure.to_minutes() + time);
+    result.first_train_name = first;
+    result.second_train_name = second;
+    return result;
+}
+
+// Asserts frontier holds the transfers of so many minutes and costing so much, in that order
+void check(const Frontier &frontier, const std::vector<std::pair<int, int>> &expected) {
+    assert(frontier.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        assert(RoutePlanner::total_time(frontier[i]) == expected[i].first);
+        assert(RoutePlanner::total_price(frontier[i]) == expected[i].second);
+    }
+}
+
+struct Generator {
+    uint64_t state;
+
+    int next(const int &bound) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<int>(state >> 33) % bound;
+    }
+};
+
+int main() {
+    // added out of order, kept by time
+    Frontier frontier;
+    RoutePlanner::add_to_frontier(frontier, transfer(100, 50));
+    RoutePlanner::add_to_frontier(frontier, transfer(60, 80));
+    RoutePlanner::add_to_frontier(frontier, transfer(80, 60));
+    check(frontier, {{60, 80}, {80, 60}, {100, 50}});
+    std::cout << "Transfers kept by total time" << '\n';
+
+    // slower and dearer, or as fast and dearer, or slower and as cheap: left out
+    RoutePlanner::add_to_frontier(frontier, transfer(90, 70));
+    RoutePlanner::add_to_frontier(frontier, transfer(80, 61));
+    RoutePlanner::add_to_frontier(frontier, transfer(120, 50));
+    check(frontier, {{60, 80}, {80, 60}, {100, 50}});
+    // faster and cheaper than some: those are left out, the rest kept
+    RoutePlanner::add_to_frontier(frontier, transfer(70, 55));
+    check(frontier, {{60, 80}, {70, 55}, {100, 50}});
+    RoutePlanner::add_to_frontier(frontier, transfer(50, 40));
+    check(frontier, {{50, 40}});
+    std::cout << "Worse transfers pruned" << '\n';
+
+    // as fast and as cheap: the first by the names of the trains, as -p time ranks them
+    frontier = {};
+    RoutePlanner::add_to_frontier(frontier, transfer(60, 30, "B", "S"));
+    RoutePlanner::add_to_frontier(frontier, transfer(60, 30, "C", "S"));
+    check(frontier, {{60, 30}});
+    assert(frontier[0].first_train_name == std::string("B"));
+    RoutePlanner::add_to_frontier(frontier, transfer(60, 30, "A", "S"));
+    check(frontier, {{60, 30}});
+    assert(frontier[0].first_train_name == std::string("A"));
+    RoutePlanner::add_to_frontier(frontier, transfer(60, 30, "A", "R"));
+    check(frontier, {{60, 30}});
+    assert(frontier[0].second_train_name == std::string("R"));
+    std::cout << "Ties kept as -p time ranks them" << '\n';
+
+    // dominated only by a transfer as fast and as cheap, and faster or cheaper
+    frontier = {};
+    RoutePlanner::add_to_frontier(frontier, transfer(60, 80));
+    RoutePlanner::add_to_frontier(frontier, transfer(100, 50));
+    assert(not RoutePlanner::dominated(frontier, 60, 80));
+    assert(not RoutePlanner::dominated(frontier, 100, 50));
+    assert(RoutePlanner::dominated(frontier, 61, 80));
+    assert(RoutePlanner::dominated(frontier, 100, 51));
+    assert(not RoutePlanner::dominated(frontier, 59, 1000));
+    assert(not RoutePlanner::dominated(frontier, 99, 79));
+    assert(not RoutePlanner::dominated(frontier, 1000, 49));
+    std::cout << "Bounds dominated" << '\n';
+
+    // in any order, the transfers nothing else is as good as, and of those as fast and as cheap the best ranked
+    Generator generator{7};
+    for (int round = 0; round < 200; ++round) {
+        std::vector<Transfer> transfers;
+        const int count = 1 + generator.next(30);
+        for (int i = 0; i < count; ++i)
+            transfers.push_back(transfer(10 * (1 + generator.next(8)), 1 + generator.next(8),
+                                         "F" + std::to_string(generator.next(3)),
+                                         "S" + std::to_string(generator.next(3))));
+        Frontier built;
+        for (const auto &candidate : transfers)
+            RoutePlanner::add_to_frontier(built, candidate);
+        std::vector<Transfer> expected;
+        for (const auto &candidate : transfers) {
+            bool kept = true;
+            for (const auto &other : transfers) {
+                const int time = RoutePlanner::total_time(other), price = RoutePlanner::total_price(other);
+                const int candidate_time = RoutePlanner::total_time(candidate);
+                const int candidate_price = RoutePlanner::total_price(candidate);
+                if (time <= candidate_time && price <= candidate_price &&
+                    (time < candidate_time || price < candidate_price ||
+                     RoutePlanner::better(other, candidate, true)))
+                    kept = false;
+            }
+            for (const auto &other : expected)
+                kept = kept && (RoutePlanner::better(other, candidate, true) ||
+                                RoutePlanner::better(candidate, other, true));
+            if (kept)
+                expected.push_back(candidate);
+        }
+        assert(built.size() == expected.size());
+        for (size_t i = 0; i < built.size(); ++i) {
+            bool found = false;
+            for (const auto &candidate : expected)
+                found = found || (not RoutePlanner::better(candidate, built[i], true) &&
+                                  not RoutePlanner::better(built[i], candidate, true));
+            assert(found);
+            assert(i == 0 || (RoutePlanner::total_time(built[i - 1]) < RoutePlanner::total_time(built[i]) &&
+                              RoutePlanner::total_price(built[i - 1]) > RoutePlanner::total_price(built[i])));
+        }
+    }
+    std::cout << "Same frontier as every pair compared" << '\n';
+
+    std::cout << "All tests passed!" << '\n';
+    return 0;
+}
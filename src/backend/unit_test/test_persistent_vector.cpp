@@ -0,0 +1,66 @@
+#include "stlite/persistent_vector.hpp"
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+
+// A PersistentVector must keep every push_back on disk without a flush, survive a torn append, honour pop_back and
+// clear, write back in-place changes, and read files of the old int-count format.
+const char *file_name = "test_persistent_vector.dat";
+
+int main() {
+  std::remove(file_name);
+  {
+    norb::PersistentVector<uint64_t> vec(file_name);
+    for (uint64_t i = 0; i < 1000; ++i)
+      vec.push_back(i * i);
+    // already on disk: the header and 1000 elements
+    assert(norb::filesystem::get_size(file_name) == 16 + 1000 * sizeof(uint64_t));
+    vec.pop_back();
+    vec.pop_back();
+  }
+  {
+    norb::PersistentVector<uint64_t> vec(file_name);
+    assert(vec.size() == 998);
+    for (uint64_t i = 0; i < 998; ++i)
+      assert(vec[i] == i * i);
+    vec[5] = 7;
+  }
+  {
+    // a crash halfway through an append leaves a partial element behind
+    std::fstream f(file_name, std::ios::binary | std::ios::in | std::ios::out | std::ios::app);
+    f.write("abc", 3);
+  }
+  {
+    norb::PersistentVector<uint64_t> vec(file_name);
+    assert(vec.size() == 998);
+    assert(vec[5] == 7 && vec[997] == 997 * 997);
+    vec.clear();
+    vec.push_back(42);
+  }
+  {
+    const norb::PersistentVector<uint64_t> vec(file_name);
+    assert(vec.size() == 1 && vec[0] == 42);
+  }
+  std::remove(file_name);
+  std::cout << "Append log passed" << '\n';
+
+  {
+    std::fstream f(file_name, std::ios::binary | std::ios::out);
+    const int count = 3;
+    f.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    for (uint64_t i = 1; i <= 3; ++i)
+      f.write(reinterpret_cast<const char *>(&i), sizeof(i));
+  }
+  {
+    norb::PersistentVector<uint64_t> vec(file_name);
+    assert(vec.size() == 3 && vec[0] == 1 && vec[2] == 3);
+    vec.push_back(4);
+  }
+  {
+    const norb::PersistentVector<uint64_t> vec(file_name);
+    assert(vec.size() == 4 && vec[3] == 4);
+  }
+  std::remove(file_name);
+  std::cout << "All tests passed!" << '\n';
+  return 0;
+}
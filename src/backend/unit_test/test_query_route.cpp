@@ -0,0 +1,113 @@
+#include "route_planner.hpp"
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// query_route must find, for every number of trains up to k + 1, the journey arriving earlier than any with fewer
+// trains, over a timetable small enough to work out by hand:
+//   R-direct  A 08:00 -> E 18:00, 50
+//   R-one-1   A 08:00 -> C 09:00, 10     R-one-2  C 10:00 -> E 12:00, 20
+//   R-two-1   A 08:30 -> B 09:00, 1      R-two-2  B 09:30 -> D 10:00, 2      R-two-3  D 10:30 -> E 11:00, 3
+//   R-night   D 06:00 -> F 07:00, 4
+// so that more trains reach E earlier, and F is only reached the next day, on the third train.
+using ticket::Date;
+using ticket::Datetime;
+using ticket::RoutePlanner;
+using ticket::TrainGroupSegment;
+using ticket::TrainManager;
+
+struct TrainSpec {
+    std::string name;
+    std::vector<std::string> stations;
+    std::vector<int> prices; // between each station and the next
+    std::vector<int> travel; // minutes between each station and the next
+    int start = 0;           // minutes after midnight of the first departure
+};
+
+void add_train(TrainManager &trains, const TrainSpec &spec) {
+    std::vector<TrainGroupSegment> segments;
+    const int station_count = static_cast<int>(spec.stations.size());
+    int offset = spec.start;
+    for (int i = 0; i < station_count; ++i) {
+        Datetime arrival, departure;
+        if (i == 0) {
+            arrival = departure = Datetime::from_minutes(offset);
+        } else {
+            arrival = Datetime::from_minutes(offset += spec.travel[i - 1]);
+            if (i < station_count - 1)
+                departure = arrival;
+        }
+        const auto ordinal = trains.register_station(spec.stations[i]);
+        segments.emplace_back(TrainManager::station_id_from_name(spec.stations[i]), arrival, departure,
+                              i < station_count - 1 ? spec.prices[i] : 0, ordinal);
+    }
+    trains.add_train_group(spec.name, segments, 100, Date(6, 1), Date(6, 30), 'G');
+    trains.release_train_group(TrainManager::train_group_id_from_name(spec.name));
+}
+
+TrainManager::station_ordinal_t station(const TrainManager &trains, const std::string &name) {
+    return trains.station_ordinal_from_id(TrainManager::station_id_from_name(name)).value();
+}
+
+// Asserts a leg takes train from one of its stations to another, leaving and arriving so many minutes after the
+// midnight starting the query date, at price
+void check_leg(const TrainManager &trains, const RoutePlanner::Leg &leg, const std::string &train, const int &from,
+               const int &to, const int &leaves, const int &arrives, const int &price) {
+    const int midnight = Datetime(Date(6, 10)).to_minutes();
+    assert(trains.train_name_from_id(leg.train_id.first).value() == train);
+    assert(leg.from_station_serial == from && leg.to_station_serial == to);
+    assert(leg.from_time.to_minutes() == midnight + leaves && leg.to_time.to_minutes() == midnight + arrives);
+    assert(leg.price == price);
+}
+
+int main() {
+    norb::chore::remove_associated();
+    {
+        TrainManager trains;
+        RoutePlanner planner(trains);
+        add_train(trains, {"R-direct", {"A", "E"}, {50}, {600}, 8 * 60});
+        add_train(trains, {"R-one-1", {"A", "C"}, {10}, {60}, 8 * 60});
+        add_train(trains, {"R-one-2", {"C", "E"}, {20}, {120}, 10 * 60});
+        add_train(trains, {"R-two-1", {"A", "B"}, {1}, {30}, 8 * 60 + 30});
+        add_train(trains, {"R-two-2", {"B", "D"}, {2}, {30}, 9 * 60 + 30});
+        add_train(trains, {"R-two-3", {"D", "E"}, {3}, {30}, 10 * 60 + 30});
+        add_train(trains, {"R-night", {"D", "F"}, {4}, {60}, 6 * 60});
+        const Date date(6, 10);
+        const auto a = station(trains, "A"), e = station(trains, "E"), f = station(trains, "F");
+
+        const auto routes = planner.pareto_routes(a, e, date, 2);
+        assert(routes.size() == 3);
+        assert(routes[0].size() == 1);
+        check_leg(trains, routes[0][0], "R-direct", 0, 1, 8 * 60, 18 * 60, 50);
+        assert(routes[1].size() == 2);
+        check_leg(trains, routes[1][0], "R-one-1", 0, 1, 8 * 60, 9 * 60, 10);
+        check_leg(trains, routes[1][1], "R-one-2", 0, 1, 10 * 60, 12 * 60, 20);
+        assert(routes[2].size() == 3);
+        check_leg(trains, routes[2][0], "R-two-1", 0, 1, 8 * 60 + 30, 9 * 60, 1);
+        check_leg(trains, routes[2][1], "R-two-2", 0, 1, 9 * 60 + 30, 10 * 60, 2);
+        check_leg(trains, routes[2][2], "R-two-3", 0, 1, 10 * 60 + 30, 11 * 60, 3);
+        std::cout << "Journeys found by number of trains" << '\n';
+
+        assert(planner.pareto_routes(a, e, date, 1).size() == 2);
+        const auto direct = planner.pareto_routes(a, e, date, 0);
+        assert(direct.size() == 1 && direct[0].size() == 1);
+        check_leg(trains, direct[0][0], "R-direct", 0, 1, 8 * 60, 18 * 60, 50);
+        // no train leaves A for E on a day it is not on sale
+        assert(planner.pareto_routes(a, e, Date(7, 1), 2).empty());
+        std::cout << "Journeys limited by k" << '\n';
+
+        assert(planner.pareto_routes(a, f, date, 1).empty());
+        const auto overnight = planner.pareto_routes(a, f, date, 2);
+        assert(overnight.size() == 1 && overnight[0].size() == 3);
+        check_leg(trains, overnight[0][2], "R-night", 0, 1, 24 * 60 + 6 * 60, 24 * 60 + 7 * 60, 4);
+        std::cout << "Runs caught the next day" << '\n';
+
+        assert(planner.pareto_routes(a, e, date, -1).empty());
+        assert(planner.pareto_routes(a, a, date, 2).empty());
+        std::cout << "No journeys for negative k or the same station" << '\n';
+    }
+    norb::chore::remove_associated();
+    std::cout << "All tests passed!" << '\n';
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "stlite/filed_list.hpp"
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+
+// read_segment / write_segment must move the same data as element-wise get / set, and reject the same ranges.
+struct Fare {
+  int price;
+  int seats;
+};
+
+const char *file_name = "test_segment_io.dat";
+
+int main() {
+  std::remove(file_name);
+  {
+    norb::FiledSegmentList<Fare> list(file_name);
+    const auto first = list.allocate(5);
+    const auto second = list.allocate(7);
+
+    Fare fares[7];
+    for (int i = 0; i < 7; ++i)
+      fares[i] = {10 * i, 100 + i};
+    list.write_segment(second, 0, 7, fares);
+    for (int i = 0; i < 5; ++i)
+      list.set(first, i, {-i, -i});
+
+    // a partial write in the middle leaves its neighbours untouched
+    const Fare middle[2] = {{1, 1}, {2, 2}};
+    list.write_segment(second, 3, 5, middle);
+    Fare read[7];
+    list.read_segment(second, 0, 7, read);
+    for (int i = 0; i < 7; ++i) {
+      const Fare expected = (i == 3 || i == 4) ? middle[i - 3] : fares[i];
+      assert(read[i].price == expected.price && read[i].seats == expected.seats);
+      assert(list.get(second, i).price == expected.price);
+    }
+    list.read_segment(first, 1, 4, read);
+    for (int i = 1; i < 4; ++i)
+      assert(read[i - 1].price == -i);
+
+    // empty ranges are no-ops, out-of-segment ranges throw like get does
+    list.read_segment(first, 2, 2, read);
+    bool caught = false;
+    try {
+      list.read_segment(first, 0, 6, read);
+    } catch (const std::range_error &) {
+      caught = true;
+    }
+    assert(caught);
+    caught = false;
+    try {
+      list.write_segment(second, 4, 3, fares);
+    } catch (const std::range_error &) {
+      caught = true;
+    }
+    assert(caught);
+  }
+  std::remove(file_name);
+  std::cout << "All tests passed!" << '\n';
+  return 0;
+}
@@ -0,0 +1,155 @@
+#include "b_plus_tree.hpp"
+#include <cassert>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Snapshots must bring back every structure as it was when taken, keep doing so after the current state and other
+// snapshots change, survive a restart and a crash, and share their pages: a snapshot only costs the pages written
+// after it, and deleting it gives them back. Each phase runs in a child process, so that the next one reopens the file.
+using bpt_type = norb::BPlusTree<int, int>;
+using pmem = norb::PersistentMemory;
+constexpr int N = 20000;
+
+template <typename Exception, typename Function> void assert_throws(Function &&function) {
+  bool thrown = false;
+  try {
+    function();
+  } catch (const Exception &) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+// base holds [0, N) mapped to i, later the odd ones of them and [N, 2N) mapped to -i
+void check_base(const bpt_type &tree) {
+  assert(tree.size() == N);
+  for (int i = 0; i < N; i += 3)
+    assert(tree.find_first(i) == i);
+  assert(tree.find_all(N).empty());
+}
+
+void check_later(const bpt_type &tree) {
+  assert(tree.size() == N / 2 + N);
+  for (int i = 0; i < N; i += 3)
+    assert(tree.find_all(i).size() == static_cast<size_t>(i % 2));
+  for (int i = N; i < 2 * N; i += 3)
+    assert(tree.find_first(i) == -i);
+}
+
+void take() {
+  pmem::enable_logging();
+  bpt_type tree("tree");
+  for (int i = 0; i < N; i++)
+    tree.insert(i, i);
+  pmem::snapshot_create("base");
+  assert_throws<std::invalid_argument>([] { pmem::snapshot_create("base"); });
+  assert_throws<std::invalid_argument>([] { pmem::snapshot_create("bad-name"); });
+  assert_throws<std::invalid_argument>([] { pmem::snapshot_create(""); });
+  // the base stays as it is while the current state changes
+  for (int i = 0; i < N; i += 2)
+    tree.remove(i, i);
+  for (int i = N; i < 2 * N; i++)
+    tree.insert(i, -i);
+  pmem::snapshot_create("later");
+  check_later(tree);
+  pmem::end_command();
+}
+
+void restore() {
+  pmem::enable_logging();
+  bpt_type tree("tree");
+  check_later(tree);
+  pmem::snapshot_restore("base");
+  check_base(tree);
+  // changes to a restored state leave its snapshot as it was
+  for (int i = 0; i < N; i++)
+    tree.remove(i, i);
+  assert(tree.size() == 0);
+  pmem::snapshot_restore("later");
+  check_later(tree);
+  pmem::snapshot_restore("base");
+  check_base(tree);
+  pmem::snapshot_delete("later");
+  assert_throws<std::invalid_argument>([] { pmem::snapshot_restore("later"); });
+  assert_throws<std::invalid_argument>([] { pmem::snapshot_delete("later"); });
+  pmem::end_command();
+}
+
+void change_then_crash() {
+  pmem::enable_logging();
+  bpt_type tree("tree");
+  check_base(tree);
+  for (int i = 0; i < N; i += 2)
+    tree.remove(i, i);
+  pmem::end_command();
+  pmem::sync_log();
+  _exit(0);
+}
+
+void check_recovered() {
+  pmem::enable_logging();
+  bpt_type tree("tree");
+  assert(tree.size() == N / 2);
+  pmem::snapshot_restore("base");
+  check_base(tree);
+  pmem::end_command();
+}
+
+void share_pages() {
+  bpt_type tree("tree");
+  // a hundred snapshots a few changes apart only cost the pages those changes copy
+  const auto pages_before = pmem::get_page_count();
+  for (int k = 0; k < 100; k++) {
+    pmem::snapshot_create("k" + std::to_string(k));
+    tree.insert(2 * N + k, k);
+  }
+  const auto pages_taken = pmem::get_page_count() - pages_before;
+  assert(pages_taken < 100 * 16);
+  for (int k = 0; k < 100; k += 10) {
+    pmem::snapshot_restore("k" + std::to_string(k));
+    assert(tree.size() == N + k);
+    assert(tree.find_all(2 * N + k).empty());
+    assert(k == 0 || tree.find_first(2 * N + k - 1) == k - 1);
+  }
+  // once deleted, their pages are taken again before the file grows
+  for (int k = 0; k < 100; k++)
+    pmem::snapshot_delete("k" + std::to_string(k));
+  pmem::snapshot_delete("base");
+  const auto pages_after_delete = pmem::get_page_count();
+  for (int k = 0; k < 100; k++) {
+    pmem::snapshot_create("again");
+    tree.insert(3 * N + k, k);
+    pmem::snapshot_delete("again");
+  }
+  assert(pmem::get_page_count() == pages_after_delete);
+}
+
+void run_in_child(void (*phase)()) {
+  std::cout.flush();
+  const pid_t pid = fork();
+  if (pid == 0) {
+    phase();
+    std::exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main() {
+  norb::chore::remove_associated();
+  run_in_child(take);
+  run_in_child(restore);
+  std::cout << "Snapshots restored" << '\n';
+  run_in_child(change_then_crash);
+  run_in_child(check_recovered);
+  std::cout << "Snapshots recovered" << '\n';
+  run_in_child(share_pages);
+  std::cout << "Pages shared" << '\n';
+  norb::chore::remove_associated();
+  std::cout << "All tests passed!" << '\n';
+  return 0;
+}
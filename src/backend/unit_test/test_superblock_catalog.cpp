@@ -0,0 +1,70 @@
+#include "b_plus_tree.hpp"
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Named trees must find their roots in the superblock catalog whatever the order they are constructed in, and a
+// torn write of the newest superblock slot must fall back to the other one. Each phase runs in a child process,
+// as PersistentMemory only reads the superblock when the process opens the file.
+using bpt_type = norb::BPlusTree<int, int>;
+constexpr int N = 20000;
+
+void fill() {
+  bpt_type first("first");
+  bpt_type second("second");
+  for (int i = 0; i < N; i++) {
+    first.insert(i, i);
+    second.insert(i, -i);
+  }
+}
+
+void check() {
+  // the other order, with an unnamed tree in front
+  bpt_type anonymous;
+  bpt_type second("second");
+  bpt_type first("first");
+  assert(anonymous.size() == 0);
+  assert(first.size() == N && second.size() == N);
+  for (int i = 0; i < N; i += 97) {
+    assert(first.find_first(i) == i);
+    assert(second.find_first(i) == -i);
+  }
+}
+
+void run_in_child(void (*phase)()) {
+  std::cout.flush();
+  const pid_t pid = fork();
+  if (pid == 0) {
+    phase();
+    std::exit(0); // runs the destructors that commit the superblock
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main() {
+  norb::chore::remove_associated();
+  run_in_child(fill);
+  run_in_child(check);
+  std::cout << "Catalog passed" << '\n';
+
+  // tear the newest slot: commits alternate between the two, so clobber the one holding the larger sequence
+  {
+    std::fstream f(norb::settings::PMEM_FILE_NAME, std::ios::binary | std::ios::in | std::ios::out);
+    uint64_t sequence[2];
+    for (int slot = 0; slot < 2; slot++) {
+      f.seekg(slot * norb::PAGE_SIZE + 8);
+      f.read(reinterpret_cast<char *>(&sequence[slot]), sizeof(uint64_t));
+    }
+    const int newest = sequence[0] > sequence[1] ? 0 : 1;
+    f.seekp(newest * norb::PAGE_SIZE + 100);
+    f.write("torn", 4);
+  }
+  run_in_child(check);
+  norb::chore::remove_associated();
+  std::cout << "All tests passed!" << '\n';
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include "thread_pool.hpp"
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+// Every worker must run each task exactly once, run must not return before all of them have, and an exception of any
+// worker must reach the caller without stopping the pool.
+int main() {
+    constexpr size_t workers = 4;
+    norb::ThreadPool pool(workers);
+    assert(pool.size() == workers);
+
+    long long partial[workers] = {};
+    for (int round = 1; round <= 1000; round++) {
+        std::atomic<int> calls = 0;
+        pool.run([&](const size_t worker) {
+            long long sum = 0;
+            for (int i = static_cast<int>(worker); i <= round; i += static_cast<int>(workers))
+                sum += i;
+            partial[worker] = sum;
+            ++calls;
+        });
+        assert(calls == static_cast<int>(workers));
+        long long total = 0;
+        for (const auto &sum : partial)
+            total += sum;
+        assert(total == 1LL * round * (round + 1) / 2);
+    }
+    std::cout << "Tasks passed" << '\n';
+
+    for (size_t thrower = 0; thrower < workers; thrower++) {
+        std::atomic<int> calls = 0;
+        bool caught = false;
+        try {
+            pool.run([&](const size_t worker) {
+                ++calls;
+                if (worker == thrower)
+                    throw std::runtime_error("worker failed");
+            });
+        } catch (const std::runtime_error &) {
+            caught = true;
+        }
+        assert(caught && calls == static_cast<int>(workers));
+    }
+    std::atomic<int> calls = 0;
+    pool.run([&](const size_t) { ++calls; });
+    assert(calls == static_cast<int>(workers));
+
+    norb::ThreadPool single(1);
+    assert(single.size() == 1);
+    single.run([&](const size_t worker) { assert(worker == 0); });
+    std::cout << "All tests passed!" << '\n';
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "ticket_manager.hpp" // train_id_t
+#include "train_manager.hpp"
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+// TrainManager must record the layout of the train stores in new data and open it again, and refuse trains written
+// with no layout recorded or with another one, rather than misread them.
+using ticket::Date;
+using ticket::Datetime;
+using ticket::TrainGroupSegment;
+using ticket::TrainManager;
+using format_store_type = norb::BPlusTree<int, int, norb::MANUAL>;
+
+template <typename Exception, typename Function> void assert_throws(Function &&function) {
+    bool thrown = false;
+    try {
+        function();
+    } catch (const Exception &) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+int main() {
+    norb::chore::remove_associated();
+    {
+        TrainManager trains;
+        std::vector<TrainGroupSegment> segments;
+        for (const std::string name : {"A", "B"}) {
+            const auto ordinal = trains.register_station(name);
+            segments.emplace_back(TrainManager::station_id_from_name(name), Datetime(), Datetime(), 1, ordinal);
+        }
+        trains.add_train_group("T", segments, 100, Date(6, 1), Date(6, 30), 'G');
+    }
+    {
+        const TrainManager trains;
+        assert(trains.exists_train_group(TrainManager::train_group_id_from_name("T")));
+    }
+    std::cout << "Recorded format reopened" << '\n';
+
+    format_store_type format_store("train_format_store");
+    assert(format_store.find_first(0) == 1);
+    format_store.remove(0, 1);
+    assert_throws<std::runtime_error>([] { const TrainManager trains; });
+    format_store.insert(0, 2);
+    assert_throws<std::runtime_error>([] { const TrainManager trains; });
+    std::cout << "Other formats refused" << '\n';
+
+    norb::chore::remove_associated();
+    std::cout << "All tests passed!" << '\n';
+    return 0;
+}
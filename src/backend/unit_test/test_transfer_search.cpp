@@ -0,0 +1,276 @@
+#include "route_planner.hpp"
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// query_transfer must rank the second trains from a middle station by rules of its own, whatever order the station
+// index lists them in: on a tie in what is sorted by, the earliest to arrive or the cheapest, and then the first by
+// name. The trains of each case are named so that train group order is the opposite.
+// It must also find the transfer the loop it replaced found, which tried every train from the origin to every
+// station and the best second train from there. Both are run over a generated timetable of few stations, times on
+// the half hour and prices of 1 to 3, so that many transfers tie.
+using ticket::Date;
+using ticket::Datetime;
+using ticket::RoutePlanner;
+using ticket::TrainGroupSegment;
+using ticket::TrainManager;
+
+struct TrainSpec {
+    std::string name;
+    std::vector<std::string> stations;
+    std::vector<int> prices; // between each station and the next
+    std::vector<int> travel; // minutes between each station and the next
+    int start = 0;           // minutes after midnight of the first departure
+    int stopover = 0;        // minutes at each station between the first and the last
+    Date sale_from = Date(6, 1), sale_to = Date(6, 30);
+};
+
+void add_train(TrainManager &trains, const TrainSpec &spec) {
+    std::vector<TrainGroupSegment> segments;
+    const int station_count = static_cast<int>(spec.stations.size());
+    int offset = spec.start;
+    for (int i = 0; i < station_count; ++i) {
+        Datetime arrival, departure;
+        if (i == 0) {
+            arrival = departure = Datetime::from_minutes(offset);
+        } else {
+            arrival = Datetime::from_minutes(offset += spec.travel[i - 1]);
+            if (i < station_count - 1)
+                departure = Datetime::from_minutes(offset += spec.stopover);
+        }
+        const auto ordinal = trains.register_station(spec.stations[i]);
+        segments.emplace_back(TrainManager::station_id_from_name(spec.stations[i]), arrival, departure,
+                              i < station_count - 1 ? spec.prices[i] : 0, ordinal);
+    }
+    trains.add_train_group(spec.name, segments, 100, spec.sale_from, spec.sale_to, 'G');
+    trains.release_train_group(TrainManager::train_group_id_from_name(spec.name));
+}
+
+TrainManager::station_ordinal_t station(const TrainManager &trains, const std::string &name) {
+    return trains.station_ordinal_from_id(TrainManager::station_id_from_name(name)).value();
+}
+
+// Two train names, the first before the second by name but after it in train group order
+std::pair<std::string, std::string> inverted_names(const std::string &prefix) {
+    for (int i = 0;; ++i) {
+        const auto a = prefix + std::to_string(i), b = prefix + std::to_string(i + 1);
+        if (a < b && TrainManager::train_group_id_from_name(a) > TrainManager::train_group_id_from_name(b))
+            return {a, b};
+    }
+}
+
+using Transfer = RoutePlanner::Transfer;
+
+std::string name_of(const TrainManager &trains, const ticket::train_id_t &train_id) {
+    return trains.train_name_from_id(train_id.first).value();
+}
+
+int price_of(const TrainManager &trains, const TrainManager::TrainRange &range) {
+    const auto &timetable = *trains.get_timetable(range.train_id.first);
+    int price = 0;
+    for (int i = range.from_station_serial; i < range.to_station_serial; ++i)
+        price += timetable.prices[i];
+    return price;
+}
+
+// The ranking of query_transfer: the total time or cost, the other one, the names of the trains, then the middle
+// station
+bool ranks_before(const TrainManager &trains, const Transfer &a, const Transfer &b, const bool by_time) {
+    const int a_time = (a.second.to_time - a.first.from_time).to_minutes();
+    const int b_time = (b.second.to_time - b.first.from_time).to_minutes();
+    const int a_price = a.first.price + a.second.price, b_price = b.first.price + b.second.price;
+    if (by_time && a_time != b_time)
+        return a_time < b_time;
+    if (a_price != b_price)
+        return a_price < b_price;
+    if (a_time != b_time)
+        return a_time < b_time;
+    if (a.first.train_id != b.first.train_id)
+        return name_of(trains, a.first.train_id) < name_of(trains, b.first.train_id);
+    if (a.second.train_id.first != b.second.train_id.first)
+        return name_of(trains, a.second.train_id) < name_of(trains, b.second.train_id);
+    return a.mid_station < b.mid_station;
+}
+
+RoutePlanner::Leg leg_of(const TrainManager &trains, const TrainManager::TrainRange &range) {
+    return {range.train_id, range.from_station_serial, range.to_station_serial, range.from_time, range.to_time,
+            price_of(trains, range)};
+}
+
+// The transfer the loop query_transfer ran before RoutePlanner finds: every train leaving from on date to every
+// station, each with the best train from there on to to
+std::optional<Transfer> old_loop(const TrainManager &trains, const TrainManager::station_ordinal_t &from,
+                                 const TrainManager::station_ordinal_t &to, const Date &date, const bool by_time) {
+    std::optional<Transfer> best;
+    for (TrainManager::station_ordinal_t mid = 0; mid < trains.station_id_vector.size(); ++mid) {
+        if (mid == from || mid == to)
+            continue;
+        for (const auto &first_range : trains.query_ticket(from, mid, Datetime(date), std::nullopt, true)) {
+            std::optional<RoutePlanner::Leg> second;
+            for (const auto &second_range : trains.query_ticket(mid, to, first_range.to_time, first_range.train_id.first)) {
+                const auto leg = leg_of(trains, second_range);
+                if (second.has_value()) {
+                    const int arrival = leg.to_time.to_minutes(), best_arrival = second->to_time.to_minutes();
+                    const bool better = by_time && arrival != best_arrival ? arrival < best_arrival
+                                        : leg.price != second->price    ? leg.price < second->price
+                                        : arrival != best_arrival       ? arrival < best_arrival
+                                                                        : name_of(trains, leg.train_id) <
+                                                                              name_of(trains, second->train_id);
+                    if (not better)
+                        continue;
+                }
+                second = leg;
+            }
+            if (not second.has_value())
+                continue;
+            Transfer candidate;
+            candidate.first = leg_of(trains, first_range);
+            candidate.second = second.value();
+            candidate.mid_station = mid;
+            if (not best.has_value() || ranks_before(trains, candidate, best.value(), by_time))
+                best = candidate;
+        }
+    }
+    return best;
+}
+
+bool same_leg(const RoutePlanner::Leg &a, const RoutePlanner::Leg &b) {
+    return a.train_id == b.train_id && a.from_station_serial == b.from_station_serial &&
+           a.to_station_serial == b.to_station_serial && a.from_time == b.from_time && a.to_time == b.to_time &&
+           a.price == b.price;
+}
+
+// a linear congruential generator, so that the timetable is the same on every run
+struct Generator {
+    uint64_t state;
+
+    int operator()(const int &bound) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<int>(state >> 33) % bound;
+    }
+};
+
+std::string second_train_of(const std::optional<RoutePlanner::Transfer> &transfer) {
+    assert(transfer.has_value());
+    return static_cast<std::string>(transfer->second_train_name);
+}
+
+int main() {
+    norb::chore::remove_associated();
+    {
+        TrainManager trains;
+        RoutePlanner planner(trains);
+        const Date date(6, 10);
+
+        // as cheap: the earlier to arrive, by either sort
+        {
+            const auto [early, late] = inverted_names("P");
+            add_train(trains, {"P-first", {"A1", "M1"}, {10}, {60}, 8 * 60});
+            add_train(trains, {late, {"M1", "Z1"}, {5}, {240}, 10 * 60});
+            add_train(trains, {early, {"M1", "Z1"}, {5}, {120}, 10 * 60});
+            const auto from = station(trains, "A1"), to = station(trains, "Z1");
+            assert(second_train_of(planner.best_transfer(from, to, date, "cost")) == early);
+            assert(second_train_of(planner.best_transfer(from, to, date, "time")) == early);
+        }
+        // as early: the cheaper, by either sort
+        {
+            const auto [cheap, dear] = inverted_names("T");
+            add_train(trains, {"T-first", {"A2", "M2"}, {10}, {60}, 8 * 60});
+            add_train(trains, {dear, {"M2", "Z2"}, {7}, {120}, 10 * 60});
+            add_train(trains, {cheap, {"M2", "Z2"}, {5}, {120}, 10 * 60});
+            const auto from = station(trains, "A2"), to = station(trains, "Z2");
+            assert(second_train_of(planner.best_transfer(from, to, date, "time")) == cheap);
+            assert(second_train_of(planner.best_transfer(from, to, date, "cost")) == cheap);
+        }
+        // as early and as cheap: the first by name
+        {
+            const auto [first, second] = inverted_names("N");
+            add_train(trains, {"N-first", {"A3", "M3"}, {10}, {60}, 8 * 60});
+            add_train(trains, {second, {"M3", "Z3"}, {5}, {120}, 10 * 60});
+            add_train(trains, {first, {"M3", "Z3"}, {5}, {120}, 10 * 60});
+            const auto from = station(trains, "A3"), to = station(trains, "Z3");
+            assert(second_train_of(planner.best_transfer(from, to, date, "time")) == first);
+            assert(second_train_of(planner.best_transfer(from, to, date, "cost")) == first);
+        }
+        // a cheaper second train arriving later still wins by cost, and loses by time
+        {
+            add_train(trains, {"C-first", {"A4", "M4"}, {10}, {60}, 8 * 60});
+            add_train(trains, {"C-fast", {"M4", "Z4"}, {9}, {60}, 10 * 60});
+            add_train(trains, {"C-cheap", {"M4", "Z4"}, {3}, {600}, 10 * 60});
+            const auto from = station(trains, "A4"), to = station(trains, "Z4");
+            assert(second_train_of(planner.best_transfer(from, to, date, "cost")) == "C-cheap");
+            assert(second_train_of(planner.best_transfer(from, to, date, "time")) == "C-fast");
+        }
+        std::cout << "Second trains ranked" << '\n';
+
+        // the same two trains, as fast and as cheap changed at either of two stations: the first of them
+        {
+            add_train(trains, {"D-first", {"A5", "M5", "N5"}, {1, 1}, {60, 60}, 8 * 60});
+            add_train(trains, {"D-second", {"M5", "N5", "Z5"}, {1, 1}, {30, 60}, 9 * 60 + 30});
+            const auto from = station(trains, "A5"), to = station(trains, "Z5");
+            for (const bool by_time : {true, false}) {
+                const auto transfer = planner.best_transfer(from, to, date, by_time ? "time" : "cost");
+                const auto expected = old_loop(trains, from, to, date, by_time);
+                assert(transfer.has_value() && expected.has_value());
+                assert(transfer->mid_station == station(trains, "M5") && expected->mid_station == transfer->mid_station);
+            }
+        }
+
+        constexpr int station_count = 10, train_count = 80;
+        Generator random{12};
+        for (int t = 0; t < train_count; ++t) {
+            TrainSpec spec;
+            spec.name = "G" + std::to_string(t);
+            const int length = 2 + random(5);
+            while (static_cast<int>(spec.stations.size()) < length) {
+                const auto name = "S" + std::to_string(random(station_count));
+                if (std::find(spec.stations.begin(), spec.stations.end(), name) == spec.stations.end())
+                    spec.stations.push_back(name);
+            }
+            for (int i = 0; i + 1 < length; ++i) {
+                spec.prices.push_back(1 + random(3));
+                spec.travel.push_back(30 * (1 + random(4)));
+            }
+            spec.start = 30 * random(48);
+            spec.stopover = 30 * random(2);
+            spec.sale_from = Date(6, 1 + random(5));
+            spec.sale_to = spec.sale_from + random(10);
+            add_train(trains, spec);
+        }
+        int found = 0, queries = 0;
+        for (const auto &date : {Date(6, 3), Date(6, 6), Date(6, 12)}) {
+            for (int i = 0; i < station_count; ++i) {
+                for (int j = 0; j < station_count; ++j) {
+                    if (i == j)
+                        continue;
+                    const auto from = station(trains, "S" + std::to_string(i));
+                    const auto to = station(trains, "S" + std::to_string(j));
+                    for (const bool by_time : {true, false}) {
+                        const auto expected = old_loop(trains, from, to, date, by_time);
+                        const auto actual = planner.best_transfer(from, to, date, by_time ? "time" : "cost");
+                        ++queries;
+                        assert(expected.has_value() == actual.has_value());
+                        if (not expected.has_value())
+                            continue;
+                        ++found;
+                        assert(same_leg(expected->first, actual->first));
+                        assert(same_leg(expected->second, actual->second));
+                        assert(expected->mid_station == actual->mid_station);
+                        assert(static_cast<std::string>(actual->first_train_name) ==
+                               name_of(trains, actual->first.train_id));
+                        assert(static_cast<std::string>(actual->second_train_name) ==
+                               name_of(trains, actual->second.train_id));
+                    }
+                }
+            }
+        }
+        // most queries find a transfer, so the comparison is not left to the empty ones
+        assert(found * 2 > queries);
+        std::cout << "Same transfers as the old loop in " << found << " of " << queries << " queries" << '\n';
+    }
+    norb::chore::remove_associated();
+    std::cout << "All tests passed!" << '\n';
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "b_plus_tree.hpp"
+#include <cassert>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// With logging on, a crash must leave exactly the commands committed to the log: those synced survive even if
+// their pages never reached the disk, and a command cut short is rolled back even after its pages were evicted
+// and written in place. A long run takes fuzzy checkpoints on the way, which must drop the log before them and
+// leave recovery only the rest. The pages freed before a crash must be taken again rather than grow the file, as
+// the free lists are only written on a clean shutdown. Each phase runs in a child process; the crashing ones leave through _exit,
+// skipping every destructor.
+using bpt_type = norb::BPlusTree<int, int>;
+constexpr int N = 30000;
+constexpr int batch = 100;
+constexpr int in_flight = 1000000; // far more pages than the buffer pool holds
+
+void fill_then_crash() {
+  norb::PersistentMemory::enable_logging();
+  bpt_type tree("logged");
+  for (int i = 0; i < N; i++) {
+    tree.insert(i, i);
+    if ((i + 1) % batch == 0)
+      norb::PersistentMemory::end_command();
+  }
+  norb::PersistentMemory::sync_log();
+  // an unfinished command, overwriting committed entries as well
+  for (int i = 0; i < N; i += 2)
+    tree.remove(i, i);
+  for (int i = 0; i < in_flight; i++)
+    tree.insert(N + i, -i);
+  _exit(0);
+}
+
+void check_committed() {
+  norb::PersistentMemory::enable_logging();
+  bpt_type tree("logged");
+  assert(tree.size() == N);
+  for (int i = 0; i < N; i++)
+    assert(tree.find_first(i) == i);
+  assert(tree.find_all(N).empty() && tree.find_all(N + in_flight - 1).empty());
+  // the recovered tree takes changes again
+  for (int i = 0; i < batch; i++)
+    tree.insert(-1 - i, i);
+  norb::PersistentMemory::end_command();
+}
+
+void grow_then_crash() {
+  norb::PersistentMemory::enable_logging();
+  bpt_type tree("logged");
+  for (int i = 0; i < N; i++) {
+    tree.insert(N + i, i);
+    if ((i + 1) % batch == 0)
+      norb::PersistentMemory::end_command();
+  }
+  _exit(0); // the last group may not be synced
+}
+
+void check_prefix() {
+  norb::PersistentMemory::enable_logging();
+  bpt_type tree("logged");
+  // whatever was lost, it is a whole number of the latest commands
+  const int grown = static_cast<int>(tree.size()) - N - batch;
+  assert(grown >= 0 && grown <= N && grown % batch == 0);
+  for (int i = 0; i < grown; i++)
+    assert(tree.find_first(N + i) == i);
+  assert(tree.find_all(N + grown).empty());
+  assert(tree.find_first(-batch) == batch - 1);
+}
+
+// the bytes the log takes on disk, less than its size once its front has been dropped
+long long log_disk_bytes() {
+  struct stat status {};
+  assert(stat((norb::settings::PMEM_FILE_NAME + ".wal").c_str(), &status) == 0);
+  return static_cast<long long>(status.st_blocks) * 512;
+}
+
+long long log_size() {
+  struct stat status {};
+  assert(stat((norb::settings::PMEM_FILE_NAME + ".wal").c_str(), &status) == 0);
+  return status.st_size;
+}
+
+constexpr int long_run = 400000;
+
+void run_long_then_crash() {
+  norb::PersistentMemory::enable_logging();
+  bpt_type tree("long");
+  for (int i = 0; i < long_run; i++) {
+    const int key = static_cast<int>(i * 7919LL % long_run); // all over the tree, so the deltas add up
+    tree.insert(key, key);
+    if ((i + 1) % batch == 0)
+      norb::PersistentMemory::end_command();
+  }
+  norb::PersistentMemory::sync_log();
+  // past a checkpoint, so most of the log is gone
+  assert(log_size() > static_cast<long long>(norb::WAL_CHECKPOINT_BYTES));
+  assert(log_disk_bytes() < log_size() / 2);
+  _exit(0);
+}
+
+void check_long() {
+  norb::PersistentMemory::enable_logging();
+  bpt_type tree("long");
+  assert(tree.size() == long_run);
+  for (int i = 0; i < long_run; i += 7)
+    assert(tree.find_first(i) == i);
+}
+
+void empty_then_crash() {
+  norb::PersistentMemory::enable_logging();
+  bpt_type tree("long");
+  for (int i = 0; i < long_run; i++) {
+    tree.remove(i, i);
+    if ((i + 1) % batch == 0)
+      norb::PersistentMemory::end_command();
+  }
+  norb::PersistentMemory::sync_log();
+  _exit(0);
+}
+
+void check_pages_reused() {
+  norb::PersistentMemory::enable_logging();
+  bpt_type tree("long");
+  assert(tree.size() == 0);
+  const auto pages = norb::PersistentMemory::get_page_count();
+  for (int i = 0; i < long_run; i++) {
+    const int key = static_cast<int>(i * 7919LL % long_run);
+    tree.insert(key, key);
+    if ((i + 1) % batch == 0)
+      norb::PersistentMemory::end_command();
+  }
+  assert(norb::PersistentMemory::get_page_count() - pages < pages / 10);
+}
+
+void run_in_child(void (*phase)()) {
+  std::cout.flush();
+  const pid_t pid = fork();
+  if (pid == 0) {
+    phase();
+    std::exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main() {
+  norb::chore::remove_associated();
+  run_in_child(fill_then_crash);
+  run_in_child(check_committed);
+  std::cout << "Unfinished command rolled back" << '\n';
+  run_in_child(grow_then_crash);
+  run_in_child(check_prefix);
+  std::cout << "Committed prefix recovered" << '\n';
+  run_in_child(run_long_then_crash);
+  run_in_child(check_long);
+  std::cout << "Recovered from the last checkpoint" << '\n';
+  run_in_child(empty_then_crash);
+  run_in_child(check_pages_reused);
+  std::cout << "Freed pages reused after a crash" << '\n';
+  norb::chore::remove_associated();
+  std::cout << "All tests passed!" << '\n';
+  return 0;
+}